@@ -0,0 +1,64 @@
+#ifndef AUDIO_EXTRACTOR_H
+#define AUDIO_EXTRACTOR_H
+
+// Standard Library Inclusions
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <filesystem>
+
+// Project Inclusions
+#include "DetectKey.h"
+#include "TimbreFeatures.h"
+#include "WaveformOverview.h"
+#include "FileRecord.h"
+#include "TaskScheduler.h"
+#include "MemoryBudget.h"
+#include "WavReader.h"
+
+// fft windows analyzed per scheduler task
+#define ANALYSIS_WINDOWS_PER_TASK 16
+
+// Memory for decoding, shared by every analysis in the process (see
+// decode_budget); the default can be changed with --decode-budget
+#define DECODE_BUDGET_MB 1024
+
+// A file whose full decode would take more than 1/DECODE_STREAM_DIVISOR of
+// the budget is streamed instead, DECODE_STREAM_WINDOWS fft windows at a
+// time
+#define DECODE_STREAM_DIVISOR 4
+#define DECODE_STREAM_WINDOWS 64
+
+// Footprint of a file whose header can't be read, as a multiple of its size
+#define DECODE_UNKNOWN_RATIO 4
+
+// How a file will be decoded, and the memory the decode needs at its peak
+// A full decode holds the file, its samples per channel and their mono
+// mixdown at once; a streaming decode holds one block of mono samples.
+struct DecodePlan {
+    bool streaming = false;
+    size_t footprint = 0;
+};
+
+// the process-wide decode budget
+MemoryBudget &decode_budget (void);
+
+// Read a file's header and plan its decode against the decode budget
+struct DecodePlan plan_decode (const std::string &path);
+
+// Decode an audio file once and run every per-file analysis over the decoded
+// samples. Fills auto_key, duration, timbre and overview in the record.
+// The fft windows are analyzed in parallel on the task scheduler, at the
+// priority of the calling task (PRIORITY_SCAN outside of one). Both decode
+// modes see the same samples, so they agree up to the order in which the
+// windows are accumulated.
+// The caller reserves the plan's footprint from the decode budget before
+// the call; reserving inside a task could wait on a reservation held by
+// the same thread while it helps with other tasks.
+// Returns false (and leaves auto_key at -1) if the file can't be decoded.
+bool extract_audio_features (const std::string &path, 
+                             const struct DecodePlan &plan,
+                             struct FileRecord *record);
+
+#endif // AUDIO_EXTRACTOR_H
@@ -0,0 +1,295 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <algorithm>
+#include <tuple>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+
+// Project Inclusions
+#include "FileRecord.h"
+#include "RecordBatch.h"
+#include "SearchResults.h"
+#include "PostingList.h"
+#include "MappedFile.h"
+#include "CatalogSnapshot.h"
+#include "TrigramIndex.h"
+#include "FuzzyMatch.h"
+#include "QueryLanguage.h"
+#include "TaskScheduler.h"
+
+// CatalogColumn is one column of the catalog. It either owns its values or
+// views an array inside a mapped snapshot; the first write to a viewed column
+// copies it into owned storage.
+template <typename T>
+class CatalogColumn {
+public:
+    // view n values owned by someone else
+    void view (const T *values, size_t n) {
+        owned.clear();
+        owned.shrink_to_fit();
+        ptr = values;
+        count = n;
+        is_view = true;
+    }
+
+    void push_back (const T &value) {
+        own();
+        owned.push_back(value);
+        sync();
+    }
+
+    void append (const T *values, size_t n) {
+        own();
+        owned.insert(owned.end(), values, values + n);
+        sync();
+    }
+
+    void set (size_t i, const T &value) {
+        own();
+        owned[i] = value;
+    }
+
+    inline const T &operator[] (size_t i) const { return ptr[i]; }
+    inline const T *data (void) const { return ptr; }
+    inline size_t size (void) const { return count; }
+    inline bool empty (void) const { return count == 0; }
+    inline const T &back (void) const { return ptr[count - 1]; }
+
+private:
+    std::vector<T> owned;
+    const T *ptr = nullptr;
+    size_t count = 0;
+    bool is_view = false;
+
+    void own (void) {
+        if (is_view) {
+            owned.assign(ptr, ptr + count);
+            is_view = false;
+        }
+    }
+    void sync (void) {
+        ptr = owned.data();
+        count = owned.size();
+    }
+};
+
+// Catalog is an in-memory, column oriented copy of the browsing fields of
+// audio_files, for interactive queries that shouldn't go through SQLite.
+//
+// Each field is its own column indexed by row number. Rows are kept in
+// ascending row id order, so a row is found by binary search on the id
+// column. Names live in two contiguous arenas (as stored and lowercased)
+// separated by '\0', so a substring query is one pass over a single buffer.
+// Directories are a string table indexed by directory id. Tags are interned
+// to catalog-local ids with one sorted posting list of rows per tag.
+//
+// It is built at startup, either from the database (Database::load_catalog)
+// or by mapping a snapshot (open_snapshot) and then loading the rows added
+// since. The scanner's insert stage and the re-analysis job keep it current.
+// Queries take a shared lock and may run concurrently; updates are exclusive.
+class Catalog {
+public:
+    Catalog (void) = default;
+
+    Catalog (const Catalog&) = delete;
+    Catalog& operator= (const Catalog&) = delete;
+
+    // add a row; rows must arrive in ascending id order, a row whose id is
+    // not past the last row is ignored. key and bpm are the effective values
+    // (user override, else detected).
+    void insert (int64_t id, int64_t dir_id, std::string_view dir,
+                 std::string_view name, int64_t size, int duration,
+                 int key, int bpm, std::string_view tags);
+
+    // add a newly inserted file, read from its scan batch
+    void insert (int64_t id, int64_t dir_id, const RecordBatch &batch,
+                 const PackedRecord &record);
+
+    // replace the analysis fields of a row after re-analysis
+    void update_analysis (int64_t id, const struct FileRecord &file);
+
+    // Rows from first_row on whose name contains needle (case insensitive),
+    // in row order; end_row receives the row count the search covered.
+    // Rows are only ever appended, so a caller holding the matches up to
+    // end_row can later pick up the rest from end_row. At most max_rows rows
+    // are searched, so a long search can be split into chunks.
+    std::vector<uint32_t> rows_containing (const std::string &needle,
+                                           size_t first_row, size_t *end_row,
+                                           size_t max_rows = SIZE_MAX) const;
+
+    // The rows of a sorted row list whose name contains needle
+    // The refinement stops early, with a partial result, once cancel is set.
+    std::vector<uint32_t> refine_rows (const std::vector<uint32_t> &rows,
+                                       const std::string &needle,
+                                       const std::atomic<bool> *cancel = nullptr) const;
+
+    // Rows whose name or one of whose tags contains needle (case
+    // insensitive), through the trigram indexes. Needles of at least
+    // TRIGRAM_FUZZY_MIN_LENGTH characters may match with up to max_edits
+    // (0 or 1) typos. Ranked exact matches first, then name matches before
+    // tag matches, matches at the start of the name or of a word, shorter
+    // names and row order. At most limit rows are returned; total receives
+    // the full match count. An empty needle matches nothing.
+    std::vector<uint32_t> text_search (const std::string &needle, 
+                                       int max_edits, size_t limit,
+                                       size_t *total) const;
+
+    // Rows from first_row on whose name contains pattern as a subsequence
+    // (case insensitive), in row order; end_row receives the row count the
+    // search covered, as in rows_containing. A branch free pass over the
+    // character mask column drops most rows before any name is read.
+    std::vector<uint32_t> fuzzy_rows (const std::string &pattern,
+                                      size_t first_row, size_t *end_row,
+                                      size_t max_rows = SIZE_MAX) const;
+
+    // The rows of a sorted row list whose name contains pattern as a
+    // subsequence, stopping early once cancel is set
+    std::vector<uint32_t> refine_fuzzy (const std::vector<uint32_t> &rows,
+                                        const std::string &pattern,
+                                        const std::atomic<bool> *cancel = nullptr) const;
+
+    // Score rows against a fuzzy pattern (see FuzzyMatch.h) and return the
+    // best k, best first. Newer rows get up to FUZZY_RECENCY_BONUS extra and
+    // win ties. Large row lists are scored in parallel as interactive tasks,
+    // each slice keeping its own bounded heap. Scoring stops early once cancel is set.
+    std::vector<FuzzyHit> rank_fuzzy (const std::vector<uint32_t> &rows,
+                                      const std::string &pattern, size_t k,
+                                      const std::atomic<bool> *cancel = nullptr) const;
+
+    // Rows matching every term of a structured query (see QueryLanguage.h),
+    // in row order. The planner starts from the most selective term it has
+    // an index or column for: a tag's posting list, trigram candidates of a
+    // name fragment, or one pass over the key, bpm, duration or directory
+    // column. The other terms filter those rows, cheapest checks first:
+    // column comparisons, then tag probes, then name substring searches.
+    // At most limit rows are returned; total receives the full match count.
+    // If plan isn't null it receives the stages with their row counts, and
+    // if facets isn't null the key and bpm counts of every match. Once
+    // cancel is set the query stops between stages or within one, and
+    // returns no rows.
+    std::vector<uint32_t> run_query (const struct ParsedQuery &parsed,
+                                     size_t limit, size_t *total,
+                                     struct QueryPlan *plan = nullptr,
+                                     FacetCounts *facets = nullptr,
+                                     const std::atomic<bool> *cancel = nullptr) const;
+
+    // fill a search hit from a row returned by a search
+    void hit (uint32_t row, struct SearchHit *hit) const;
+
+    // full path of a row returned by a search
+    std::string path (uint32_t row) const;
+
+    size_t size (void) const;
+
+    // highest row id in the catalog, 0 if empty
+    int64_t last_id (void) const;
+
+    // changes whenever existing rows are replaced (open_snapshot, clear), so
+    // row numbers held from an older epoch are no longer valid
+    uint64_t epoch (void) const;
+
+    // Write the catalog to a snapshot file, stamped with the id of the
+    // database it was loaded from. Returns false if the file can't be
+    // written.
+    bool write_snapshot (const std::string &path, uint64_t database_id) const;
+
+    // Replace the catalog with a mapped snapshot. Columns and the name
+    // trigram lists are served from the mapping directly; only the tag
+    // dictionary and its trigrams are built in memory. With
+    // verify, the checksum is checked before anything is used; the offset
+    // tables are always checked.
+    // Returns false, leaving the catalog unchanged, if the file is missing,
+    // malformed, from another snapshot version or from another database.
+    bool open_snapshot (const std::string &path, bool verify,
+                        uint64_t database_id);
+
+    // drop every row, and the snapshot if one is mapped
+    void clear (void);
+
+    // effective values of a record, as in the effective_key and
+    // effective_bpm columns
+    static int effective_key (const struct FileRecord &file);
+    static int effective_bpm (const struct FileRecord &file);
+
+private:
+    // columns, indexed by row
+    CatalogColumn<int64_t> ids;
+    CatalogColumn<uint32_t> name_offsets;  // start of each name in the arenas
+    CatalogColumn<char> names;             // names as stored, '\0' separated
+    CatalogColumn<char> folded;            // lowercased copy of names
+    CatalogColumn<int64_t> sizes;
+    CatalogColumn<int32_t> durations;
+    CatalogColumn<int16_t> bpms;
+    CatalogColumn<int8_t> keys;
+    CatalogColumn<uint32_t> dirs;
+    CatalogColumn<uint64_t> char_masks;    // fuzzy_char_mask of each name
+
+    // directory id -> offset of its path in dir_names
+    CatalogColumn<uint32_t> dir_offsets;
+    CatalogColumn<char> dir_names;
+
+    // tag name -> catalog tag id -> sorted rows
+    std::unordered_map<std::string, uint32_t> tag_ids;
+    std::vector<std::string> tag_names;
+    std::vector<std::vector<uint32_t>> tag_rows;
+
+    // trigrams of the folded names, by row, and of the tag names, by tag id
+    // Both grow with insert. open_snapshot views the name lists in the
+    // mapping and rebuilds the tag lists.
+    TrigramIndex name_trigrams;
+    TrigramIndex tag_trigrams;
+
+    // the snapshot the columns view, if any
+    std::unique_ptr<MappedFile> snapshot;
+
+    uint64_t row_epoch = 0;
+
+    mutable std::shared_mutex mutex;
+
+    // scratch for insert, reused so appending a row doesn't allocate
+    std::string fold_buffer;
+    std::string tag_buffer;
+
+    // append a row's columns, false if its id is not past the last row
+    bool append_row (int64_t id, int64_t dir_id, std::string_view dir,
+                     std::string_view name, int64_t size, int duration,
+                     int key, int bpm);
+
+    // add a row to the posting list of each tag in a space separated string
+    void add_tags (uint32_t row, std::string_view tags);
+
+    // end of a row's name in the folded arena (its '\0')
+    size_t name_end (size_t row) const;
+
+    // rows from first_row up to end_row whose folded name contains a folded
+    // needle
+    std::vector<uint32_t> scan_names (std::string_view needle, 
+                                      size_t first_row, size_t end_row) const;
+
+    // rows and tag ids that may contain a folded fragment: trigram
+    // candidates, or a direct scan for fragments too short to have trigrams
+    std::vector<uint32_t> name_candidates (std::string_view fragment) const;
+    std::vector<uint32_t> tag_candidates (std::string_view fragment) const;
+
+    // row of an id, -1 if the id isn't in the catalog
+    int64_t find_row (int64_t id) const;
+
+    // count rows per key and per bpm bucket
+    void count_facets (const std::vector<uint32_t> &rows,
+                       FacetCounts *facets) const;
+};
+
+#endif // CATALOG_H
@@ -0,0 +1,107 @@
+#ifndef CATALOG_SNAPSHOT_H
+#define CATALOG_SNAPSHOT_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// A catalog snapshot is a Catalog written as its raw columns, so it can be
+// mapped and served from without parsing (see Catalog::write_snapshot and
+// Catalog::open_snapshot).
+//
+// Layout: a SnapshotHeader, then one section per SnapshotSectionId, each a
+// plain little-endian array starting on an 8 byte boundary. Strings are kept
+// in '\0' separated arenas addressed by uint32 offset tables. Tag postings
+// use one offset table into a single array of rows. The name trigram index
+// is its posting lists as encoded in memory (see CompressedPostingList), all
+// concatenated, with one SnapshotTrigram per trigram locating its list.
+//
+// The checksum is FNV-1a over the 64-bit words of everything after the
+// header, zero padded to a word.
+//
+// Row ids only mean something in the database they came from, so the header
+// records that database's id (see Database::database_id) and a snapshot is
+// only opened against the same database.
+
+#define SNAPSHOT_MAGIC "MKBDCAT"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_ALIGN 8
+
+// directory offset for directory ids with no path
+#define SNAPSHOT_NO_DIRECTORY 0xffffffffu
+
+enum SnapshotSectionId {
+    SNAPSHOT_IDS,             // int64 per row, ascending
+    SNAPSHOT_NAME_OFFSETS,    // uint32 per row
+    SNAPSHOT_NAMES,           // char arena
+    SNAPSHOT_FOLDED,          // char arena, lowercased names
+    SNAPSHOT_SIZES,           // int64 per row
+    SNAPSHOT_DURATIONS,       // int32 per row, milliseconds
+    SNAPSHOT_BPMS,            // int16 per row
+    SNAPSHOT_KEYS,            // int8 per row
+    SNAPSHOT_DIRS,            // uint32 directory id per row
+    SNAPSHOT_CHAR_MASKS,      // uint64 fuzzy_char_mask of each folded name
+    SNAPSHOT_DIR_OFFSETS,     // uint32 per directory id
+    SNAPSHOT_DIR_NAMES,       // char arena
+    SNAPSHOT_TAG_OFFSETS,     // uint32 per tag
+    SNAPSHOT_TAG_NAMES,       // char arena
+    SNAPSHOT_POSTING_OFFSETS, // uint32 per tag + 1
+    SNAPSHOT_POSTINGS,        // uint32 rows, sorted per tag
+    SNAPSHOT_TRIGRAMS,        // SnapshotTrigram per trigram, ascending
+    SNAPSHOT_TRIGRAM_BYTES,   // encoded gaps of every list
+    SNAPSHOT_TRIGRAM_SKIPS,   // PostingSkip points of every list
+    SNAPSHOT_SECTIONS
+};
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;         // none defined yet
+    uint64_t rows;
+    uint64_t checksum;
+    uint64_t database_id;
+    struct SnapshotSection sections[SNAPSHOT_SECTIONS];
+};
+
+// one name trigram's list: its entries start at byte bytes of
+// SNAPSHOT_TRIGRAM_BYTES and end where the next trigram's start, and its
+// skip points start at skip skips of SNAPSHOT_TRIGRAM_SKIPS
+struct SnapshotTrigram {
+    uint32_t trigram;
+    uint32_t count;
+    uint32_t last;
+    uint32_t bytes;
+    uint32_t skips;
+};
+
+#define SNAPSHOT_CHECKSUM_SEED 0xcbf29ce484222325ULL
+
+// FNV-1a over 64-bit words, continuing from hash; a trailing partial word is
+// zero padded, so sections padded to SNAPSHOT_ALIGN can be hashed one by one
+inline uint64_t snapshot_checksum (const uint8_t *data, size_t bytes,
+                                   uint64_t hash) {
+    size_t i = 0;
+    // snapshots are little-endian, like every platform the app runs on,
+    // so whole words are read directly
+    for (; i + 8 <= bytes; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    if (i < bytes) {
+        uint64_t word = 0;
+        for (int b = 0; i + b < bytes; b++) {
+            word |= static_cast<uint64_t>(data[i + b]) << (8 * b);
+        }
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#endif // CATALOG_SNAPSHOT_H
@@ -4,7 +4,18 @@
 // Standard Library Inclusions
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <filesystem>
+#include <atomic>
 
 // External Inclusions
 #include "sqlite3.h"
@@ -13,36 +24,341 @@
 #include "SystemUtilities.h"
 #include "ThreadSafeQueue.h"
 #include "FileRecord.h"
+#include "RecordBatch.h"
+#include "SimilarityIndex.h"
+#include "TimbreFeatures.h"
+#include "PostingList.h"
+#include "DetectKey.h"
+#include "WaveformOverview.h"
+#include "SearchResults.h"
+#include "Catalog.h"
 
 // definitions
 namespace fs = std::filesystem;
 
-// Checks if the given database table exists
-bool db_table_valid(sqlite3* db, const std::string& table_name);
+// Schema version stored in PRAGMA user_version
+// 1: timbre BLOB column
+// 2: waveform_overviews table
+// 3: audio_files_fts full-text index and its sync triggers
+// 4: tags dictionary and file_tags inverted index
+// 5: per-feature analyzer versions
+// 6: effective_key / effective_bpm columns and facet indexes
+// 7: directories table, files stored as (dir_id, file_name)
+// 8: similarity_graph, the saved similarity index
+// 9: database_info, the database's random id
+// 10: facet indexes dropped; the catalog filters in memory
+#define DB_SCHEMA_VERSION 10
 
-// Print the number of rows in a database table
-int db_get_num_rows(sqlite3* db, const std::string& table_name);
+// file_tags.source values
+#define TAG_SOURCE_AUTO 0
+#define TAG_SOURCE_USER 1
 
-// Prints the first n entries in a database table
-void db_print_n_rows(sqlite3* db, const std::string& table_name, int num_rows);
+// bm25 column weights for file_name, auto_tags and user_tags
+#define FTS_WEIGHTS "10.0, 4.0, 6.0"
 
-// Determines if an entry already exists in a database table
-// File paths are used as unique identifiers of table entries
-bool db_entry_exists(sqlite3* db, const std::string& table_name, std::string file_path);
+// Connection tuning, applied when a connection is opened
+#define DB_MMAP_SIZE (256LL * 1024 * 1024)
+#define DB_CACHE_SIZE_KB 65536
+#define DB_BUSY_TIMEOUT_MS 5000
 
-// Set up the audio_files table if it doesn't already exist
-void db_initialize(sqlite3* db);
+// Read-only connections kept for searches and existence checks
+#define DB_READ_CONNECTIONS 4
 
-// This function works in conjunction with db_insert_files to submit files in
-// transactions. This allows the reuse of a sqlite3_stmt, which is much
-// faster than inserting entries one at a time
-void db_insert_file(sqlite3* db, const struct FileRecord* file, sqlite3_stmt* stmt);
+// virtual machine instructions between checks of a search's cancel flag
+#define DB_PROGRESS_OPS 1000
 
-// Inserts entries in the audio_files database table
-// Data to insert comes from a vector of FileRecord structs
-void db_insert_files(sqlite3* db, ThreadSafeQueue<struct FileRecord*>* files);
+// Connection owns one sqlite3 handle and a cache of its prepared statements,
+// keyed by the address of their SQL text. Statements are prepared on first use and finalized
+// when the connection closes. A Connection is not thread safe on its own.
+class Connection {
+public:
+    Connection (const std::string& path, int flags);
+    ~Connection (void);
 
-// Function to search files by name
-std::vector<FileRecord> db_search_files_by_name(sqlite3* db, const std::string& search_query);
+    Connection (const Connection&) = delete;
+    Connection& operator= (const Connection&) = delete;
 
-#endif // DATABASE_H
\ No newline at end of file
+    sqlite3* handle (void);
+
+    // Get the cached statement for sql, preparing it on first use
+    // Statements are cached for the connection's lifetime and found by
+    // pointer, so sql must be a fixed SQL_* string or literal, never text
+    // built per query.
+    sqlite3_stmt* statement (const char* sql);
+
+    // Execute a statement with no results, panic on failure
+    void exec (const char* sql, const char* caller);
+
+private:
+    sqlite3* db = nullptr;
+    std::unordered_map<const char*, sqlite3_stmt*> statements;
+};
+
+// CachedStatement borrows a statement from a Connection's cache and resets
+// it when it goes out of scope, so the next caller gets a clean statement
+class CachedStatement {
+public:
+    CachedStatement (Connection& conn, const char* sql);
+    ~CachedStatement (void);
+
+    CachedStatement (const CachedStatement&) = delete;
+    CachedStatement& operator= (const CachedStatement&) = delete;
+
+    inline sqlite3_stmt* get (void) { return stmt; }
+    inline operator sqlite3_stmt* (void) { return stmt; }
+
+private:
+    sqlite3_stmt* stmt;
+};
+
+// ConnectionPool hands out connections to one thread at a time, opening up
+// to size connections on demand and blocking when all of them are in use
+class ConnectionPool {
+public:
+    ConnectionPool (const std::string& path, int flags, int size);
+
+    Connection* acquire (void);
+    void release (Connection* conn);
+
+private:
+    std::string path;
+    int flags;
+    int size;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<Connection*> idle;
+};
+
+// PooledConnection borrows a connection from a pool for its lifetime
+class PooledConnection {
+public:
+    explicit PooledConnection (ConnectionPool& pool) :
+        pool(pool), conn(pool.acquire()) {}
+    ~PooledConnection (void) { pool.release(conn); }
+
+    PooledConnection (const PooledConnection&) = delete;
+    PooledConnection& operator= (const PooledConnection&) = delete;
+
+    inline operator Connection& (void) { return *conn; }
+    inline Connection* operator-> (void) { return conn; }
+
+private:
+    ConnectionPool& pool;
+    Connection* conn;
+};
+
+// Database owns the catalog connections and exposes the catalog operations.
+// Every operation reuses cached statements instead of preparing its SQL on
+// each call.
+//
+// Writes go through a single writer connection and are serialized on
+// write_mutex. Reads (searches, existence checks, lookups) each borrow one
+// of the read-only connections in the pool. In WAL mode readers see the last
+// committed snapshot and are never blocked by an open insert transaction.
+class Database {
+public:
+    // Open (or create) the database, apply connection pragmas and migrate the
+    // schema to DB_SCHEMA_VERSION
+    explicit Database (const std::string& path);
+
+    Database (const Database&) = delete;
+    Database& operator= (const Database&) = delete;
+
+    // Checks if the given database table exists
+    bool table_valid (const std::string& table_name);
+
+    // Get the number of rows in a database table
+    int get_num_rows (const std::string& table_name);
+
+    // Prints the first n entries in a database table
+    void print_n_rows (const std::string& table_name, int num_rows);
+
+    // Determines if a file is already in the audio_files table
+    // (directory, file name) pairs are the unique identifiers of table entries
+    bool entry_exists (const std::string& file_path);
+
+    // Bulk load mode for first scans of large libraries. Between begin and
+    // finish, insert_files appends to unindexed staging tables; new rows
+    // reach the index, catalog and searches only when finish merges them in
+    // one transaction, building the secondary and full-text indexes in one
+    // sorted pass. If the process stops before finish, the staged rows are
+    // merged the next time the database opens.
+    // Prefer BulkLoad below, which finishes on every path; finish does
+    // nothing outside a bulk load.
+    void begin_bulk_load (void);
+    void finish_bulk_load (void);
+
+    // Get the names of the cataloged files in a directory, so a directory
+    // scan checks each entry against one set instead of querying per file
+    std::unordered_set<std::string> directory_file_names (const std::string& dir);
+
+    // Inserts the records of a set of scan batches in the audio_files table
+    // in one transaction. Newly inserted rows are added to the catalog, and
+    // those with a timbre to the similarity index. The batches stay owned by
+    // the caller.
+    void insert_files (const std::vector<RecordBatch*>& batches,
+                       SimilarityIndex* index, Catalog* catalog);
+
+    // Search file names and tags with the full-text index, one page at a time
+    // Every word of the query must prefix-match a token of the name or tags;
+    // results are ranked by bm25, ties broken by row id. An empty query
+    // matches nothing. Pass the previous page's next cursor to continue;
+    // only page_size rows are read into memory.
+    // Setting cancel from another thread interrupts the query within
+    // DB_PROGRESS_OPS instructions; the page is then marked cancelled.
+    SearchPage search_files_by_name (const std::string& search_query,
+                                     const SearchCursor& after, int page_size,
+                                     const std::atomic<bool>* cancel = nullptr);
+
+    // Get the full record of a row id, false if there is no such row
+    bool get_file (int64_t file_id, struct FileRecord* file);
+
+    // Get the row id of a file path, -1 if the file is not in the database
+    int64_t get_file_id (const std::string& file_path);
+
+    // Fill the similarity index at startup: an empty index is restored from
+    // the saved graph, then the timbres of rows after the index's last id
+    // are inserted. With no saved graph every timbre is inserted.
+    void load_similarity_index (SimilarityIndex* index);
+
+    // Save the similarity graph so the next start restores it instead of
+    // rebuilding it. Re-analysis drops the saved graph when it changes a
+    // timbre, since the graph no longer matches the column.
+    void save_similarity_index (const SimilarityIndex* index);
+
+    // Load the rows added after the catalog's last row into the in-memory
+    // catalog: the whole table for an empty catalog, the rows scanned since
+    // the snapshot for one opened from a snapshot.
+    // A catalog from a snapshot must be a prefix of this database: its last
+    // row still here under the same path. If it isn't (the database was
+    // restored from an older copy, say), the catalog is cleared and loaded
+    // whole, and false is returned so the caller can say so.
+    bool load_catalog (Catalog* catalog);
+
+    // A random id given to the database when it is created, so files
+    // derived from it (catalog snapshots) are never used with another one
+    uint64_t database_id (void) const;
+
+    // Fetch the waveform overview level that best fits a pixel width: the
+    // coarsest level with at least pixel_width bins, or the finest available.
+    // Returns false if the file has no overview.
+    bool fetch_overview (int64_t file_id, int pixel_width, WaveformLevel* level);
+
+    // Find the k files that sound most like the given file, closest first
+    std::vector<FileRecord> find_similar_files (const SimilarityIndex* index,
+                                                const std::string& file_path,
+                                                int k);
+
+    // Get the row ids of files carrying every tag (AND), in id order
+    // Unknown tags match nothing
+    std::vector<int64_t> files_with_all_tags (const std::vector<std::string>& tags);
+
+    // Get the row ids of files carrying any of the tags (OR), in id order
+    std::vector<int64_t> files_with_any_tags (const std::vector<std::string>& tags);
+
+    // Get up to limit files, after row id after_id in id order, whose key,
+    // timbre or overview was produced by an older analyzer version
+    std::vector<std::pair<int64_t, std::string>> select_stale_files (
+                                                int64_t after_id, int limit);
+
+    // Write re-analysis results (row id, record) in one transaction, with a
+    // single reused UPDATE statement. Only analysis columns are touched.
+    void update_analysis (
+        const std::vector<std::pair<int64_t, const struct FileRecord*>>& files,
+        SimilarityIndex* index, Catalog* catalog);
+
+    // Get up to limit (tag, file count) pairs for tags starting with prefix,
+    // most used first, for tag autocomplete
+    std::vector<std::pair<std::string, int>> tag_frequencies (
+                                                const std::string& prefix,
+                                                int limit);
+
+private:
+    std::mutex write_mutex;
+    Connection writer;
+    ConnectionPool readers;
+
+    // tag name -> tags.id, filled as the writer interns tags
+    std::unordered_map<std::string, int64_t> tag_ids;
+
+    // directory path -> directories.id, filled as the writer interns paths
+    std::unordered_map<std::string, int64_t> dir_ids;
+
+    // the last directory interned, and scratch for splitting tag strings
+    std::string last_dir;
+    int64_t last_dir_id = -1;
+    std::string tag_buffer;
+
+    // see database_id
+    uint64_t identity = 0;
+
+    // bulk load state, guarded by write_mutex
+    bool bulk_loading = false;
+    int64_t bulk_next_id = 0;
+
+    // Set up the audio_files table if it doesn't already exist and migrate it
+    void initialize (void);
+
+    // Apply the schema migrations after version
+    void migrate (int version);
+
+    // Merge the bulk load staging tables into the catalog
+    void merge_staging (void);
+
+    // Rebuild audio_files with directory-interned paths (schema version 7)
+    void migrate_directories (void);
+
+    // Get the id of a directory, adding it to the directories table on first use
+    int64_t intern_directory (std::string_view dir);
+
+    // Insert one record of a scan batch with the cached insert statements
+    void insert_file (const RecordBatch& batch, const PackedRecord& file,
+                      SimilarityIndex* index, Catalog* catalog);
+
+    // Get the id of a tag, adding it to the tags table on first use
+    int64_t intern_tag (const std::string& name);
+
+    // Replace the overview levels of a file
+    void write_overview (int64_t file_id, const WaveformOverview& overview);
+
+    // Add one overview level of a file
+    void insert_overview_level (int64_t file_id, int bins, const int8_t* peaks,
+                                size_t bytes);
+
+    // Link a file to each tag in a space separated tag string
+    void insert_file_tags (int64_t file_id, std::string_view tags, int source);
+};
+
+// BulkLoad runs a bulk load for its lifetime when enabled: begin_bulk_load
+// on construction, and finish_bulk_load on destruction unless finished
+// before, so a scan that unwinds early still merges what it staged.
+class BulkLoad {
+public:
+    BulkLoad (Database& db, bool enabled) : db(db), active(enabled) {
+        if (active) {
+            db.begin_bulk_load();
+        }
+    }
+    ~BulkLoad (void) { finish(); }
+
+    BulkLoad (const BulkLoad&) = delete;
+    BulkLoad& operator= (const BulkLoad&) = delete;
+
+    // merge the staged rows now; true if a bulk load was running
+    bool finish (void) {
+        if (!active) {
+            return false;
+        }
+        active = false;
+        db.finish_bulk_load();
+        return true;
+    }
+
+private:
+    Database& db;
+    bool active;
+};
+
+#endif // DATABASE_H
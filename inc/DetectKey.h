@@ -9,10 +9,14 @@
 #include <mutex>
 #include "AudioFile.h"
 #include "kiss_fft.h"
+#include "TimbreFeatures.h"
 
 #define FFT_WINDOW_SIZE 8192 * 2
 #define MAX_ANALYSIS_TIME FFT_WINDOW_SIZE * 16
 
+// bump when a change to key detection should trigger re-analysis
+#define KEY_ANALYZER_VERSION 1
+
 class MidiMap {
 private:
     std::mutex mutex;
@@ -67,8 +71,8 @@ int midi_note (int index, int sample_rate);
 // Function to determine the musical key based on weights
 int assign_key (MidiMap *midi_map);
 
-void process_segment (const std::vector<float> *samples, int start, int sample_rate, MidiMap *midi_map);
-
-int kdet_detect_key (std::string path);
+// fft one window of samples and accumulate it in the midi and timbre maps
+// samples past the end of the file are treated as silence
+void process_segment (const std::vector<float> *samples, int start, int sample_rate, MidiMap *midi_map, TimbreMap *timbre_map);
 
 #endif // DETECT_KEY_H
\ No newline at end of file
@@ -3,12 +3,17 @@
 
 // Standard Library Inclusions
 #include <string>
+#include <vector>
+
+// Project Inclusions
+#include "WaveformOverview.h"
 
 struct FileRecord {
     std::string file_path;
     std::string file_name;
     int file_size;
     
+    // milliseconds
     int duration;
     
     int num_user_tags;
@@ -17,11 +22,18 @@ struct FileRecord {
     int num_auto_tags;
     std::string auto_tags;
     
+    // user overrides, 0 when not set; user_key is the key number + 1
     int user_bpm;
     int user_key;
     
     int auto_bpm;
     int auto_key;
+
+    // TIMBRE_DIMS floats, empty if the file couldn't be analyzed
+    std::vector<float> timbre;
+
+    // min/max/rms peak pyramid, empty if the file couldn't be analyzed
+    WaveformOverview overview;
 };
 
 #endif // FILE_RECORD_H
\ No newline at end of file
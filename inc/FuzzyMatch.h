@@ -0,0 +1,48 @@
+#ifndef FUZZY_MATCH_H
+#define FUZZY_MATCH_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cctype>
+#include <string_view>
+#include <algorithm>
+
+// Fuzzy match scoring, after fzf: each pattern character matched earns
+// FUZZY_SCORE_MATCH plus a bonus where it starts a word or continues a run of
+// matches; gaps between matches cost FUZZY_GAP_START for the first skipped
+// character and FUZZY_GAP_EXTENSION for each one after.
+#define FUZZY_SCORE_MATCH 16
+#define FUZZY_GAP_START 3
+#define FUZZY_GAP_EXTENSION 1
+#define FUZZY_BONUS_BOUNDARY 8
+#define FUZZY_BONUS_CAMEL 7
+#define FUZZY_BONUS_CONSECUTIVE 4
+#define FUZZY_FIRST_CHAR_MULTIPLIER 2
+
+// largest bonus for recency, given to the newest row; older rows get less
+#define FUZZY_RECENCY_BONUS 8
+
+// catalogs with at least this many candidate rows are scored in parallel
+#define FUZZY_PARALLEL_MIN_ROWS 65536
+
+// a ranked fuzzy match
+struct FuzzyHit {
+    uint32_t row;
+    int score;
+};
+
+// Bit set of the character classes in a folded string: one bit per letter
+// and digit, the rest hashed into the remaining bits. A pattern can only be
+// a subsequence of a name whose mask covers the pattern's mask.
+uint64_t fuzzy_char_mask (std::string_view folded);
+
+// is pattern a subsequence of text
+bool is_subsequence (std::string_view text, std::string_view pattern);
+
+// Score the best window of text containing the folded pattern as a
+// subsequence. text is the name as stored, for word and case boundaries, and
+// folded its lowercase copy. Returns false if pattern is not a subsequence.
+bool fuzzy_score (std::string_view text, std::string_view folded,
+                  std::string_view pattern, int *score);
+
+#endif // FUZZY_MATCH_H
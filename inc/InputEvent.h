@@ -0,0 +1,53 @@
+#ifndef INPUT_EVENT_H
+#define INPUT_EVENT_H
+
+// Standard Library Inclusions
+#include <cstdint>
+
+enum InputEventType : uint8_t {
+    INPUT_KEY,          // a key press
+    INPUT_RESIZE,       // the terminal changed size
+    INPUT_RESULTS,      // new search results are ready to draw
+};
+
+enum InputKey : uint8_t {
+    KEY_NONE = 0,
+    KEY_CHAR,           // a character, in ch
+    KEY_ENTER,
+    KEY_TAB,
+    KEY_BACKSPACE,
+    KEY_DELETE,
+    KEY_ESCAPE,
+    KEY_INSERT,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_PAGE_UP,
+    KEY_PAGE_DOWN,
+    KEY_F1,             // KEY_F1 + n - 1 is Fn, up to F12
+};
+
+// modifier bits, as encoded in xterm's CSI parameters less one
+#define MOD_SHIFT 0x01
+#define MOD_ALT   0x02
+#define MOD_CTRL  0x04
+
+// One event for the ui thread. A control character is a KEY_CHAR with
+// MOD_CTRL and the lowercase letter in ch, so Ctrl-S is {KEY_CHAR, 's',
+// MOD_CTRL}.
+struct InputEvent {
+    InputEventType type = INPUT_KEY;
+    InputKey key = KEY_NONE;
+    char ch = 0;
+    uint8_t modifiers = 0;
+
+    inline bool is_ctrl (char letter) const {
+        return type == INPUT_KEY && key == KEY_CHAR && ch == letter &&
+               (modifiers & MOD_CTRL);
+    }
+};
+
+#endif // INPUT_EVENT_H
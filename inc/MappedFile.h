@@ -0,0 +1,46 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+// Standard Library Inclusions
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// MappedFile maps a whole file read-only into memory for its lifetime
+class MappedFile {
+public:
+    MappedFile (void) = default;
+    ~MappedFile (void);
+
+    MappedFile (const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    // map a file, false if it can't be opened or is empty
+    bool open (const std::string &path);
+    void close (void);
+
+    inline const uint8_t *data (void) const { return bytes; }
+    inline size_t size (void) const { return length; }
+
+private:
+    const uint8_t *bytes = nullptr;
+    size_t length = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,58 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+// Standard Library Inclusions
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+// MemoryBudget admits work against a fixed number of bytes. Each job
+// reserves its estimated footprint before it starts and releases it when
+// it is done; a reservation that doesn't fit waits until enough is
+// released. A reservation larger than the whole budget is cut down to the
+// budget, so it runs once nothing else holds any.
+class MemoryBudget {
+public:
+    explicit MemoryBudget (size_t limit);
+
+    MemoryBudget (const MemoryBudget&) = delete;
+    MemoryBudget& operator= (const MemoryBudget&) = delete;
+
+    // Reserve bytes, waiting until they fit. Returns the bytes reserved,
+    // which are what must be released.
+    size_t reserve (size_t bytes);
+    void release (size_t bytes);
+
+    // change the limit; reservations already granted are kept
+    void set_limit (size_t limit);
+
+    size_t limit (void) const;
+    size_t in_use (void) const;
+
+private:
+    mutable std::mutex mutex;
+    std::condition_variable released;
+    size_t limit_bytes;
+    size_t used = 0;
+};
+
+// MemoryReservation holds bytes of a budget until it is released or
+// destroyed
+class MemoryReservation {
+public:
+    MemoryReservation (MemoryBudget &budget, size_t bytes);
+    ~MemoryReservation (void);
+
+    MemoryReservation (const MemoryReservation&) = delete;
+    MemoryReservation& operator= (const MemoryReservation&) = delete;
+
+    // give the bytes back early
+    void release (void);
+
+private:
+    MemoryBudget &budget;
+    size_t bytes;
+};
+
+#endif // MEMORY_BUDGET_H
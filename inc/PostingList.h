@@ -0,0 +1,291 @@
+#ifndef POSTING_LIST_H
+#define POSTING_LIST_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+// entries between the skip points of a compressed posting list
+#define POSTING_SKIP_INTERVAL 128
+
+// A posting list is a sorted, duplicate free list of row ids or row indices.
+// These helpers combine posting lists for tag and text queries.
+
+// Intersect posting lists (AND), starting from the shortest list so the
+// working set only ever shrinks. Lists that are much longer than the working
+// set are probed with binary search instead of being walked.
+template <typename T>
+std::vector<T> intersect_postings (std::vector<const std::vector<T>*> lists) {
+    if (lists.empty()) {
+        return std::vector<T>();
+    }
+    std::sort(lists.begin(), lists.end(),
+        [](const std::vector<T>* a, const std::vector<T>* b) {
+            return a->size() < b->size();
+        });
+
+    std::vector<T> result = *lists[0];
+    std::vector<T> next;
+    for (size_t i = 1; i < lists.size() && !result.empty(); i++) {
+        const std::vector<T>& list = *lists[i];
+        next.clear();
+        if (list.size() > 16 * result.size()) {
+            // galloping: probe each survivor, continuing from the last hit
+            auto from = list.begin();
+            for (const T& id : result) {
+                from = std::lower_bound(from, list.end(), id);
+                if (from == list.end()) {
+                    break;
+                }
+                if (*from == id) {
+                    next.push_back(id);
+                }
+            }
+        } else {
+            std::set_intersection(result.begin(), result.end(),
+                                  list.begin(), list.end(),
+                                  std::back_inserter(next));
+        }
+        result.swap(next);
+    }
+    return result;
+}
+
+// Union posting lists (OR) by merging them pairwise, shortest first
+template <typename T>
+std::vector<T> union_postings (std::vector<const std::vector<T>*> lists) {
+    std::sort(lists.begin(), lists.end(),
+        [](const std::vector<T>* a, const std::vector<T>* b) {
+            return a->size() < b->size();
+        });
+
+    std::vector<T> result, next;
+    for (const std::vector<T>* list : lists) {
+        next.clear();
+        next.reserve(result.size() + list->size());
+        std::set_union(result.begin(), result.end(),
+                       list->begin(), list->end(),
+                       std::back_inserter(next));
+        result.swap(next);
+    }
+    return result;
+}
+
+// a skip point of a compressed posting list: an entry and the byte offset
+// of the entry after it
+struct PostingSkip {
+    uint32_t value;
+    uint32_t pos;
+};
+
+// CompressedPostingList stores an ascending list of 32 bit values as varint
+// encoded gaps, one or two bytes per entry for dense lists. Every
+// POSTING_SKIP_INTERVAL entries a skip point records the value and where the
+// following entry starts, so a reader can seek without decoding everything.
+//
+// A list either owns its encoding or views one held elsewhere (a mapped
+// catalog snapshot); the first append to a viewed list copies it.
+class CompressedPostingList {
+public:
+    // append a value larger than the last one
+    void append (uint32_t value) {
+        own();
+        uint32_t gap = value - last_value;
+        while (gap >= 0x80) {
+            owned_bytes.push_back(static_cast<uint8_t>(gap | 0x80));
+            gap >>= 7;
+        }
+        owned_bytes.push_back(static_cast<uint8_t>(gap));
+        if (count % POSTING_SKIP_INTERVAL == 0) {
+            owned_skips.push_back({value, 
+                                   static_cast<uint32_t>(owned_bytes.size())});
+        }
+        last_value = value;
+        count++;
+    }
+
+    // view a list encoded elsewhere, as given by encoded() and skip_points()
+    // of the list it was written from
+    void view (const uint8_t *bytes, size_t num_bytes, const PostingSkip *skips,
+               uint32_t last, size_t entries) {
+        owned_bytes.clear();
+        owned_skips.clear();
+        view_bytes = bytes;
+        view_skips = skips;
+        view_num_bytes = num_bytes;
+        last_value = last;
+        count = entries;
+        is_view = true;
+    }
+
+    inline size_t size (void) const { return count; }
+    inline bool empty (void) const { return count == 0; }
+    inline uint32_t last (void) const { return last_value; }
+
+    // the encoded gaps and the skip points, one per POSTING_SKIP_INTERVAL
+    // entries
+    inline const uint8_t *encoded (void) const {
+        return is_view ? view_bytes : owned_bytes.data();
+    }
+    inline size_t encoded_size (void) const {
+        return is_view ? view_num_bytes : owned_bytes.size();
+    }
+    inline const PostingSkip *skip_points (void) const {
+        return is_view ? view_skips : owned_skips.data();
+    }
+    inline size_t num_skip_points (void) const {
+        return (count + POSTING_SKIP_INTERVAL - 1) / POSTING_SKIP_INTERVAL;
+    }
+
+    // bytes used by the encoded list and its skip points
+    inline size_t memory (void) const {
+        return encoded_size() + num_skip_points() * sizeof(PostingSkip);
+    }
+
+    // Is a viewed encoding safe to read: every gap inside the bytes, which
+    // it ends exactly, entries ascending and below bound, the last one
+    // last(), and each skip point matching its entry
+    bool well_formed (uint32_t bound) const {
+        const uint8_t *bytes = encoded();
+        const PostingSkip *skips = skip_points();
+        const size_t num_bytes = encoded_size();
+        size_t pos = 0;
+        uint64_t value = 0;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t gap = 0;
+            int shift = 0;
+            uint8_t byte;
+            do {
+                if (pos >= num_bytes || shift > 28) {
+                    return false;
+                }
+                byte = bytes[pos++];
+                gap |= static_cast<uint64_t>(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            if (i > 0 && gap == 0) {
+                return false;
+            }
+            value += gap;
+            if (value >= bound) {
+                return false;
+            }
+            if (i % POSTING_SKIP_INTERVAL == 0) {
+                const PostingSkip &skip = skips[i / POSTING_SKIP_INTERVAL];
+                if (skip.value != value || skip.pos != pos) {
+                    return false;
+                }
+            }
+        }
+        return pos == num_bytes && (count == 0 || value == last_value);
+    }
+
+    void decode (std::vector<uint32_t> *values) const {
+        values->reserve(values->size() + count);
+        const uint8_t *bytes = encoded();
+        uint32_t value = 0;
+        size_t pos = 0;
+        for (size_t i = 0; i < count; i++) {
+            value += read_gap(bytes, &pos);
+            values->push_back(value);
+        }
+    }
+
+    // Reader walks a list forward, either entry by entry or by seeking
+    class Reader {
+    public:
+        explicit Reader (const CompressedPostingList &list) 
+            : bytes(list.encoded()), skips(list.skip_points()),
+              num_skips(list.num_skip_points()), count(list.size()) {}
+
+        // the next entry; false at the end of the list
+        bool next (uint32_t *value) {
+            if (index >= count) {
+                return false;
+            }
+            current += read_gap(bytes, &pos);
+            index++;
+            *value = current;
+            return true;
+        }
+
+        // the first entry not below target, at or after the current one;
+        // false if there is none
+        bool seek (uint32_t target, uint32_t *value) {
+            if (index > 0 && current >= target) {
+                *value = current;
+                return true;
+            }
+
+            // jump to the last skip point not past target, if it's ahead
+            const PostingSkip *it = std::upper_bound(skips, skips + num_skips,
+                target, [](uint32_t t, const PostingSkip &s) {
+                    return t < s.value;
+                });
+            if (it != skips) {
+                size_t block = (it - skips) - 1;
+                size_t block_index = block * POSTING_SKIP_INTERVAL + 1;
+                if (block_index > index) {
+                    current = skips[block].value;
+                    pos = skips[block].pos;
+                    index = block_index;
+                    if (current >= target) {
+                        *value = current;
+                        return true;
+                    }
+                }
+            }
+
+            while (next(value)) {
+                if (*value >= target) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        const uint8_t *bytes;
+        const PostingSkip *skips;
+        size_t num_skips;
+        size_t count;
+        size_t pos = 0;
+        size_t index = 0;
+        uint32_t current = 0;
+    };
+
+private:
+    std::vector<uint8_t> owned_bytes;
+    std::vector<PostingSkip> owned_skips;
+    const uint8_t *view_bytes = nullptr;
+    const PostingSkip *view_skips = nullptr;
+    size_t view_num_bytes = 0;
+    bool is_view = false;
+    uint32_t last_value = 0;
+    size_t count = 0;
+
+    void own (void) {
+        if (is_view) {
+            owned_bytes.assign(view_bytes, view_bytes + view_num_bytes);
+            owned_skips.assign(view_skips, view_skips + num_skip_points());
+            is_view = false;
+        }
+    }
+
+    static inline uint32_t read_gap (const uint8_t *bytes, size_t *pos) {
+        uint32_t gap = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            byte = bytes[(*pos)++];
+            gap |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        return gap;
+    }
+};
+
+#endif // POSTING_LIST_H
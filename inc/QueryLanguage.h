@@ -0,0 +1,105 @@
+#ifndef QUERY_LANGUAGE_H
+#define QUERY_LANGUAGE_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// The structured search syntax: space separated terms, all of which must
+// match. A '-' in front of a term negates it.
+//
+//   kick                 name contains "kick" (case insensitive)
+//   "open hat"           name contains the quoted phrase
+//   tag:analog           carries the tag
+//   key:Am key:F#        effective key; a minor key is its relative major,
+//                        as in DetectKey's key templates
+//   bpm:120 bpm:120-128  effective bpm, exact or an inclusive range;
+//   bpm:>120 bpm:<=90    also <, <=, >, >=
+//   bpm:~120-128         any of the forms, also matching half and double
+//                        time: 60-64 and 240-256 as well
+//   dur:<2s dur:1-3s     duration in s, ms or m (seconds by default), with
+//                        the same forms as bpm
+//   path:Vendor/         directory path contains the text
+//
+// e.g. kick -snare key:Am bpm:120-128 dur:<2s tag:analog path:Vendor/
+
+enum QueryTermKind {
+    TERM_TEXT,
+    TERM_TAG,
+    TERM_KEY,
+    TERM_BPM,
+    TERM_DURATION,
+    TERM_PATH,
+};
+
+// One term of a query. text holds the folded text of text, tag and path
+// terms; lo and hi the inclusive range of bpm and duration (milliseconds)
+// terms and the key number of key terms. A half_double bpm term also
+// matches a bpm of twice or half a value in the range.
+struct QueryTerm {
+    QueryTermKind kind;
+    bool negated = false;
+    bool half_double = false;
+    std::string text;
+    int lo = 0;
+    int hi = 0;
+    std::string source;     // the term as written, for EXPLAIN
+};
+
+// A parsed query: the conjunction of its terms
+struct ParsedQuery {
+    std::vector<struct QueryTerm> terms;
+};
+
+// how a plan stage gets its rows
+enum PlanAccess {
+    ACCESS_ALL_ROWS,        // every row of the catalog
+    ACCESS_TAG_POSTINGS,    // the tag's posting list
+    ACCESS_TRIGRAMS,        // trigram candidates, verified against the names
+    ACCESS_COLUMN_SCAN,     // one pass over a column
+    ACCESS_COLUMN_FILTER,   // column values of the rows so far
+    ACCESS_TAG_PROBE,       // binary search in the tag's posting list
+    ACCESS_NAME_FILTER,     // substring search in the names of the rows so far
+    ACCESS_PATH_FILTER,     // directory lookup of the rows so far
+};
+
+// One stage of a query plan. The first stage produces the candidate rows,
+// each later one filters them. estimate is the planner's guess of the rows
+// the term matches over the whole catalog; rows_in, rows_out and
+// milliseconds are filled in by execution.
+struct PlanStage {
+    int term;               // index into ParsedQuery::terms, -1 for none
+    PlanAccess access;
+    size_t estimate = 0;
+    size_t rows_in = 0;
+    size_t rows_out = 0;
+    double milliseconds = 0.0;
+};
+
+struct QueryPlan {
+    std::vector<struct PlanStage> stages;
+    size_t catalog_rows = 0;
+};
+
+// Parse a query. Returns false, with a message in error, on a malformed
+// value (bpm:fast, key:H, an unterminated quote). Words with an unknown
+// field name are searched as text.
+bool parse_query (const std::string &query, struct ParsedQuery *parsed,
+                  std::string *error);
+
+// true if a query uses any field or negation, so it should be run as a
+// structured query rather than a fuzzy name search
+bool is_structured_query (const std::string &query);
+
+// The plan as text, one line per stage with its estimate and, once run,
+// its row counts and time
+std::string explain_plan (const struct ParsedQuery &parsed,
+                          const struct QueryPlan &plan);
+
+#endif // QUERY_LANGUAGE_H
@@ -0,0 +1,63 @@
+#ifndef REANALYZER_H
+#define REANALYZER_H
+
+// Standard Library Inclusions
+#include <string>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
+// Project Inclusions
+#include "Database.h"
+#include "FileRecord.h"
+#include "AudioExtractor.h"
+#include "SimilarityIndex.h"
+#include "Catalog.h"
+#include "TaskScheduler.h"
+
+// Defaults for the re-analysis job
+#define REANALYSIS_BATCH_SIZE 256
+
+// batch_size: stale rows selected, analyzed and committed together
+// max_files_per_second: throttle, 0 runs unthrottled
+struct ReanalysisOptions {
+    int batch_size = REANALYSIS_BATCH_SIZE;
+    int max_files_per_second = 0;
+};
+
+// ReanalysisStop asks a running re-analysis to stop. A request wakes the
+// job out of its throttle sleep, so the job returns once the decodes it has
+// already started finish.
+class ReanalysisStop {
+public:
+    void request (void);
+    bool requested (void) const;
+
+    // sleep for up to duration; returns true if a stop was requested
+    bool wait_for (std::chrono::steady_clock::duration duration);
+
+private:
+    std::atomic<bool> flag{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+// Re-analyze every file whose key, timbre or overview was produced by an
+// older analyzer version (see KEY_ANALYZER_VERSION and friends).
+//
+// Stale rows are read in rowid order a batch at a time, analyzed as
+// PRIORITY_REANALYSIS tasks on the task scheduler, behind any scan or
+// interactive work, and written back with one batched UPDATE transaction
+// per batch. Files that can no longer be decoded are skipped and stay stale.
+// Searches keep running on the read connections throughout. Once stop is
+// requested no more files are decoded; the files already decoded are
+// written back and the job returns.
+// Returns the number of files updated.
+int reanalyze_stale_files (Database *, SimilarityIndex *, Catalog *,
+                           const ReanalysisOptions &, ReanalysisStop *stop);
+
+#endif // REANALYZER_H
@@ -0,0 +1,100 @@
+#ifndef RECORD_BATCH_H
+#define RECORD_BATCH_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Project Inclusions
+#include "FileRecord.h"
+#include "WaveformOverview.h"
+
+// A run of bytes in a batch's arena
+struct ArenaSpan {
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+// Fixed layout header of a record in a RecordBatch. Text, the timbre
+// vector and the overview pyramid live in the batch's arena; the overview
+// is its levels back to back, each an int32 bin count followed by its
+// peaks.
+struct PackedRecord {
+    ArenaSpan dir;
+    ArenaSpan file_name;
+    ArenaSpan auto_tags;
+    ArenaSpan user_tags;
+    ArenaSpan timbre;       // floats, empty if the file couldn't be analyzed
+    ArenaSpan overview;
+    int64_t file_size;
+    int32_t duration;
+    int32_t num_user_tags;
+    int32_t num_auto_tags;
+    int32_t user_bpm;
+    int32_t user_key;
+    int32_t auto_bpm;
+    int32_t auto_key;
+    int32_t overview_levels;
+};
+
+// RecordBatch holds a batch of scanned records in two contiguous buffers:
+// the record headers and one arena of bytes they point into. The scanner
+// packs each analyzed file into the batch, the whole batch goes to the
+// insert stage in one handoff, and SQLite binds read straight from the
+// arena. clear() keeps both buffers, so a recycled batch packs records
+// without allocating.
+class RecordBatch {
+public:
+    // Pack a record; its path is split into directory and file name, and
+    // its strings, timbre and overview are copied into the arena
+    void add (const struct FileRecord &file);
+
+    // drop every record, keeping the buffers for the next batch
+    void clear (void);
+
+    inline size_t size (void) const { return records.size(); }
+    inline bool empty (void) const { return records.empty(); }
+    inline const PackedRecord &operator[] (size_t i) const {
+        return records[i];
+    }
+
+    // view of a span of the arena
+    inline std::string_view text (ArenaSpan span) const {
+        return std::string_view(arena.data() + span.offset, span.length);
+    }
+    inline const float *floats (ArenaSpan span) const {
+        return reinterpret_cast<const float*>(arena.data() + span.offset);
+    }
+    inline size_t num_floats (ArenaSpan span) const {
+        return span.length / sizeof(float);
+    }
+
+    // Call fn(bins, peaks, bytes) on each overview level, finest first
+    template <typename Fn>
+    void for_each_level (const PackedRecord &record, Fn fn) const {
+        const char *p = arena.data() + record.overview.offset;
+        for (int32_t level = 0; level < record.overview_levels; level++) {
+            int32_t bins;
+            memcpy(&bins, p, sizeof(bins));
+            size_t bytes = static_cast<size_t>(bins) * OVERVIEW_BYTES_PER_BIN;
+            fn(bins, reinterpret_cast<const int8_t*>(p + sizeof(bins)), bytes);
+            p += sizeof(bins) + bytes;
+        }
+    }
+
+    // effective values, as in Catalog::effective_key and effective_bpm
+    static int effective_key (const PackedRecord &record);
+    static int effective_bpm (const PackedRecord &record);
+
+private:
+    std::vector<PackedRecord> records;
+    std::vector<char> arena;
+
+    // copy bytes to the end of the arena, starting at a multiple of align
+    ArenaSpan append (const void *data, size_t bytes, size_t align = 1);
+};
+
+#endif // RECORD_BATCH_H
@@ -6,6 +6,9 @@
 #include <vector>
 #include <filesystem>
 #include <thread>
+#include <memory>
+#include <chrono>
+#include <unordered_set>
 
 // External Inclusions
 #include "sqlite3.h"
@@ -15,11 +18,35 @@
 #include "SystemUtilities.h"
 #include "ThreadSafeQueue.h"
 #include "FileRecord.h"
-#include "DetectKey.h"
+#include "RecordBatch.h"
+#include "AudioExtractor.h"
+#include "SimilarityIndex.h"
+#include "Catalog.h"
+#include "TaskScheduler.h"
 
 // Definitions
 namespace fs = std::filesystem;
-#define TRANSACTION_SIZE 2048
+
+// Group commit for the insert stage: pending records are committed once
+// there are batch size of them or the oldest has waited COMMIT_MAX_LATENCY_MS.
+// The batch size adapts between the bounds to keep each commit close to
+// COMMIT_TARGET_MS.
+#define COMMIT_MIN_BATCH 64
+#define COMMIT_MAX_BATCH 8192
+#define COMMIT_MAX_LATENCY_MS 500
+#define COMMIT_TARGET_MS 100
+
+// Capacity of the pipeline's queues. A stage that gets this far ahead of
+// the next one waits for it.
+#define SCAN_QUEUE_CAPACITY 4096
+
+// files the process stage hands to the task scheduler at a time, per
+// scheduler thread
+#define SCAN_FILES_PER_THREAD 2
+
+// committed record batches kept for reuse by the process stage; batches
+// beyond this are freed
+#define SCAN_FREE_BATCHES 256
 
 // Delimiter check function
 constexpr inline bool char_is_delimiter (char);
@@ -28,13 +55,11 @@ constexpr inline bool char_is_delimiter (char);
 constexpr inline char to_lower (char);
 
 // Tag generation function
-std::vector<std::string> generate_auto_tags (const std::string &);
-
-// Tag concatenation function
-std::string concatenate_tags (const std::vector<std::string> &);
+int write_auto_tags (const std::string &, std::string *);
 
 // File processing function
-struct FileRecord *process_file (sqlite3 *, const fs::directory_entry &);
+void process_file (Database *, const fs::directory_entry &, 
+                   const struct DecodePlan &, struct FileRecord *);
 
 // File extension validation
 inline bool validate_file_extension (const fs::directory_entry *);
@@ -43,25 +68,29 @@ inline bool validate_file_extension (const fs::directory_entry *);
 std::vector<fs::path> find_sub_dirs (const fs::path &);
 
 // File processing requirement check
-bool requires_processing (sqlite3 *, const fs::directory_entry *);
+bool requires_processing (const std::unordered_set<std::string> &, 
+                          const fs::directory_entry *);
 
 // File queueing functions
-void queue_files (sqlite3 *, const fs::path &, 
+void queue_files (Database *, const fs::path &, 
                 ThreadSafeQueue<fs::directory_entry> *);
 
-void queue_all_files (sqlite3 *, const fs::path &, 
+void queue_all_files (Database *, const fs::path &, 
                 ThreadSafeQueue<fs::directory_entry> *);
 
 // Processing queued files function
-void process_queued_files (sqlite3 *, 
+void process_queued_files (Database *, 
         ThreadSafeQueue<fs::directory_entry> *,
-        ThreadSafeQueue<struct FileRecord *> *);
+        ThreadSafeQueue<RecordBatch *> *, ThreadSafeQueue<RecordBatch *> *);
 
 // Insert processed files function
-void insert_processed_files (sqlite3*, 
-    ThreadSafeQueue<struct FileRecord *> *);
+void insert_processed_files (Database *, ThreadSafeQueue<RecordBatch *> *,
+    ThreadSafeQueue<RecordBatch *> *, SimilarityIndex *, Catalog *);
 
 // Directory scanning function
-void scan_directory (sqlite3 *, const fs::path &);
+// New files are added to the catalog, and those with a timbre embedding to
+// the similarity index
+void scan_directory (Database *, const fs::path &, SimilarityIndex *, 
+                     Catalog *);
 
 #endif // SCANNER_H
@@ -0,0 +1,90 @@
+#ifndef SEARCH_EXECUTOR_H
+#define SEARCH_EXECUTOR_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Project Inclusions
+#include "Catalog.h"
+#include "SearchSession.h"
+#include "SearchResults.h"
+#include "FuzzyMatch.h"
+#include "QueryLanguage.h"
+#include "TaskScheduler.h"
+
+// Results of one submitted query. Partial updates come while the catalog is
+// still being searched; the final one carries the full match count, and for
+// a structured query the key and bpm counts of its matches.
+struct SearchUpdate {
+    uint64_t generation;
+    std::vector<struct SearchHit> hits;
+    int64_t num_matches;
+    struct FacetCounts facets;
+    bool final;
+};
+
+typedef std::function<void (SearchUpdate &&update)> SearchPublisher;
+
+// SearchExecutor runs the search box's queries as PRIORITY_INTERACTIVE
+// tasks on the task scheduler, so the input and render loop never waits
+// for a search and a query never queues behind background analysis for
+// longer than one task. Queries run one at a time, in a task that lives
+// while queries keep arriving. Plain text is a fuzzy name search; a query
+// with fields or negations is run as a structured query (see
+// QueryLanguage.h).
+//
+// Each submitted query gets the next generation number. Submitting cancels
+// the query in flight: the running task's cancel flag is set and the session and
+// ranking stop at their next check, and only the newest pending query is
+// run. A query that is already stale is never run to completion.
+//
+// Results go to the publisher, on a scheduler thread: a partial update as
+// soon as a chunk of the catalog fills the result list, then the final
+// ranking. Cancelled queries publish nothing further, though an update may
+// race a newer submit, so receivers should drop stale generations.
+class SearchExecutor {
+public:
+    SearchExecutor (const Catalog *catalog, size_t num_results,
+                    SearchPublisher publisher);
+    ~SearchExecutor (void);
+
+    SearchExecutor (const SearchExecutor&) = delete;
+    SearchExecutor& operator= (const SearchExecutor&) = delete;
+
+    // queue a query, superseding any queued or running one; returns its
+    // generation
+    uint64_t submit (const std::string &query);
+
+private:
+    const Catalog *catalog;
+    size_t num_results;
+    SearchPublisher publisher;
+
+    // used by the running task only
+    SearchSession session;
+
+    std::mutex mutex;
+    std::string pending;
+    bool has_pending = false;
+    bool running = false;
+    uint64_t generation = 0;
+
+    std::atomic<bool> cancel{false};
+    TaskGroup tasks;
+
+    void run (void);
+    void execute (const std::string &query, uint64_t query_generation);
+    void execute_structured (const std::string &query, 
+                             uint64_t query_generation);
+    SearchUpdate make_update (uint64_t query_generation,
+                              const std::vector<FuzzyHit> &best,
+                              size_t num_matches, bool final) const;
+};
+
+#endif // SEARCH_EXECUTOR_H
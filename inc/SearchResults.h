@@ -0,0 +1,49 @@
+#ifndef SEARCH_RESULTS_H
+#define SEARCH_RESULTS_H
+
+// Standard Library Inclusions
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <map>
+
+// width of a bpm facet bucket; bucket b covers bpm b*10 to b*10+9
+#define FACET_BPM_BUCKET 10
+
+// One search result: just what a result list shows. The full record is
+// fetched by id when a result is opened (see Database::get_file).
+struct SearchHit {
+    int64_t id;
+    double score;
+    std::string file_name;
+    int duration;
+    int auto_key;
+};
+
+// Position after the last hit of a page in (score, id) order. A default
+// constructed cursor starts at the first result.
+struct SearchCursor {
+    bool valid = false;
+    double score = 0.0;
+    int64_t id = 0;
+};
+
+// One window of results and the cursor for the window after it
+// cancelled: the search was interrupted and the page holds what was read
+struct SearchPage {
+    std::vector<struct SearchHit> hits;
+    struct SearchCursor next;
+    bool has_more = false;
+    bool cancelled = false;
+};
+
+// Distribution of a structured query's matches (see Catalog::run_query)
+// keys: key number -> count, -1 for unknown
+// bpm_buckets: bpm / FACET_BPM_BUCKET -> count, -1 for unknown
+struct FacetCounts {
+    int64_t total = 0;
+    std::map<int, int64_t> keys;
+    std::map<int, int64_t> bpm_buckets;
+};
+
+#endif // SEARCH_RESULTS_H
@@ -0,0 +1,103 @@
+#ifndef SEARCH_SESSION_H
+#define SEARCH_SESSION_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+
+// Project Inclusions
+#include "Catalog.h"
+
+// number of recent queries whose results a session keeps
+#define SEARCH_SESSION_CACHE 64
+
+// rows searched between checks for cancellation and progress reports
+#define SEARCH_CHUNK_ROWS 65536
+
+// how a session matches names
+// SEARCH_SUBSTRING: the name contains the query (Catalog::rows_containing)
+// SEARCH_FUZZY: the query is a subsequence of the name (Catalog::fuzzy_rows)
+enum SearchMode {
+    SEARCH_SUBSTRING,
+    SEARCH_FUZZY
+};
+
+// called with the matches found so far after each chunk of a catalog scan
+typedef std::function<void (const std::vector<uint32_t> &rows)>
+    SearchProgress;
+
+// SearchSession runs the type-ahead search of one search box against the
+// catalog, reusing earlier results as the query is edited.
+//
+// Typing extends the query, and every name matching the longer query also
+// matches the shorter one (in either mode), so the new matches are found by
+// filtering the previous matches instead of scanning the catalog. The
+// session keeps a stack of the results for each prefix of the current
+// query; backspace pops back to a level already computed. Results of recent
+// queries are also kept in an LRU cache, so going back to an earlier query
+// is a lookup.
+//
+// Cached results stay valid as the scanner appends rows: each level records
+// how many catalog rows it covers and only searches the rows added since.
+// When the catalog's rows are replaced (a new epoch) everything is dropped.
+//
+// A search can be cancelled from another thread. Scans of the catalog run in
+// chunks of SEARCH_CHUNK_ROWS, and a cancelled scan keeps the chunks it
+// finished, so repeating the query resumes where it stopped.
+//
+// Matching is case insensitive. A session only finds the matching rows;
+// ranking them is up to the caller (see Catalog::rank_fuzzy).
+// A session is used by one thread at a time.
+class SearchSession {
+public:
+    explicit SearchSession (const Catalog *catalog, 
+                            SearchMode mode = SEARCH_SUBSTRING,
+                            size_t cache_size = SEARCH_SESSION_CACHE);
+
+    // The catalog rows whose name matches query, in row order, or null if
+    // cancel was set before the search finished. The rows are valid until
+    // the next call.
+    const std::vector<uint32_t> *search (
+        const std::string &query, const std::atomic<bool> *cancel = nullptr,
+        const SearchProgress &progress = nullptr);
+
+    // drop every cached result
+    void clear (void);
+
+private:
+    struct Level {
+        std::string query;           // folded
+        std::vector<uint32_t> rows;
+        size_t rows_seen = 0;        // catalog rows covered by rows
+    };
+    typedef std::shared_ptr<Level> LevelPtr;
+
+    const Catalog *catalog;
+    SearchMode mode;
+    size_t cache_size;
+    uint64_t epoch = 0;
+
+    // results for the prefixes of the current query, shortest first; each
+    // level's query is a prefix of the next one's
+    std::vector<LevelPtr> levels;
+
+    // recently used levels, most recent first, keyed by query
+    std::list<LevelPtr> recent;
+    std::unordered_map<std::string, std::list<LevelPtr>::iterator> cached;
+
+    // search the rows appended to the catalog since the level was computed,
+    // a chunk at a time; false if cancelled
+    bool catch_up (Level *level, const std::atomic<bool> *cancel,
+                   const SearchProgress &progress);
+
+    // mark a level most recently used, evicting the least recent if full
+    void touch (const LevelPtr &level);
+};
+
+#endif // SEARCH_SESSION_H
@@ -0,0 +1,127 @@
+#ifndef SIMILARITY_INDEX_H
+#define SIMILARITY_INDEX_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <random>
+#include <algorithm>
+#include <queue>
+#include <cmath>
+
+// Definitions
+#define HNSW_MAX_LINKS 16
+#define HNSW_EF_CONSTRUCTION 128
+#define HNSW_EF_SEARCH 64
+
+// serialized graph format (see SimilarityIndex::serialize)
+#define HNSW_FORMAT_MAGIC 0x57534e48u // "HNSW"
+#define HNSW_FORMAT_VERSION 1
+#define HNSW_MAX_LEVEL 64
+
+// (database row id, squared euclidean distance), closest first
+typedef std::vector<std::pair<int64_t, float>> SimilarityResults;
+
+// SimilarityIndex is an in-process approximate nearest-neighbour index over
+// timbre embeddings, implemented as a Hierarchical Navigable Small World graph
+// (Malkov & Yashunin). Vectors are keyed by their audio_files row id.
+//
+// Inserts are incremental: the scanner's insert stage adds each new record as
+// it is committed. Searches take a shared lock and may run concurrently with
+// each other; inserts are exclusive.
+//
+// The graph can be serialized whole and restored without relinking, so a
+// restart doesn't rebuild it (see Database::save_similarity_index).
+class SimilarityIndex {
+public:
+    explicit SimilarityIndex (int dims);
+
+    // add a vector under a row id, ignored if the id is already indexed or
+    // the vector has the wrong length
+    void insert (int64_t id, const std::vector<float> &vec);
+    void insert (int64_t id, const float *vec, size_t n);
+
+    // replace the vector of an indexed row, or insert it if it is new
+    // The row is unlinked from its old neighbours and relinked at its new
+    // position, so moved embeddings are found where they now belong
+    void update (int64_t id, const std::vector<float> &vec);
+
+    // top-k nearest neighbours of an arbitrary vector
+    SimilarityResults search (const std::vector<float> &query, int k) const;
+
+    // top-k nearest neighbours of an indexed row, excluding the row itself
+    SimilarityResults search_by_id (int64_t id, int k) const;
+
+    // copy the vector of an indexed row, false if the row isn't indexed
+    bool get (int64_t id, std::vector<float> *vec) const;
+
+    bool contains (int64_t id) const;
+    size_t size (void) const;
+
+    // highest row id indexed, 0 if empty
+    int64_t last_id (void) const;
+
+    // changes with every insert and update, so a caller can tell whether
+    // the index changed since it was saved
+    uint64_t revision (void) const;
+
+    // Append the graph to a buffer: a header, then each node's id, top level
+    // and vector, then each node's links per level. Little-endian, like the
+    // catalog snapshot.
+    void serialize (std::vector<uint8_t> *out) const;
+
+    // Replace the index with a serialized graph. Returns false, leaving the
+    // index unchanged, if the buffer is malformed or has other dimensions.
+    bool deserialize (const uint8_t *data, size_t bytes);
+
+private:
+    typedef std::pair<float, uint32_t> Candidate;
+
+    int dims;
+    double level_mult;
+
+    // node storage, indexed by node number
+    std::vector<float> vectors;
+    std::vector<int64_t> ids;
+    std::vector<std::vector<std::vector<uint32_t>>> links; // [node][level]
+    std::unordered_map<int64_t, uint32_t> nodes_by_id;
+
+    uint32_t entry_point = 0;
+    int max_level = -1;
+    int64_t highest_id = 0;
+    uint64_t changes = 0;
+
+    std::mt19937 rng;
+    mutable std::shared_mutex mutex;
+
+    inline const float *vector_of (uint32_t node) const;
+    float distance (const float *a, const float *b) const;
+
+    // greedy best-first search of one graph layer, closest first
+    std::vector<Candidate> search_layer (const float *query, uint32_t entry,
+                                         int ef, int level) const;
+
+    // neighbour selection heuristic: prefer candidates that are closer to the
+    // new node than to any already selected neighbour
+    std::vector<uint32_t> select_neighbours (
+        const std::vector<Candidate> &candidates, int max_links) const;
+
+    // re-select a node's links on a layer from a pool of nodes
+    void reselect (uint32_t node, int level, const std::vector<uint32_t> &pool);
+
+    // link a node to the best candidates found for it on a layer, and back
+    void connect (uint32_t node, int level, const std::vector<Candidate> &found);
+
+    // relink a node after its vector changed
+    void relink (uint32_t node);
+
+    SimilarityResults search_locked (const float *query, int k,
+                                     int64_t exclude) const;
+};
+
+#endif // SIMILARITY_INDEX_H
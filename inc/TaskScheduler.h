@@ -0,0 +1,158 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+// Standard Library Inclusions
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+// Priority classes, most urgent first. A free thread always takes the most
+// urgent queued task, so foreground work overtakes background work as soon
+// as a running task finishes.
+enum TaskPriority {
+    PRIORITY_INTERACTIVE = 0,   // search box queries
+    PRIORITY_VISIBLE,           // analysis of results on screen
+    PRIORITY_SCAN,              // directory scans
+    PRIORITY_REANALYSIS,        // re-analysis of stale files
+    TASK_PRIORITIES
+};
+
+// parallel_for splits a range into at most this many chunks per thread, so
+// uneven chunks still balance
+#define TASK_CHUNKS_PER_THREAD 4
+
+typedef std::function<void (void)> Task;
+
+// TaskScheduler runs tasks on a fixed set of worker threads, one per
+// hardware thread, shared by the whole process (see instance).
+//
+// Each worker owns one deque per priority. A task submitted from a worker
+// goes on that worker's deque, where the worker takes the newest first; a
+// task submitted from any other thread goes on a shared queue. A worker
+// looking for work tries, for each priority from the most urgent: its own
+// deque, the shared queue, then the oldest task of another worker's deque
+// (stealing). Idle workers sleep until a task is submitted.
+//
+// Tasks should not block on anything but their own task groups; a thread
+// waiting on a group runs queued tasks in the meantime.
+class TaskScheduler {
+public:
+    explicit TaskScheduler (size_t num_threads);
+    ~TaskScheduler (void);
+
+    TaskScheduler (const TaskScheduler&) = delete;
+    TaskScheduler& operator= (const TaskScheduler&) = delete;
+
+    // the process-wide scheduler, started on first use
+    static TaskScheduler &instance (void);
+
+    // queue a task that nobody waits for
+    void submit (TaskPriority priority, Task task);
+
+    size_t num_threads (void) const;
+
+    // priority of the task running on the calling thread, or fallback if
+    // it isn't running one
+    static TaskPriority current_priority (TaskPriority fallback);
+
+private:
+    friend class TaskGroup;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks[TASK_PRIORITIES];
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex shared_mutex;
+    std::deque<Task> shared[TASK_PRIORITIES];
+
+    // queued tasks per priority, so empty priorities are skipped without
+    // locking anything
+    std::atomic<size_t> queued[TASK_PRIORITIES];
+
+    // sleeping workers and group waiters
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<int> sleepers{0};
+    bool stopping = false;
+
+    void worker_loop (int index);
+
+    // index of the calling thread's worker in this scheduler, -1 for none
+    int worker_index (void) const;
+
+    // Take the most urgent task of priority up to max_priority
+    bool take (int index, int max_priority, Task *task,
+               TaskPriority *priority);
+
+    // Run one task of priority up to max_priority, false if there is none
+    bool run_one (int max_priority);
+
+    // are tasks of priority up to max_priority queued
+    bool has_work (int max_priority) const;
+
+    // wake every sleeper, after a submit or a finished group
+    void wake_sleepers (void);
+};
+
+// TaskGroup runs tasks on the scheduler and waits for all of them.
+// Waiting runs queued tasks at least as urgent as the group's, so a task
+// may wait on a group of its own subtasks without tying up a thread.
+class TaskGroup {
+public:
+    explicit TaskGroup (TaskPriority priority,
+                        TaskScheduler &scheduler = TaskScheduler::instance());
+    ~TaskGroup (void);
+
+    TaskGroup (const TaskGroup&) = delete;
+    TaskGroup& operator= (const TaskGroup&) = delete;
+
+    void run (Task task);
+
+    // wait until every task run so far has finished
+    void wait (void);
+
+private:
+    TaskScheduler &scheduler;
+    TaskPriority priority;
+    std::shared_ptr<std::atomic<size_t>> pending;
+};
+
+// Call fn(first, last) on chunks of [begin, end) of at least grain
+// elements, in parallel, and wait for all of them. The calling thread runs
+// one chunk itself.
+template <typename Fn>
+void parallel_for (TaskPriority priority, size_t begin, size_t end,
+                   size_t grain, Fn fn) {
+    if (begin >= end) {
+        return;
+    }
+    TaskScheduler &scheduler = TaskScheduler::instance();
+    size_t n = end - begin;
+    size_t max_chunks = scheduler.num_threads() * TASK_CHUNKS_PER_THREAD;
+    size_t chunks = std::min(max_chunks, (n + grain - 1) / std::max<size_t>(grain, 1));
+    if (chunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+    TaskGroup group(priority, scheduler);
+    for (size_t c = 1; c < chunks; c++) {
+        size_t first = begin + n * c / chunks;
+        size_t last = begin + n * (c + 1) / chunks;
+        group.run([&fn, first, last]() { fn(first, last); });
+    }
+    fn(begin, begin + n / chunks);
+    group.wait();
+}
+
+#endif // TASK_SCHEDULER_H
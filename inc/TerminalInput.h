@@ -0,0 +1,108 @@
+#ifndef TERMINAL_INPUT_H
+#define TERMINAL_INPUT_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <termios.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#endif
+
+// Project Inclusions
+#include "InputEvent.h"
+#include "ThreadSafeQueue.h"
+#include "SystemUtilities.h"
+
+// a lone escape byte is a key press if nothing follows it within this time,
+// otherwise it starts an escape sequence
+#define INPUT_ESCAPE_MS 25
+
+// bytes read from the terminal at a time
+#define INPUT_READ_BYTES 256
+
+// CSI parameters are clamped to this, so a long run of digits can't
+// overflow them
+#define INPUT_MAX_PARAM 9999
+
+// InputDecoder turns the bytes a terminal sends into key events: plain and
+// control characters, CSI and SS3 escape sequences for the cursor, editing
+// and function keys with xterm modifier parameters, and escape prefixed
+// characters as Alt.
+class InputDecoder {
+public:
+    // Decode bytes, appending the complete events. An escape sequence cut
+    // off at the end is kept until more bytes arrive or flush().
+    void feed (const char *bytes, size_t n, std::vector<struct InputEvent> *events);
+
+    // decode the kept bytes as they are, once no more arrived in time
+    void flush (std::vector<struct InputEvent> *events);
+
+    // are bytes of an unfinished sequence kept
+    inline bool pending (void) const { return !buffer.empty(); }
+
+private:
+    std::string buffer;
+
+    // Decode one event at pos. Returns the bytes it took, 0 if the bytes
+    // end inside a sequence and complete is false. An unknown sequence is
+    // taken whole as a KEY_NONE event.
+    size_t decode (size_t pos, bool complete, struct InputEvent *event) const;
+};
+
+// TerminalInput reads key presses from the console on its own thread and
+// pushes them onto a queue as InputEvents. The thread sleeps in poll() (or
+// WaitForMultipleObjects on Windows) until the terminal has input, so it
+// costs nothing while no keys are pressed. It also pushes INPUT_RESIZE when
+// the terminal changes size.
+//
+// On a terminal, stdin is put in raw mode for the reader's lifetime: no
+// echo or line buffering, and no flow control, so Ctrl-S and Ctrl-Q arrive
+// as keys. Ctrl-C still interrupts. When stdin reaches end of file the
+// queue is closed.
+class TerminalInput {
+public:
+    explicit TerminalInput (ThreadSafeQueue<struct InputEvent> *queue);
+    ~TerminalInput (void);
+
+    TerminalInput (const TerminalInput&) = delete;
+    TerminalInput& operator= (const TerminalInput&) = delete;
+
+private:
+    ThreadSafeQueue<struct InputEvent> *queue;
+    InputDecoder decoder;
+    std::vector<struct InputEvent> events;
+    std::thread reader;
+
+#ifdef _WIN32
+    HANDLE console = nullptr;
+    HANDLE stop_event = nullptr;
+    DWORD saved_mode = 0;
+    bool restore_mode = false;
+#else
+    int wake_pipe[2] = {-1, -1};
+    struct termios saved_mode;
+    bool restore_mode = false;
+    struct sigaction saved_winch;
+#endif
+
+    void read_loop (void);
+
+    // push the decoded events
+    void push_events (void);
+};
+
+#endif // TERMINAL_INPUT_H
@@ -0,0 +1,102 @@
+#ifndef TERMINAL_RENDERER_H
+#define TERMINAL_RENDERER_H
+
+// Standard Library Inclusions
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// frames are drawn at most this often; changes in between are drawn together
+#define RENDER_FRAME_MS 16
+
+// size used when the output isn't a terminal
+#define RENDER_DEFAULT_ROWS 24
+#define RENDER_DEFAULT_COLS 80
+
+// a cursor move costs about this many bytes, so shorter runs of unchanged
+// cells between changes are rewritten instead of skipped
+#define RENDER_MAX_GAP 6
+
+enum CellStyle : uint8_t {
+    STYLE_NORMAL = 0,
+    STYLE_BOLD,
+    STYLE_REVERSE,
+};
+
+// one character cell of the screen
+struct TerminalCell {
+    char ch = ' ';
+    uint8_t style = STYLE_NORMAL;
+
+    inline bool operator== (const TerminalCell &other) const {
+        return ch == other.ch && style == other.style;
+    }
+    inline bool operator!= (const TerminalCell &other) const {
+        return !(*this == other);
+    }
+};
+
+// TerminalRenderer draws frames on an ANSI terminal by difference. A frame
+// is drawn into the back buffer; present() compares it with the front
+// buffer, which holds what is on screen, and writes only the cells that
+// changed, with cursor moves between them, in a single write. A frame that
+// changes nothing writes nothing. When the terminal is resized the next
+// frame clears the screen and is drawn in full.
+//
+// The renderer switches to the alternate screen and hides the cursor for
+// its lifetime. One cell holds one byte, so bytes outside printable ascii
+// are drawn as '?'.
+class TerminalRenderer {
+public:
+    explicit TerminalRenderer (FILE *out = stderr);
+    ~TerminalRenderer (void);
+
+    TerminalRenderer (const TerminalRenderer&) = delete;
+    TerminalRenderer& operator= (const TerminalRenderer&) = delete;
+
+    // start a frame: pick up the terminal size and blank the back buffer
+    void begin_frame (void);
+
+    inline int rows (void) const { return height; }
+    inline int cols (void) const { return width; }
+
+    // write text from a cell, clipped to the screen
+    // Returns the column after the text.
+    int put (int row, int col, std::string_view text,
+             uint8_t style = STYLE_NORMAL);
+
+    // set count cells from a cell to ch
+    void fill (int row, int col, int count, char ch,
+               uint8_t style = STYLE_NORMAL);
+
+    // write the changed cells to the terminal, returns the bytes written
+    size_t present (void);
+
+private:
+    FILE *out;
+    int width = 0;
+    int height = 0;
+    std::vector<struct TerminalCell> front;
+    std::vector<struct TerminalCell> back;
+    bool full_repaint = true;
+    std::string output;
+
+    // the terminal's size, or the default size if out isn't a terminal
+    void query_size (int *rows, int *cols) const;
+
+    // append escape sequences to output
+    void move_cursor (int row, int col);
+    void set_style (uint8_t style);
+};
+
+#endif // TERMINAL_RENDERER_H
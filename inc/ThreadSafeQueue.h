@@ -1,112 +1,396 @@
 #ifndef THREAD_SAFE_QUEUE_H
 #define THREAD_SAFE_QUEUE_H
 
-#include <queue>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
+#include <thread>
 
+// default capacity of a queue, rounded up to a power of two
+#define QUEUE_DEFAULT_CAPACITY 1024
+
+// size of a cache line, so the producer and consumer positions don't share
+// one
+#define QUEUE_CACHE_LINE 64
+
+// times a blocked push or pop yields before it sleeps
+#define QUEUE_SPIN_LIMIT 16
+
+// ThreadSafeQueue is a bounded multi-producer, multi-consumer queue.
+//
+// Values live in a ring of cells, each with a sequence number that says
+// whether the cell is ready to be written or read for the current lap.
+// Producers claim a cell by advancing the enqueue position with a compare
+// and swap, consumers likewise with the dequeue position, so try_push and
+// try_pop never take a lock. The two positions sit on their own cache lines.
+//
+// The blocking calls only fall back to a mutex and condition variable once
+// the ring is full (push) or empty (pop) and stays so for a few yields, and
+// a successful push or pop only touches the mutex when some thread is
+// waiting on the other side. A stage blocked on an idle queue sleeps rather
+// than spins.
+//
+// close() ends the queue: waiters wake, pushes fail, and pops return false
+// once the remaining values are drained. Close after the last push.
 template <typename T>
 class ThreadSafeQueue {
 public:
-    // Push a value onto the queue, guaranteed to push
-    void push(T value);
+    explicit ThreadSafeQueue(size_t capacity = QUEUE_DEFAULT_CAPACITY);
+
+    ThreadSafeQueue(const ThreadSafeQueue&) = delete;
+    ThreadSafeQueue& operator=(const ThreadSafeQueue&) = delete;
+
+    // Push a value, waiting while the queue is full
+    // Returns false, dropping the value, if the queue is closed
+    bool push(T value);
+
+    // Push if there is room, return whether pushed or not
+    bool try_push(T& value);
+
+    // Push every value, waiting for room as needed; values are moved from
+    // Returns how many were pushed, fewer than all if the queue closed
+    size_t push_batch(std::vector<T>& values);
 
     // Pop if the queue is not empty, return whether popped or not
     bool try_pop(T& value);
 
-    // Wait and pop a value from the queue
-    void wait_pop(T& value);
+    // Wait for a value
+    // Returns false once the queue is closed and empty
+    bool pop(T& value);
 
-    // Get the size of the queue
-    int size() const;
+    // Wait for a value until a deadline, or for a timeout
+    // Returns false on timeout, or once the queue is closed and empty
+    bool pop_until(T& value,
+                   const std::chrono::steady_clock::time_point& deadline);
+    template <typename Rep, typename Period>
+    bool pop_for(T& value, const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_until(value, std::chrono::steady_clock::now() + timeout);
+    }
 
-    // Check if the queue is empty
-    bool empty() const;
+    // Wait for a value, then append it and whatever else is queued, up to
+    // max_values in all, to values
+    // Returns how many were appended, 0 once the queue is closed and empty
+    size_t pop_batch(std::vector<T>* values, size_t max_values);
+
+    // pop_batch with a deadline; returns 0 on timeout
+    size_t pop_batch_until(std::vector<T>* values, size_t max_values,
+                   const std::chrono::steady_clock::time_point& deadline);
 
-    // Check if the queue is in producing state
-    bool is_producing();
+    // Close the queue and wake every waiter
+    void close();
 
-    // Start producing state
-    void start_producing();
+    bool is_closed() const;
 
-    // Stop producing state
-    void stop_producing();
+    // Number of queued values; a snapshot while other threads push and pop
+    size_t size() const;
+
+    bool empty() const;
+
+    size_t capacity() const;
 
 private:
-    mutable std::mutex mutex;
-    std::queue<T> queue;
-    std::condition_variable cv;
-    bool producing = false;
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> enqueue_pos{0};
+    alignas(QUEUE_CACHE_LINE) std::atomic<size_t> dequeue_pos{0};
+    alignas(QUEUE_CACHE_LINE) std::atomic<bool> closed{false};
+
+    // threads blocked in a push or pop, so the other side knows to notify
+    std::atomic<int> push_waiters{0};
+    std::atomic<int> pop_waiters{0};
+
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+
+    bool push_cell(T& value);
+    bool pop_cell(T& value);
+
+    // append up to max_values already queued values without waiting
+    size_t pop_more(std::vector<T>* values, size_t max_values);
+
+    // wake one waiter, or all of them after a batch
+    void wake(std::atomic<int>& waiters, std::condition_variable& cv,
+              bool all);
+
+    // Block until ready() or closed, or the deadline passes
+    // Returns false on timeout
+    template <typename Ready>
+    bool wait(std::atomic<int>& waiters, std::condition_variable& cv,
+              Ready ready, const std::chrono::steady_clock::time_point* deadline);
 };
 
-// push a value on the queue
-// gauranteed to push
 template <typename T>
-void ThreadSafeQueue<T>::push (T value) {
-    std::lock_guard<std::mutex> lock(mutex);
-    queue.push(std::move(value));
-    cv.notify_one();
+ThreadSafeQueue<T>::ThreadSafeQueue (size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+    cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mask = size - 1;
 }
 
-// pop if the queue is not empty
-// return whether popped or not
+// A cell is free for the producer at pos when its sequence is pos, and
+// holds a value for the consumer at pos when its sequence is pos + 1. The
+// consumer hands the cell to the next lap's producer with pos + capacity.
 template <typename T>
-bool ThreadSafeQueue<T>::try_pop (T& value) {
+bool ThreadSafeQueue<T>::push_cell (T& value) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    cell->value = std::move(value);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool ThreadSafeQueue<T>::pop_cell (T& value) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+        cell = &cells[pos & mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) -
+                        static_cast<intptr_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                                  std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    value = std::move(cell->value);
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    return true;
+}
+
+// The fence pairs with the waiter's: either the waker sees the waiter's
+// count, or the waiter sees the ring change before it sleeps.
+template <typename T>
+void ThreadSafeQueue<T>::wake (std::atomic<int>& waiters,
+                               std::condition_variable& cv, bool all) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (all) {
+            cv.notify_all();
+        } else {
+            cv.notify_one();
+        }
+    }
+}
+
+template <typename T>
+template <typename Ready>
+bool ThreadSafeQueue<T>::wait (std::atomic<int>& waiters,
+                               std::condition_variable& cv, Ready ready,
+                    const std::chrono::steady_clock::time_point* deadline) {
+    // a short wait is cheaper to ride out than to sleep through
+    for (int i = 0; i < QUEUE_SPIN_LIMIT; i++) {
+        if (ready() || closed.load(std::memory_order_acquire)) {
+            return true;
+        }
+        std::this_thread::yield();
+    }
+
     std::unique_lock<std::mutex> lock(mutex);
-    if (queue.empty()) {
+    waiters.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto done = [&]() {
+        return ready() || closed.load(std::memory_order_acquire);
+    };
+    bool woken = true;
+    if (deadline) {
+        woken = cv.wait_until(lock, *deadline, done);
+    } else {
+        cv.wait(lock, done);
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return woken;
+}
+
+template <typename T>
+bool ThreadSafeQueue<T>::try_push (T& value) {
+    if (closed.load(std::memory_order_acquire) || !push_cell(value)) {
         return false;
     }
-    value = std::move(queue.front());
-    queue.pop();
+    wake(pop_waiters, not_empty, false);
     return true;
 }
 
 template <typename T>
-void ThreadSafeQueue<T>::wait_pop (T& value) {
-    std::unique_lock<std::mutex> lock(mutex);
-    cv.wait(lock, [this]() { return !queue.empty(); });
-    value = std::move(queue.front());
-    queue.pop();
+bool ThreadSafeQueue<T>::push (T value) {
+    while (!closed.load(std::memory_order_acquire)) {
+        if (push_cell(value)) {
+            wake(pop_waiters, not_empty, false);
+            return true;
+        }
+        wait(push_waiters, not_full, [this]() { return size() <= mask; },
+             nullptr);
+    }
+    return false;
+}
+
+// consumers are woken once the ring fills or the batch ends, not per value
+template <typename T>
+size_t ThreadSafeQueue<T>::push_batch (std::vector<T>& values) {
+    size_t pushed = 0;
+    while (pushed < values.size() && !closed.load(std::memory_order_acquire)) {
+        if (push_cell(values[pushed])) {
+            pushed++;
+            continue;
+        }
+        wake(pop_waiters, not_empty, true);
+        wait(push_waiters, not_full, [this]() { return size() <= mask; },
+             nullptr);
+    }
+    if (pushed > 0) {
+        wake(pop_waiters, not_empty, true);
+    }
+    return pushed;
 }
 
 template <typename T>
-int ThreadSafeQueue<T>::size() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return queue.size();
+bool ThreadSafeQueue<T>::try_pop (T& value) {
+    if (!pop_cell(value)) {
+        return false;
+    }
+    wake(push_waiters, not_full, false);
+    return true;
 }
 
 template <typename T>
-bool ThreadSafeQueue<T>::empty() const {
-    std::lock_guard<std::mutex> lock(mutex);
-    return queue.empty();
+bool ThreadSafeQueue<T>::pop (T& value) {
+    while (true) {
+        if (try_pop(value)) {
+            return true;
+        }
+        // a value pushed before close is still delivered
+        if (closed.load(std::memory_order_acquire)) {
+            return try_pop(value);
+        }
+        wait(pop_waiters, not_empty, [this]() { return !empty(); }, nullptr);
+    }
 }
 
 template <typename T>
-bool ThreadSafeQueue<T>::is_producing (void) {
-    bool result;
-    {
-        std::unique_lock<std::mutex> lock(mutex);
-        result = producing;
+bool ThreadSafeQueue<T>::pop_until (T& value,
+                    const std::chrono::steady_clock::time_point& deadline) {
+    while (true) {
+        if (try_pop(value)) {
+            return true;
+        }
+        if (closed.load(std::memory_order_acquire)) {
+            return try_pop(value);
+        }
+        if (!wait(pop_waiters, not_empty, [this]() { return !empty(); },
+                  &deadline)) {
+            return try_pop(value);
+        }
     }
-    return result;
 }
 
 template <typename T>
-void ThreadSafeQueue<T>::start_producing (void) {
-    {
-        std::unique_lock<std::mutex> lock(mutex);
-        producing = true;
+size_t ThreadSafeQueue<T>::pop_batch (std::vector<T>* values,
+                                      size_t max_values) {
+    T value;
+    if (max_values == 0 || !pop(value)) {
+        return 0;
     }
-    cv.notify_all();
+    values->push_back(std::move(value));
+    return 1 + pop_more(values, max_values - 1);
 }
 
 template <typename T>
-void ThreadSafeQueue<T>::stop_producing (void) {
+size_t ThreadSafeQueue<T>::pop_batch_until (std::vector<T>* values,
+                                            size_t max_values,
+                    const std::chrono::steady_clock::time_point& deadline) {
+    T value;
+    if (max_values == 0 || !pop_until(value, deadline)) {
+        return 0;
+    }
+    values->push_back(std::move(value));
+    return 1 + pop_more(values, max_values - 1);
+}
+
+// producers are woken once for the whole batch, not per value
+template <typename T>
+size_t ThreadSafeQueue<T>::pop_more (std::vector<T>* values,
+                                     size_t max_values) {
+    T value;
+    size_t popped = 0;
+    while (popped < max_values && pop_cell(value)) {
+        values->push_back(std::move(value));
+        popped++;
+    }
+    if (popped > 0) {
+        wake(push_waiters, not_full, true);
+    }
+    return popped;
+}
+
+template <typename T>
+void ThreadSafeQueue<T>::close (void) {
     {
-        std::unique_lock<std::mutex> lock(mutex);
-        producing = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        closed.store(true, std::memory_order_release);
     }
-    cv.notify_all();
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+template <typename T>
+bool ThreadSafeQueue<T>::is_closed (void) const {
+    return closed.load(std::memory_order_acquire);
+}
+
+template <typename T>
+size_t ThreadSafeQueue<T>::size (void) const {
+    size_t head = dequeue_pos.load(std::memory_order_acquire);
+    size_t tail = enqueue_pos.load(std::memory_order_acquire);
+    return (tail > head) ? tail - head : 0;
+}
+
+template <typename T>
+bool ThreadSafeQueue<T>::empty (void) const {
+    return size() == 0;
+}
+
+template <typename T>
+size_t ThreadSafeQueue<T>::capacity (void) const {
+    return mask + 1;
 }
 
-#endif
\ No newline at end of file
+#endif
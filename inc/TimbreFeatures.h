@@ -0,0 +1,51 @@
+#ifndef TIMBRE_FEATURES_H
+#define TIMBRE_FEATURES_H
+
+// Standard Library Inclusions
+#include <vector>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+// Definitions
+#define TIMBRE_BANDS 16
+#define TIMBRE_DIMS (TIMBRE_BANDS + 8)
+#define TIMBRE_MIN_FREQ 40.0f
+#define TIMBRE_MAX_FREQ 16000.0f
+
+// bump when a change to the embedding should trigger re-analysis
+#define TIMBRE_ANALYZER_VERSION 1
+
+// TimbreMap accumulates spectral and temporal statistics over the FFT windows
+// of a file. Like MidiMap, segments may be accumulated from several threads.
+//
+// The embedding is a fixed-length vector of TIMBRE_DIMS floats:
+//  [0, 16)  log band energies on a log-frequency scale, mean removed
+//  [16, 20) spectral centroid, spread, rolloff and flatness
+//  [20, 24) mean and deviation of window loudness, zero crossings, crest factor
+class TimbreMap {
+private:
+    std::mutex mutex;
+    int num_windows = 0;
+
+    double band_energy[TIMBRE_BANDS] = {0.0};
+    double centroid = 0.0;
+    double spread = 0.0;
+    double rolloff = 0.0;
+    double flatness = 0.0;
+
+    double loudness = 0.0;
+    double loudness_sq = 0.0;
+    double zero_crossings = 0.0;
+    double crest = 0.0;
+
+public:
+    // accumulate one window: its magnitude spectrum and its time domain samples
+    void accumulate (const float *magnitudes, int num_bins, int sample_rate,
+                     const float *samples, int num_samples);
+
+    // produce the TIMBRE_DIMS embedding, empty if nothing was accumulated
+    std::vector<float> embedding (void);
+};
+
+#endif // TIMBRE_FEATURES_H
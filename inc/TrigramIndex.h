@@ -0,0 +1,68 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+// Project Inclusions
+#include "PostingList.h"
+
+// candidate lists at or below this size are verified directly instead of
+// being intersected with the remaining trigram lists
+#define TRIGRAM_DIRECT_VERIFY 32
+
+// shortest query that approximate matching applies to
+#define TRIGRAM_FUZZY_MIN_LENGTH 4
+
+// TrigramIndex maps every three byte sequence of a set of documents to the
+// ascending list of documents containing it, stored compressed. A document
+// containing a pattern contains all of the pattern's trigrams, so the
+// intersection of those lists is a small superset of the matches; callers
+// verify the candidates against the text.
+//
+// Documents are numbered by the caller and must be added in ascending order,
+// which keeps each list sorted as it grows. Text is indexed as given; fold
+// case before adding and before searching.
+class TrigramIndex {
+public:
+    void add (uint32_t doc, std::string_view text);
+
+    // Documents containing every trigram of pattern, in ascending order.
+    // Lists are intersected rarest first; pattern must be at least three
+    // characters long.
+    std::vector<uint32_t> candidates (std::string_view pattern) const;
+
+    // An upper bound on the documents containing pattern, without decoding
+    // anything: the length of its rarest trigram's list. pattern must be at
+    // least three characters long.
+    size_t estimate (std::string_view pattern) const;
+
+    void clear (void);
+
+    // every trigram with its list, in ascending trigram order, for writing
+    // the index out
+    std::vector<std::pair<uint32_t, const CompressedPostingList*>> lists (void) const;
+
+    // set the list of a trigram, typically one viewing a written out index
+    void set_list (uint32_t trigram, const CompressedPostingList &list);
+
+    // bytes used by the posting lists
+    size_t memory (void) const;
+
+private:
+    std::unordered_map<uint32_t, CompressedPostingList> postings;
+};
+
+// Find needle in text with at most max_edits (0 or 1) single character
+// insertions, deletions or substitutions. Returns the start of the
+// occurrence, exact occurrences first, or npos; edits receives the number of
+// edits the occurrence needed.
+size_t find_approximate (std::string_view text, std::string_view needle,
+                         int max_edits, int *edits);
+
+#endif // TRIGRAM_INDEX_H
@@ -2,16 +2,19 @@
 #define UI_H
 
 #include "UIState.h"
+#include "TerminalRenderer.h"
 #include <iostream>
 #include <string>
-#include <windows.h>
+#include <vector>
+#include <algorithm>
 
-std::string format_string (std::string str, size_t length);
+// number of search results shown at once
+#define UI_RESULT_ROWS 5
 
-void render_ui (UIState *ui_state);
+std::string format_string (std::string str, size_t length);
 
-void print_search_results (std::vector<struct FileRecord> results, int n);
+void render_ui (UIState *ui_state, TerminalRenderer *renderer);
 
-void ui_hide_cursor (void);
+void print_search_results (const std::vector<struct SearchHit> &results, int n);
 
 #endif // UI_H
\ No newline at end of file
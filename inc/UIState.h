@@ -4,33 +4,54 @@
 
 #include <string>
 #include <vector>
+#include <mutex>
+#include <atomic>
 
-#include "MKBDIO.h"
+#include "InputEvent.h"
 #include "ThreadSafeQueue.h"
 #include "FileRecord.h"
+#include "SearchResults.h"
+#include "SearchExecutor.h"
 
 class UIState {
 public:
     char frame = 's'; // s search, r results
     
-    ThreadSafeQueue<char> *control_queue;
+    // key presses, resizes and result notifications, in order
+    ThreadSafeQueue<struct InputEvent> *control_queue = nullptr;
 
     std::string search_buffer = "";
     std::string search_query = "";
     int search_cursor = 0;
     bool search_exec = false;
 
-    std::vector<struct FileRecord> files;
+    // the current page of results, the total match count and, for a
+    // structured query, the matches per key and bpm bucket
+    // Written by the search executor's thread; read under results_mutex.
+    std::vector<struct SearchHit> files;
+    int64_t num_matches = 0;
+    struct FacetCounts facets;
     int file_scroll = 0;
+    std::mutex results_mutex;
+
+    // generation of the last submitted query, and whether the results shown
+    // are its final ones
+    uint64_t search_generation = 0;
+    bool results_final = true;
 
     void process_inputs (void);
-    void input_dispatch (char input);
-    inline bool is_command (char input);
+    void input_dispatch (const struct InputEvent &input);
+    inline bool is_command (const struct InputEvent &input);
 
+    // switch frames on Ctrl and a letter
     void command_handler (char command);
 
-    void search_control_handler (char input);
-    void update_search_buffer (char input);
+    void search_control_handler (const struct InputEvent &input);
+    void update_search_buffer (const struct InputEvent &input);
+
+    // Take a search executor update, dropping updates of older queries. An
+    // INPUT_RESULTS event is queued so the ui thread wakes to draw it.
+    void publish_results (SearchUpdate &&update);
     
     // void result_control_handler(char c);
 
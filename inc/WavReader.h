@@ -0,0 +1,58 @@
+#ifndef WAV_READER_H
+#define WAV_READER_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+// format tags of the fmt chunk
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// frames read from the file at a time
+#define WAV_READ_FRAMES 4096
+
+// Layout of a WAV file's samples, from its header
+struct WavFormat {
+    int format = 0;             // WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+    int channels = 0;
+    int sample_rate = 0;
+    int bits_per_sample = 0;
+    int block_align = 0;        // bytes per frame
+    uint64_t data_offset = 0;
+    uint64_t frames = 0;        // whole frames present in the file
+};
+
+// WavReader streams the samples of a WAV file, mixed down to mono, without
+// holding more than WAV_READ_FRAMES frames of the file in memory. Samples
+// are converted and mixed exactly as AudioFile and make_mono() do, so an
+// analysis gives the same results either way. 8, 16, 24 and 32 bit PCM and
+// 32 bit float files are supported.
+class WavReader {
+public:
+    // open a file and parse its header; false if it isn't a WAV file of a
+    // supported format
+    bool open (const std::string &path);
+
+    inline const WavFormat &format (void) const { return fmt; }
+
+    // Read the next n frames, or as many as are left, as mono samples
+    // Returns the number of frames read.
+    size_t read_mono (float *out, size_t n);
+
+private:
+    std::ifstream file;
+    WavFormat fmt;
+    uint64_t position = 0;
+    std::vector<uint8_t> raw;
+
+    // one sample at p, in [-1, 1]
+    float sample (const uint8_t *p) const;
+};
+
+#endif // WAV_READER_H
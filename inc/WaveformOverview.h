@@ -0,0 +1,57 @@
+#ifndef WAVEFORM_OVERVIEW_H
+#define WAVEFORM_OVERVIEW_H
+
+// Standard Library Inclusions
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Definitions
+// level 0 has OVERVIEW_MAX_BINS bins, each following level is
+// OVERVIEW_LEVEL_STEP times coarser: 1024, 256, 64, 16 bins
+#define OVERVIEW_MAX_BINS 1024
+#define OVERVIEW_LEVEL_STEP 4
+#define OVERVIEW_LEVELS 4
+#define OVERVIEW_BYTES_PER_BIN 3
+
+// bump when a change to the pyramid should trigger re-analysis
+#define OVERVIEW_ANALYZER_VERSION 1
+
+// One zoom level of a waveform overview.
+// peaks holds OVERVIEW_BYTES_PER_BIN signed bytes per bin: min, max and rms,
+// each scaled from [-1, 1] to [-127, 127].
+struct WaveformLevel {
+    int bins = 0;
+    std::vector<int8_t> peaks;
+
+    inline int8_t min (int bin) const { return peaks[bin * 3]; }
+    inline int8_t max (int bin) const { return peaks[bin * 3 + 1]; }
+    inline int8_t rms (int bin) const { return peaks[bin * 3 + 2]; }
+};
+
+// A min/max/rms peak pyramid, finest level first
+typedef std::vector<WaveformLevel> WaveformOverview;
+
+// WaveformMap accumulates decoded samples into the finest overview level.
+// Blocks may arrive in any order but must not overlap.
+class WaveformMap {
+private:
+    size_t total_samples;
+    int bins;
+    std::vector<float> bin_min;
+    std::vector<float> bin_max;
+    std::vector<double> bin_sum_sq;
+    std::vector<int> bin_count;
+
+public:
+    explicit WaveformMap (size_t total_samples);
+
+    // accumulate a block of mono samples starting at sample index start
+    void accumulate (size_t start, const float *samples, size_t num_samples);
+
+    // quantize the finest level and merge it down into the coarser levels
+    WaveformOverview pyramid (void);
+};
+
+#endif // WAVEFORM_OVERVIEW_H
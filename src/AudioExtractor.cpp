@@ -0,0 +1,145 @@
+#include "../inc/AudioExtractor.h"
+
+MemoryBudget &decode_budget (void) {
+    static MemoryBudget budget(static_cast<size_t>(DECODE_BUDGET_MB) << 20);
+    return budget;
+}
+
+// fft windows analyzed in a file of num_samples samples
+// files shorter than one window are processed as a single padded segment
+static size_t count_windows (size_t num_samples) {
+    if (num_samples == 0) {
+        return 0;
+    }
+    if (num_samples < FFT_WINDOW_SIZE) {
+        return 1;
+    }
+    return (num_samples - FFT_WINDOW_SIZE) / FFT_WINDOW_SIZE + 1;
+}
+
+struct DecodePlan plan_decode (const std::string &path) {
+    struct DecodePlan plan;
+    std::error_code error;
+    uint64_t file_size = std::filesystem::file_size(path, error);
+    if (error) {
+        file_size = 0;
+    }
+
+    WavReader reader;
+    if (!reader.open(path)) {
+        plan.footprint = static_cast<size_t>(file_size * DECODE_UNKNOWN_RATIO);
+        return plan;
+    }
+    const WavFormat &format = reader.format();
+    plan.footprint = static_cast<size_t>(file_size + format.frames * 
+                     (format.channels + 1) * sizeof(float));
+
+    size_t stream_footprint = DECODE_STREAM_WINDOWS * FFT_WINDOW_SIZE * 
+                              sizeof(float) + 
+                              WAV_READ_FRAMES * format.block_align;
+    if (plan.footprint > decode_budget().limit() / DECODE_STREAM_DIVISOR &&
+        stream_footprint < plan.footprint) {
+        plan.streaming = true;
+        plan.footprint = stream_footprint;
+    }
+    return plan;
+}
+
+// Analyze a block of mono samples starting at sample first of the file:
+// every fft window that starts in the block, and the overview
+// Blocks hold whole windows, except at the end of the file.
+static void analyze_block (const std::vector<float> &block, size_t first,
+                           size_t num_windows, int sample_rate,
+                           MidiMap *midi_map, TimbreMap *timbre_map,
+                           WaveformMap *waveform_map) {
+    size_t first_window = (first + FFT_WINDOW_SIZE - 1) / FFT_WINDOW_SIZE;
+    size_t end_window = std::min(num_windows, 
+        (first + block.size() + FFT_WINDOW_SIZE - 1) / FFT_WINDOW_SIZE);
+    if (first_window < end_window) {
+        parallel_for(TaskScheduler::current_priority(PRIORITY_SCAN), 
+                     first_window, end_window, ANALYSIS_WINDOWS_PER_TASK, 
+                     [&](size_t begin, size_t end) {
+            for (size_t w = begin; w < end; w++) {
+                process_segment(&block, 
+                                static_cast<int>(w * FFT_WINDOW_SIZE - first),
+                                sample_rate, midi_map, timbre_map);
+            }
+        });
+    }
+
+    // the waveform overview covers every sample, including the tail that
+    // doesn't fill a whole fft window
+    for (size_t i = 0; i < block.size(); i += FFT_WINDOW_SIZE) {
+        size_t n = std::min<size_t>(FFT_WINDOW_SIZE, block.size() - i);
+        waveform_map->accumulate(first + i, block.data() + i, n);
+    }
+}
+
+bool extract_audio_features (const std::string &path, 
+                             const struct DecodePlan &plan,
+                             struct FileRecord *record) {
+    
+    record->auto_key = -1;
+    record->duration = 0;
+    record->timbre.clear();
+    record->overview.clear();
+
+    if (!path_is_ascii(path)) {
+        return false;
+    }
+
+    MidiMap midi_map;
+    TimbreMap timbre_map;
+    int sample_rate = 0;
+    size_t num_samples = 0;
+    std::unique_ptr<WaveformMap> waveform_map;
+
+    if (plan.streaming) {
+        // read a block of whole windows at a time
+        WavReader reader;
+        if (!reader.open(path)) {
+            return false;
+        }
+        sample_rate = reader.format().sample_rate;
+        num_samples = static_cast<size_t>(reader.format().frames);
+        size_t num_windows = count_windows(num_samples);
+        waveform_map.reset(new WaveformMap(num_samples));
+
+        std::vector<float> block;
+        size_t first = 0;
+        while (first < num_samples) {
+            block.resize(std::min<size_t>(DECODE_STREAM_WINDOWS * 
+                                          FFT_WINDOW_SIZE, num_samples - first));
+            block.resize(reader.read_mono(block.data(), block.size()));
+            if (block.empty()) {
+                return false;
+            }
+            analyze_block(block, first, num_windows, sample_rate, &midi_map, 
+                          &timbre_map, waveform_map.get());
+            first += block.size();
+        }
+    } else {
+        // get audio file samples
+        AudioFile<float> file;
+        if (!file.load(path)) {
+            return false;
+        }
+        sample_rate = file.getSampleRate();
+        const std::vector<float> samples = make_mono(file.samples);
+        num_samples = samples.size();
+        waveform_map.reset(new WaveformMap(num_samples));
+        analyze_block(samples, 0, count_windows(num_samples), sample_rate,
+                      &midi_map, &timbre_map, waveform_map.get());
+    }
+
+    if (sample_rate > 0) {
+        record->duration = static_cast<int>(
+            1000.0 * num_samples / sample_rate);
+    }
+
+    // assign key and timbre based on fft results
+    record->auto_key = assign_key(&midi_map);
+    record->timbre = timbre_map.embedding();
+    record->overview = waveform_map->pyramid();
+    return true;
+}
@@ -0,0 +1,1277 @@
+// Standard Library Inclusions
+#include <fstream>
+#include <filesystem>
+#include <queue>
+
+// Project Inclusions
+#include "..\inc\Catalog.h"
+
+static char fold_char (char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+int Catalog::effective_key (const struct FileRecord &file) {
+    return (file.user_key > 0) ? file.user_key - 1 : file.auto_key;
+}
+
+int Catalog::effective_bpm (const struct FileRecord &file) {
+    return (file.user_bpm > 0) ? file.user_bpm : file.auto_bpm;
+}
+
+static std::string fold_string (const std::string &str) {
+    std::string folded_str;
+    for (char c : str) {
+        folded_str.push_back(fold_char(c));
+    }
+    return folded_str;
+}
+
+size_t Catalog::name_end (size_t row) const {
+    return (row + 1 < ids.size()) ? name_offsets[row + 1] - 1 
+                                  : folded.size() - 1;
+}
+
+int64_t Catalog::find_row (int64_t id) const {
+    const int64_t *begin = ids.data();
+    const int64_t *end = begin + ids.size();
+    const int64_t *it = std::lower_bound(begin, end, id);
+    return (it != end && *it == id) ? it - begin : -1;
+}
+
+bool Catalog::append_row (int64_t id, int64_t dir_id, std::string_view dir,
+                          std::string_view name, int64_t size, int duration,
+                          int key, int bpm) {
+    if (!ids.empty() && id <= ids.back()) {
+        return false;
+    }
+    uint32_t row = static_cast<uint32_t>(ids.size());
+
+    ids.push_back(id);
+    name_offsets.push_back(static_cast<uint32_t>(names.size()));
+    names.append(name.data(), name.size());
+    names.push_back('\0');
+    fold_buffer.clear();
+    for (char c : name) {
+        fold_buffer.push_back(fold_char(c));
+    }
+    folded.append(fold_buffer.c_str(), fold_buffer.size() + 1);
+    name_trigrams.add(row, fold_buffer);
+    char_masks.push_back(fuzzy_char_mask(fold_buffer));
+    sizes.push_back(size);
+    durations.push_back(duration);
+    bpms.push_back(static_cast<int16_t>(bpm));
+    keys.push_back(static_cast<int8_t>(key));
+    dirs.push_back(static_cast<uint32_t>(dir_id));
+
+    // directory ids index the directory table directly
+    while (dir_offsets.size() <= static_cast<size_t>(dir_id)) {
+        dir_offsets.push_back(SNAPSHOT_NO_DIRECTORY);
+    }
+    if (dir_offsets[dir_id] == SNAPSHOT_NO_DIRECTORY) {
+        dir_offsets.set(dir_id, static_cast<uint32_t>(dir_names.size()));
+        dir_names.append(dir.data(), dir.size());
+        dir_names.push_back('\0');
+    }
+    return true;
+}
+
+// rows are appended in order, so each posting list stays sorted
+void Catalog::add_tags (uint32_t row, std::string_view tags) {
+    size_t start = 0;
+    while (start < tags.size()) {
+        size_t end = tags.find(' ', start);
+        if (end == std::string_view::npos) {
+            end = tags.size();
+        }
+        if (end > start) {
+            tag_buffer.assign(tags.data() + start, end - start);
+            auto result = tag_ids.emplace(tag_buffer, 
+                                          static_cast<uint32_t>(tag_rows.size()));
+            if (result.second) {
+                tag_trigrams.add(result.first->second, fold_string(tag_buffer));
+                tag_names.push_back(tag_buffer);
+                tag_rows.emplace_back();
+            }
+            std::vector<uint32_t> &rows = tag_rows[result.first->second];
+            if (rows.empty() || rows.back() != row) {
+                rows.push_back(row);
+            }
+        }
+        start = end + 1;
+    }
+}
+
+void Catalog::insert (int64_t id, int64_t dir_id, std::string_view dir,
+                      std::string_view name, int64_t size, int duration,
+                      int key, int bpm, std::string_view tags) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (append_row(id, dir_id, dir, name, size, duration, key, bpm)) {
+        add_tags(static_cast<uint32_t>(ids.size() - 1), tags);
+    }
+}
+
+void Catalog::insert (int64_t id, int64_t dir_id, const RecordBatch &batch,
+                      const PackedRecord &record) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (append_row(id, dir_id, batch.text(record.dir), 
+                   batch.text(record.file_name), record.file_size, 
+                   record.duration, RecordBatch::effective_key(record),
+                   RecordBatch::effective_bpm(record))) {
+        uint32_t row = static_cast<uint32_t>(ids.size() - 1);
+        add_tags(row, batch.text(record.auto_tags));
+        add_tags(row, batch.text(record.user_tags));
+    }
+}
+
+void Catalog::update_analysis (int64_t id, const struct FileRecord &file) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    int64_t row = find_row(id);
+    if (row < 0) {
+        return;
+    }
+    durations.set(row, file.duration);
+    keys.set(row, static_cast<int8_t>(effective_key(file)));
+}
+
+// long loops poll their cancel flag every this many rows
+#define CANCEL_POLL_ROWS 4096
+
+static inline bool cancelled (const std::atomic<bool> *cancel, size_t i) {
+    return (i % CANCEL_POLL_ROWS) == 0 && cancel && 
+           cancel->load(std::memory_order_relaxed);
+}
+
+// the end of a chunk of at most max_rows rows from first_row, in n rows
+static size_t chunk_end (size_t first_row, size_t max_rows, size_t n) {
+    return (max_rows < n - first_row) ? first_row + max_rows : n;
+}
+
+std::vector<uint32_t> Catalog::rows_containing (const std::string &needle,
+                                                size_t first_row,
+                                                size_t *end_row,
+                                                size_t max_rows) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const size_t n = ids.size();
+    *end_row = n;
+
+    std::vector<uint32_t> rows;
+    if (first_row >= n) {
+        return rows;
+    }
+    size_t last = chunk_end(first_row, max_rows, n);
+    *end_row = last;
+    if (needle.empty()) {
+        for (size_t i = first_row; i < last; i++) {
+            rows.push_back(static_cast<uint32_t>(i));
+        }
+        return rows;
+    }
+    return scan_names(fold_string(needle), first_row, last);
+}
+
+// One pass over the folded arena from the first row. A name that contains
+// the needle is taken and the scan resumes at the next name. A match can't
+// span two names because the needle holds no '\0'. Matches come in arena
+// order, so the row is found by walking forward from the previous match.
+std::vector<uint32_t> Catalog::scan_names (std::string_view needle,
+                                           size_t first_row,
+                                           size_t end_row) const {
+    std::vector<uint32_t> rows;
+    if (first_row >= end_row) {
+        return rows;
+    }
+    // the arena is cut after the last row's name so the scan stops there
+    std::string_view arena(folded.data(), name_end(end_row - 1));
+    size_t row = first_row;
+    size_t pos = arena.find(needle, name_offsets[first_row]);
+    while (pos != std::string_view::npos) {
+        while (name_end(row) < pos) {
+            row++;
+        }
+        rows.push_back(static_cast<uint32_t>(row));
+        pos = arena.find(needle, name_end(row) + 1);
+    }
+    return rows;
+}
+
+std::vector<uint32_t> Catalog::name_candidates (std::string_view fragment) const {
+    if (fragment.size() >= 3) {
+        return name_trigrams.candidates(fragment);
+    }
+    return scan_names(fragment, 0, ids.size());
+}
+
+std::vector<uint32_t> Catalog::tag_candidates (std::string_view fragment) const {
+    if (fragment.size() >= 3) {
+        return tag_trigrams.candidates(fragment);
+    }
+    std::vector<uint32_t> tags(tag_names.size());
+    for (size_t t = 0; t < tags.size(); t++) {
+        tags[t] = static_cast<uint32_t>(t);
+    }
+    return tags;
+}
+
+// slices for_each_slice may split a range into
+static size_t max_slices (void) {
+    return TaskScheduler::instance().num_threads();
+}
+
+// Split [0, n) into up to max_slices() slices for large n and run
+// fn(slice, begin, end) on each as an interactive task
+template <typename Fn>
+static size_t for_each_slice (size_t n, Fn fn) {
+    size_t slices = 1;
+    if (n >= FUZZY_PARALLEL_MIN_ROWS) {
+        slices = max_slices();
+    }
+    if (slices == 1) {
+        fn(0, 0, n);
+        return 1;
+    }
+    TaskGroup group(PRIORITY_INTERACTIVE);
+    for (size_t s = 1; s < slices; s++) {
+        group.run([&fn, s, n, slices]() {
+            fn(s, n * s / slices, n * (s + 1) / slices);
+        });
+    }
+    fn(0, 0, n / slices);
+    group.wait();
+    return slices;
+}
+
+std::vector<uint32_t> Catalog::fuzzy_rows (const std::string &pattern,
+                                           size_t first_row,
+                                           size_t *end_row,
+                                           size_t max_rows) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const size_t n = ids.size();
+    *end_row = n;
+    if (first_row >= n) {
+        return std::vector<uint32_t>();
+    }
+    size_t last = chunk_end(first_row, max_rows, n);
+    *end_row = last;
+    std::string folded_pattern = fold_string(pattern);
+    uint64_t mask = fuzzy_char_mask(folded_pattern);
+    if (folded_pattern.empty()) {
+        std::vector<uint32_t> rows(last - first_row);
+        for (size_t i = 0; i < rows.size(); i++) {
+            rows[i] = static_cast<uint32_t>(first_row + i);
+        }
+        return rows;
+    }
+
+    // prefilter: rows whose names hold every character class of the pattern
+    const size_t count = last - first_row;
+    const uint64_t *m = char_masks.data() + first_row;
+    std::vector<uint8_t> pass(count);
+    for (size_t i = 0; i < count; i++) {
+        pass[i] = static_cast<uint8_t>((m[i] & mask) == mask);
+    }
+
+    std::string_view arena(folded.data(), folded.size());
+    std::vector<std::vector<uint32_t>> found(max_slices());
+    size_t slices = for_each_slice(count, [&](size_t s, size_t begin, 
+                                              size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            size_t row = first_row + i;
+            if (pass[i] && is_subsequence(arena.substr(name_offsets[row], 
+                                          name_end(row) - name_offsets[row]),
+                                          folded_pattern)) {
+                found[s].push_back(static_cast<uint32_t>(row));
+            }
+        }
+    });
+
+    std::vector<uint32_t> rows;
+    for (size_t s = 0; s < slices; s++) {
+        rows.insert(rows.end(), found[s].begin(), found[s].end());
+    }
+    return rows;
+}
+
+std::vector<uint32_t> Catalog::refine_fuzzy (const std::vector<uint32_t> &rows,
+                                             const std::string &pattern,
+                                             const std::atomic<bool> *cancel) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::string folded_pattern = fold_string(pattern);
+    uint64_t mask = fuzzy_char_mask(folded_pattern);
+    std::string_view arena(folded.data(), folded.size());
+
+    std::vector<uint32_t> refined;
+    for (size_t i = 0; i < rows.size(); i++) {
+        uint32_t row = rows[i];
+        if (row >= ids.size() || cancelled(cancel, i)) {
+            break;
+        }
+        if ((char_masks[row] & mask) == mask &&
+            is_subsequence(arena.substr(name_offsets[row], 
+                                        name_end(row) - name_offsets[row]),
+                           folded_pattern)) {
+            refined.push_back(row);
+        }
+    }
+    return refined;
+}
+
+// better fuzzy hits first; ties go to the newer row
+static bool fuzzy_better (const FuzzyHit &a, const FuzzyHit &b) {
+    return (a.score != b.score) ? a.score > b.score : a.row > b.row;
+}
+
+std::vector<FuzzyHit> Catalog::rank_fuzzy (const std::vector<uint32_t> &rows,
+                                           const std::string &pattern,
+                                           size_t k,
+                                           const std::atomic<bool> *cancel) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const size_t n = ids.size();
+    std::string folded_pattern = fold_string(pattern);
+    std::string_view stored(names.data(), names.size());
+    std::string_view arena(folded.data(), folded.size());
+
+    // an empty pattern scores every row alike, so recency alone decides
+    if (folded_pattern.empty()) {
+        std::vector<FuzzyHit> best;
+        for (size_t i = rows.size(); i-- > 0 && best.size() < k;) {
+            if (rows[i] < n) {
+                best.push_back({rows[i], static_cast<int>(
+                    FUZZY_RECENCY_BONUS * (rows[i] + 1) / n)});
+            }
+        }
+        return best;
+    }
+
+    // each slice keeps its best k in a heap with the worst kept on top
+    typedef std::priority_queue<FuzzyHit, std::vector<FuzzyHit>, 
+                                decltype(&fuzzy_better)> TopK;
+    std::vector<TopK> heaps(max_slices(), TopK(&fuzzy_better));
+    size_t slices = for_each_slice(rows.size(), [&](size_t s, size_t begin, 
+                                                    size_t end) {
+        TopK &heap = heaps[s];
+        for (size_t i = begin; i < end && k > 0; i++) {
+            uint32_t row = rows[i];
+            if (row >= n || cancelled(cancel, i - begin)) {
+                break;
+            }
+            size_t offset = name_offsets[row];
+            size_t length = name_end(row) - offset;
+            int score;
+            if (!fuzzy_score(stored.substr(offset, length), 
+                             arena.substr(offset, length),
+                             folded_pattern, &score)) {
+                continue;
+            }
+            score += static_cast<int>(FUZZY_RECENCY_BONUS * (row + 1) / n);
+            FuzzyHit hit = {row, score};
+            if (heap.size() < k) {
+                heap.push(hit);
+            } else if (fuzzy_better(hit, heap.top())) {
+                heap.pop();
+                heap.push(hit);
+            }
+        }
+    });
+
+    std::vector<FuzzyHit> best;
+    for (size_t s = 0; s < slices; s++) {
+        for (; !heaps[s].empty(); heaps[s].pop()) {
+            best.push_back(heaps[s].top());
+        }
+    }
+    std::sort(best.begin(), best.end(), fuzzy_better);
+    if (best.size() > k) {
+        best.resize(k);
+    }
+    return best;
+}
+
+// ranking of a text_search match, best first
+struct TextRank {
+    uint8_t edits;
+    uint8_t field;      // 0 name, 1 tag
+    uint8_t position;   // 0 start of name, 1 start of a word, 2 elsewhere
+    uint32_t length;
+    uint32_t row;
+
+    bool operator< (const TextRank &other) const {
+        return std::tie(edits, field, position, length, row) <
+               std::tie(other.edits, other.field, other.position, 
+                        other.length, other.row);
+    }
+};
+
+std::vector<uint32_t> Catalog::text_search (const std::string &needle,
+                                            int max_edits, size_t limit,
+                                            size_t *total) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::string folded_needle = fold_string(needle);
+    int allowed = (folded_needle.size() >= TRIGRAM_FUZZY_MIN_LENGTH) ?
+                  std::min(max_edits, 1) : 0;
+
+    // with one edit, a match contains one half of the needle unchanged, so
+    // the candidates are those of either half
+    std::vector<std::string_view> fragments;
+    std::string_view whole(folded_needle);
+    if (allowed > 0) {
+        fragments.push_back(whole.substr(0, whole.size() / 2));
+        fragments.push_back(whole.substr(whole.size() / 2));
+    } else if (!whole.empty()) {
+        fragments.push_back(whole);
+    }
+    auto candidates = [&](bool tags) {
+        std::vector<std::vector<uint32_t>> lists;
+        for (std::string_view fragment : fragments) {
+            lists.push_back(tags ? tag_candidates(fragment) 
+                                 : name_candidates(fragment));
+        }
+        std::vector<const std::vector<uint32_t>*> pointers;
+        for (const std::vector<uint32_t> &list : lists) {
+            pointers.push_back(&list);
+        }
+        return union_postings(pointers);
+    };
+
+    std::string_view arena(folded.data(), folded.size());
+    auto folded_name = [&](uint32_t row) {
+        return arena.substr(name_offsets[row], name_end(row) - name_offsets[row]);
+    };
+
+    std::vector<TextRank> ranks;
+    for (uint32_t row : candidates(false)) {
+        std::string_view name = folded_name(row);
+        int edits = 0;
+        size_t pos = find_approximate(name, whole, allowed, &edits);
+        if (pos == std::string_view::npos) {
+            continue;
+        }
+        uint8_t position = (pos == 0) ? 0 :
+            std::isalnum(static_cast<unsigned char>(name[pos - 1])) ? 2 : 1;
+        ranks.push_back({static_cast<uint8_t>(edits), 0, position,
+                         static_cast<uint32_t>(name.size()), row});
+    }
+    for (uint32_t tag : candidates(true)) {
+        int edits = 0;
+        if (find_approximate(fold_string(tag_names[tag]), whole, allowed, 
+                             &edits) == std::string_view::npos) {
+            continue;
+        }
+        for (uint32_t row : tag_rows[tag]) {
+            ranks.push_back({static_cast<uint8_t>(edits), 1, 2,
+                             static_cast<uint32_t>(folded_name(row).size()), 
+                             row});
+        }
+    }
+
+    // keep the best match of each row
+    std::sort(ranks.begin(), ranks.end(), 
+        [](const TextRank &a, const TextRank &b) {
+            return (a.row != b.row) ? a.row < b.row : a < b;
+        });
+    ranks.erase(std::unique(ranks.begin(), ranks.end(),
+        [](const TextRank &a, const TextRank &b) {
+            return a.row == b.row;
+        }), ranks.end());
+    if (total) {
+        *total = ranks.size();
+    }
+
+    size_t shown = std::min(limit, ranks.size());
+    std::partial_sort(ranks.begin(), ranks.begin() + shown, ranks.end());
+    std::vector<uint32_t> rows(shown);
+    for (size_t i = 0; i < shown; i++) {
+        rows[i] = ranks[i].row;
+    }
+    return rows;
+}
+
+std::vector<uint32_t> Catalog::refine_rows (const std::vector<uint32_t> &rows,
+                                            const std::string &needle,
+                                            const std::atomic<bool> *cancel) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::string folded_needle = fold_string(needle);
+    std::string_view arena(folded.data(), folded.size());
+
+    std::vector<uint32_t> refined;
+    for (size_t i = 0; i < rows.size(); i++) {
+        uint32_t row = rows[i];
+        if (row >= ids.size() || cancelled(cancel, i)) {
+            break;
+        }
+        std::string_view name = arena.substr(name_offsets[row], 
+                                             name_end(row) - name_offsets[row]);
+        if (name.find(folded_needle) != std::string_view::npos) {
+            refined.push_back(row);
+        }
+    }
+    return refined;
+}
+
+// The planner has no statistics for the key, bpm and duration columns. A
+// key term is guessed at a twelfth of the rows, a bpm or duration range at
+// its share of a typical span.
+#define PLAN_BPM_LO 60
+#define PLAN_BPM_HI 180
+#define PLAN_DURATION_HI 10000
+
+static size_t range_estimate (size_t n, int lo, int hi, 
+                              int typical_lo, int typical_hi) {
+    double a = std::max(lo, typical_lo);
+    double b = std::min(hi, typical_hi);
+    double share = (b >= a) ? (b - a + 1) / (typical_hi - typical_lo + 1) 
+                            : 0.0;
+    // a range outside the typical span still matches a few rows
+    share = std::clamp(share, 0.01, 1.0);
+    return static_cast<size_t>(share * n);
+}
+
+// a bpm in the term's range, or with half_double, twice or half of one
+static bool bpm_matches (int bpm, const struct QueryTerm &term) {
+    int64_t lo = term.lo, hi = term.hi;
+    if (bpm >= lo && bpm <= hi) {
+        return true;
+    }
+    return term.half_double && ((2LL * bpm >= lo && 2LL * bpm <= hi) ||
+                                (bpm >= 2 * lo && bpm <= 2 * hi));
+}
+
+static double elapsed_ms (std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double, std::milli> elapsed = 
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// order of the filter stages: column comparisons, directory lookups, tag
+// probes, then name searches
+static int filter_cost (QueryTermKind kind) {
+    switch (kind) {
+    case TERM_KEY:
+    case TERM_BPM:
+    case TERM_DURATION:
+        return 0;
+    case TERM_PATH:
+        return 1;
+    case TERM_TAG:
+        return 2;
+    case TERM_TEXT:
+        return 3;
+    }
+    return 3;
+}
+
+std::vector<uint32_t> Catalog::run_query (const struct ParsedQuery &parsed,
+                                          size_t limit, size_t *total,
+                                          struct QueryPlan *plan,
+                                          FacetCounts *facets,
+                                          const std::atomic<bool> *cancel) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const size_t n = ids.size();
+    const std::vector<struct QueryTerm> &terms = parsed.terms;
+    std::string_view arena(folded.data(), folded.size());
+
+    // resolve each term once: a tag's posting list, the directories a path
+    // term matches, and the rows the term is expected to pass
+    std::vector<const std::vector<uint32_t>*> term_tags(terms.size(), nullptr);
+    std::vector<std::vector<uint8_t>> term_dirs(terms.size());
+    std::vector<size_t> estimates(terms.size());
+    for (size_t t = 0; t < terms.size(); t++) {
+        const struct QueryTerm &term = terms[t];
+        size_t estimate = n;
+        switch (term.kind) {
+        case TERM_TEXT:
+            if (term.text.size() >= 3) {
+                estimate = name_trigrams.estimate(term.text);
+            }
+            break;
+        case TERM_TAG: {
+            auto it = tag_ids.find(term.text);
+            term_tags[t] = (it != tag_ids.end()) ? &tag_rows[it->second] 
+                                                 : nullptr;
+            estimate = term_tags[t] ? term_tags[t]->size() : 0;
+            break;
+        }
+        case TERM_KEY:
+            estimate = n / 12;
+            break;
+        case TERM_BPM:
+            estimate = range_estimate(n, term.lo, term.hi, 
+                                      PLAN_BPM_LO, PLAN_BPM_HI);
+            if (term.half_double) {
+                int twice_lo = std::min(term.lo, INT32_MAX / 2) * 2;
+                int twice_hi = std::min(term.hi, INT32_MAX / 2) * 2;
+                estimate += range_estimate(n, term.lo / 2, term.hi / 2,
+                                           PLAN_BPM_LO, PLAN_BPM_HI);
+                estimate += range_estimate(n, twice_lo, twice_hi,
+                                           PLAN_BPM_LO, PLAN_BPM_HI);
+                estimate = std::min(estimate, n);
+            }
+            break;
+        case TERM_DURATION:
+            estimate = range_estimate(n, term.lo, term.hi, 
+                                      0, PLAN_DURATION_HI);
+            break;
+        case TERM_PATH: {
+            // a trailing separator on the directory lets "Vendor/" match
+            // the directory Vendor itself
+            std::vector<uint8_t> &match = term_dirs[t];
+            match.assign(dir_offsets.size(), 0);
+            size_t known = 0, matched = 0;
+            for (size_t d = 0; d < dir_offsets.size(); d++) {
+                if (dir_offsets[d] == SNAPSHOT_NO_DIRECTORY) {
+                    continue;
+                }
+                std::string dir = fold_string(dir_names.data() + 
+                                              dir_offsets[d]) + "/";
+                std::replace(dir.begin(), dir.end(), '\\', '/');
+                match[d] = dir.find(term.text) != std::string::npos;
+                matched += match[d];
+                known++;
+            }
+            estimate = known ? n * matched / known : 0;
+            break;
+        }
+        }
+        estimates[t] = term.negated ? n - std::min(estimate, n) : estimate;
+    }
+
+    auto matches = [&](size_t t, uint32_t row) {
+        const struct QueryTerm &term = terms[t];
+        bool match = false;
+        switch (term.kind) {
+        case TERM_TEXT: {
+            size_t start = name_offsets[row];
+            match = arena.substr(start, name_end(row) - start)
+                         .find(term.text) != std::string_view::npos;
+            break;
+        }
+        case TERM_TAG:
+            match = term_tags[t] && std::binary_search(term_tags[t]->begin(),
+                                                       term_tags[t]->end(), row);
+            break;
+        case TERM_KEY:
+            match = keys[row] == term.lo;
+            break;
+        case TERM_BPM:
+            match = bpms[row] > 0 && bpm_matches(bpms[row], term);
+            break;
+        case TERM_DURATION:
+            match = durations[row] > 0 && durations[row] >= term.lo && 
+                    durations[row] <= term.hi;
+            break;
+        case TERM_PATH:
+            match = dirs[row] < term_dirs[t].size() && 
+                    term_dirs[t][dirs[row]];
+            break;
+        }
+        return match != term.negated;
+    };
+
+    // The driver produces the first rows: the positive term expected to
+    // match fewest. Negated terms and name fragments too short for trigrams
+    // have no access path of their own and only filter.
+    int driver = -1;
+    for (size_t t = 0; t < terms.size(); t++) {
+        if (terms[t].negated || 
+            (terms[t].kind == TERM_TEXT && terms[t].text.size() < 3)) {
+            continue;
+        }
+        if (driver < 0 || estimates[t] < estimates[driver]) {
+            driver = static_cast<int>(t);
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t t = 0; t < terms.size(); t++) {
+        if (static_cast<int>(t) != driver) {
+            order.push_back(t);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return std::make_tuple(filter_cost(terms[a].kind), estimates[a]) <
+               std::make_tuple(filter_cost(terms[b].kind), estimates[b]);
+    });
+
+    struct QueryPlan executed;
+    executed.catalog_rows = n;
+    std::vector<uint32_t> rows;
+
+    // a cancelled query drops its rows and runs no further stages
+    bool stopped = false;
+    auto stop = [&]() {
+        stopped = true;
+        rows.clear();
+    };
+
+    struct PlanStage first;
+    first.term = driver;
+    first.estimate = (driver < 0) ? n : estimates[driver];
+    auto start = std::chrono::steady_clock::now();
+    if (driver < 0) {
+        first.access = ACCESS_ALL_ROWS;
+        first.rows_in = n;
+        rows.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            rows[i] = static_cast<uint32_t>(i);
+        }
+    } else if (terms[driver].kind == TERM_TAG) {
+        first.access = ACCESS_TAG_POSTINGS;
+        if (term_tags[driver]) {
+            rows = *term_tags[driver];
+        }
+        first.rows_in = rows.size();
+    } else if (terms[driver].kind == TERM_TEXT) {
+        first.access = ACCESS_TRIGRAMS;
+        std::vector<uint32_t> candidates = 
+            name_trigrams.candidates(terms[driver].text);
+        first.rows_in = candidates.size();
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (cancelled(cancel, i)) {
+                stop();
+                break;
+            }
+            if (matches(driver, candidates[i])) {
+                rows.push_back(candidates[i]);
+            }
+        }
+    } else {
+        first.access = ACCESS_COLUMN_SCAN;
+        first.rows_in = n;
+        for (size_t i = 0; i < n; i++) {
+            if (cancelled(cancel, i)) {
+                stop();
+                break;
+            }
+            if (matches(driver, static_cast<uint32_t>(i))) {
+                rows.push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+    first.rows_out = rows.size();
+    first.milliseconds = elapsed_ms(start);
+    executed.stages.push_back(first);
+
+    for (size_t t : order) {
+        if (stopped || (cancel && cancel->load(std::memory_order_relaxed))) {
+            stop();
+            break;
+        }
+        struct PlanStage stage;
+        stage.term = static_cast<int>(t);
+        stage.estimate = estimates[t];
+        switch (terms[t].kind) {
+        case TERM_TEXT:
+            stage.access = ACCESS_NAME_FILTER;
+            break;
+        case TERM_TAG:
+            stage.access = ACCESS_TAG_PROBE;
+            break;
+        case TERM_PATH:
+            stage.access = ACCESS_PATH_FILTER;
+            break;
+        default:
+            stage.access = ACCESS_COLUMN_FILTER;
+            break;
+        }
+        start = std::chrono::steady_clock::now();
+        stage.rows_in = rows.size();
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (cancelled(cancel, i)) {
+                break;
+            }
+            if (matches(t, rows[i])) {
+                rows[kept++] = rows[i];
+            }
+        }
+        rows.resize(kept);
+        stage.rows_out = kept;
+        stage.milliseconds = elapsed_ms(start);
+        executed.stages.push_back(stage);
+    }
+
+    if (stopped || (cancel && cancel->load(std::memory_order_relaxed))) {
+        stop();
+    }
+    if (total) {
+        *total = rows.size();
+    }
+    if (facets) {
+        count_facets(rows, facets);
+    }
+    if (rows.size() > limit) {
+        rows.resize(limit);
+    }
+    if (plan) {
+        *plan = std::move(executed);
+    }
+    return rows;
+}
+
+// count rows per key and per bpm bucket, in fixed size histograms that are
+// folded into the maps at the end
+void Catalog::count_facets (const std::vector<uint32_t> &rows,
+                            FacetCounts *facets) const {
+    facets->total = static_cast<int64_t>(rows.size());
+    facets->keys.clear();
+    facets->bpm_buckets.clear();
+    std::vector<int64_t> key_counts(256, 0);
+    std::vector<int64_t> bucket_counts(INT16_MAX / FACET_BPM_BUCKET + 2, 0);
+    for (uint32_t row : rows) {
+        key_counts[keys[row] + 128]++;
+        bucket_counts[(bpms[row] > 0) ? bpms[row] / FACET_BPM_BUCKET + 1 : 0]++;
+    }
+    for (size_t k = 0; k < key_counts.size(); k++) {
+        if (key_counts[k]) {
+            int key = static_cast<int>(k) - 128;
+            facets->keys[key < 0 ? -1 : key] += key_counts[k];
+        }
+    }
+    for (size_t b = 0; b < bucket_counts.size(); b++) {
+        if (bucket_counts[b]) {
+            facets->bpm_buckets[static_cast<int>(b) - 1] = bucket_counts[b];
+        }
+    }
+}
+
+void Catalog::hit (uint32_t row, struct SearchHit *hit) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    hit->id = ids[row];
+    hit->score = 0.0;
+    hit->file_name = names.data() + name_offsets[row];
+    hit->duration = durations[row];
+    hit->auto_key = keys[row];
+}
+
+std::string Catalog::path (uint32_t row) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    const char *name = names.data() + name_offsets[row];
+    uint32_t dir = dirs[row];
+    if (dir >= dir_offsets.size() || dir_offsets[dir] == SNAPSHOT_NO_DIRECTORY) {
+        return name;
+    }
+    return (std::filesystem::path(dir_names.data() + dir_offsets[dir]) / 
+            name).string();
+}
+
+size_t Catalog::size (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return ids.size();
+}
+
+int64_t Catalog::last_id (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return ids.empty() ? 0 : ids.back();
+}
+
+uint64_t Catalog::epoch (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return row_epoch;
+}
+
+// write one section at the next aligned offset, zero padded
+static void write_section (std::ofstream &out, struct SnapshotHeader *header,
+                           int section, const void *data, size_t bytes,
+                           uint64_t *checksum) {
+    static const uint8_t padding[SNAPSHOT_ALIGN] = {0};
+    header->sections[section].offset = static_cast<uint64_t>(out.tellp());
+    header->sections[section].bytes = bytes;
+    if (bytes) {
+        out.write(static_cast<const char*>(data), bytes);
+        *checksum = snapshot_checksum(static_cast<const uint8_t*>(data), 
+                                      bytes, *checksum);
+    }
+    size_t pad = (SNAPSHOT_ALIGN - bytes % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+    out.write(reinterpret_cast<const char*>(padding), pad);
+}
+
+bool Catalog::write_snapshot (const std::string &path, 
+                              uint64_t database_id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    struct SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.rows = ids.size();
+    header.database_id = database_id;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    uint64_t checksum = SNAPSHOT_CHECKSUM_SEED;
+    write_section(out, &header, SNAPSHOT_IDS, ids.data(), 
+                  ids.size() * sizeof(int64_t), &checksum);
+    write_section(out, &header, SNAPSHOT_NAME_OFFSETS, name_offsets.data(),
+                  name_offsets.size() * sizeof(uint32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_NAMES, names.data(), names.size(), 
+                  &checksum);
+    write_section(out, &header, SNAPSHOT_FOLDED, folded.data(), folded.size(),
+                  &checksum);
+    write_section(out, &header, SNAPSHOT_SIZES, sizes.data(),
+                  sizes.size() * sizeof(int64_t), &checksum);
+    write_section(out, &header, SNAPSHOT_DURATIONS, durations.data(),
+                  durations.size() * sizeof(int32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_BPMS, bpms.data(),
+                  bpms.size() * sizeof(int16_t), &checksum);
+    write_section(out, &header, SNAPSHOT_KEYS, keys.data(), keys.size(),
+                  &checksum);
+    write_section(out, &header, SNAPSHOT_DIRS, dirs.data(),
+                  dirs.size() * sizeof(uint32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_CHAR_MASKS, char_masks.data(),
+                  char_masks.size() * sizeof(uint64_t), &checksum);
+    write_section(out, &header, SNAPSHOT_DIR_OFFSETS, dir_offsets.data(),
+                  dir_offsets.size() * sizeof(uint32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_DIR_NAMES, dir_names.data(),
+                  dir_names.size(), &checksum);
+
+    // tags are flattened into a string table and one posting array
+    std::vector<uint32_t> tag_offsets, posting_offsets, postings;
+    std::string tag_arena;
+    for (size_t t = 0; t < tag_names.size(); t++) {
+        tag_offsets.push_back(static_cast<uint32_t>(tag_arena.size()));
+        tag_arena.append(tag_names[t].c_str(), tag_names[t].size() + 1);
+        posting_offsets.push_back(static_cast<uint32_t>(postings.size()));
+        postings.insert(postings.end(), tag_rows[t].begin(), tag_rows[t].end());
+    }
+    posting_offsets.push_back(static_cast<uint32_t>(postings.size()));
+    write_section(out, &header, SNAPSHOT_TAG_OFFSETS, tag_offsets.data(),
+                  tag_offsets.size() * sizeof(uint32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_TAG_NAMES, tag_arena.data(),
+                  tag_arena.size(), &checksum);
+    write_section(out, &header, SNAPSHOT_POSTING_OFFSETS, posting_offsets.data(),
+                  posting_offsets.size() * sizeof(uint32_t), &checksum);
+    write_section(out, &header, SNAPSHOT_POSTINGS, postings.data(),
+                  postings.size() * sizeof(uint32_t), &checksum);
+
+    // the name trigram lists are written as encoded, one after another
+    std::vector<struct SnapshotTrigram> trigrams;
+    std::vector<uint8_t> trigram_bytes;
+    std::vector<PostingSkip> trigram_skips;
+    for (const auto &entry : name_trigrams.lists()) {
+        const CompressedPostingList &list = *entry.second;
+        trigrams.push_back({entry.first, static_cast<uint32_t>(list.size()),
+                            list.last(),
+                            static_cast<uint32_t>(trigram_bytes.size()),
+                            static_cast<uint32_t>(trigram_skips.size())});
+        trigram_bytes.insert(trigram_bytes.end(), list.encoded(),
+                             list.encoded() + list.encoded_size());
+        trigram_skips.insert(trigram_skips.end(), list.skip_points(),
+                             list.skip_points() + list.num_skip_points());
+    }
+    write_section(out, &header, SNAPSHOT_TRIGRAMS, trigrams.data(),
+                  trigrams.size() * sizeof(struct SnapshotTrigram), &checksum);
+    write_section(out, &header, SNAPSHOT_TRIGRAM_BYTES, trigram_bytes.data(),
+                  trigram_bytes.size(), &checksum);
+    write_section(out, &header, SNAPSHOT_TRIGRAM_SKIPS, trigram_skips.data(),
+                  trigram_skips.size() * sizeof(PostingSkip), &checksum);
+
+    header.checksum = checksum;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(out);
+}
+
+// an arena of '\0' terminated strings: empty, or ending in a '\0'
+static bool terminated (const char *arena, size_t bytes) {
+    return bytes == 0 || arena[bytes - 1] == '\0';
+}
+
+// Check every table the catalog indexes with once the columns are mapped:
+// ids ascend, names and directory and tag offsets point at '\0' terminated
+// strings inside their arenas, directory ids and posting rows are in range
+// and each tag's rows ascend, and each name trigram list lies inside the
+// trigram sections and decodes to ascending rows. The section sizes are
+// already checked.
+static bool snapshot_consistent (const struct SnapshotHeader &header,
+                                 const uint8_t *base) {
+    auto section = [&](int s) {
+        return base + header.sections[s].offset;
+    };
+    auto bytes = [&](int s) {
+        return static_cast<size_t>(header.sections[s].bytes);
+    };
+    const size_t rows = header.rows;
+    if (rows > UINT32_MAX) {
+        return false;
+    }
+
+    const int64_t *ids = reinterpret_cast<const int64_t*>(
+        section(SNAPSHOT_IDS));
+    for (size_t r = 1; r < rows; r++) {
+        if (ids[r] <= ids[r - 1]) {
+            return false;
+        }
+    }
+
+    // each name starts right after the previous one's '\0', in both arenas,
+    // and the last one ends the arena
+    const uint32_t *name_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_NAME_OFFSETS));
+    const char *names = reinterpret_cast<const char*>(section(SNAPSHOT_NAMES));
+    const char *folded = reinterpret_cast<const char*>(
+        section(SNAPSHOT_FOLDED));
+    const size_t arena = bytes(SNAPSHOT_NAMES);
+    if (rows > 0 && name_offsets[0] != 0) {
+        return false;
+    }
+    for (size_t r = 0; r < rows; r++) {
+        size_t end = (r + 1 < rows) ? name_offsets[r + 1] : arena;
+        if (end <= name_offsets[r] || end > arena ||
+            names[end - 1] != '\0' || folded[end - 1] != '\0') {
+            return false;
+        }
+    }
+
+    const uint32_t *dir_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_DIR_OFFSETS));
+    const char *dir_names = reinterpret_cast<const char*>(
+        section(SNAPSHOT_DIR_NAMES));
+    const size_t num_dirs = bytes(SNAPSHOT_DIR_OFFSETS) / sizeof(uint32_t);
+    if (!terminated(dir_names, bytes(SNAPSHOT_DIR_NAMES))) {
+        return false;
+    }
+    for (size_t d = 0; d < num_dirs; d++) {
+        if (dir_offsets[d] != SNAPSHOT_NO_DIRECTORY &&
+            dir_offsets[d] >= bytes(SNAPSHOT_DIR_NAMES)) {
+            return false;
+        }
+    }
+    const uint32_t *dirs = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_DIRS));
+    for (size_t r = 0; r < rows; r++) {
+        if (dirs[r] >= num_dirs) {
+            return false;
+        }
+    }
+
+    const uint32_t *tag_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_TAG_OFFSETS));
+    const char *tag_names = reinterpret_cast<const char*>(
+        section(SNAPSHOT_TAG_NAMES));
+    const uint32_t *posting_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_POSTING_OFFSETS));
+    const uint32_t *postings = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_POSTINGS));
+    const size_t num_tags = bytes(SNAPSHOT_TAG_OFFSETS) / sizeof(uint32_t);
+    const size_t num_postings = bytes(SNAPSHOT_POSTINGS) / sizeof(uint32_t);
+    if (bytes(SNAPSHOT_POSTING_OFFSETS) != (num_tags + 1) * sizeof(uint32_t) ||
+        !terminated(tag_names, bytes(SNAPSHOT_TAG_NAMES)) ||
+        posting_offsets[0] != 0 || posting_offsets[num_tags] != num_postings) {
+        return false;
+    }
+    for (size_t t = 0; t < num_tags; t++) {
+        uint32_t begin = posting_offsets[t];
+        uint32_t end = posting_offsets[t + 1];
+        if (tag_offsets[t] >= bytes(SNAPSHOT_TAG_NAMES) || end < begin ||
+            end > num_postings) {
+            return false;
+        }
+        for (uint32_t p = begin; p < end; p++) {
+            if (postings[p] >= rows || (p > begin && 
+                                        postings[p] <= postings[p - 1])) {
+                return false;
+            }
+        }
+    }
+
+    // each list starts where the previous one ended, in both the bytes and
+    // the skip points, and the last one ends both sections
+    const struct SnapshotTrigram *trigrams = 
+        reinterpret_cast<const struct SnapshotTrigram*>(
+            section(SNAPSHOT_TRIGRAMS));
+    const PostingSkip *skips = reinterpret_cast<const PostingSkip*>(
+        section(SNAPSHOT_TRIGRAM_SKIPS));
+    const size_t num_trigrams = 
+        bytes(SNAPSHOT_TRIGRAMS) / sizeof(struct SnapshotTrigram);
+    const size_t num_bytes = bytes(SNAPSHOT_TRIGRAM_BYTES);
+    const size_t num_skips = bytes(SNAPSHOT_TRIGRAM_SKIPS) / sizeof(PostingSkip);
+    size_t byte_pos = 0, skip_pos = 0;
+    for (size_t t = 0; t < num_trigrams; t++) {
+        const struct SnapshotTrigram &trigram = trigrams[t];
+        size_t end = (t + 1 < num_trigrams) ? trigrams[t + 1].bytes : num_bytes;
+        if ((t > 0 && trigram.trigram <= trigrams[t - 1].trigram) ||
+            trigram.trigram > 0xffffff || trigram.count == 0 ||
+            trigram.bytes != byte_pos || end < byte_pos || end > num_bytes ||
+            trigram.skips != skip_pos) {
+            return false;
+        }
+        CompressedPostingList list;
+        list.view(section(SNAPSHOT_TRIGRAM_BYTES) + byte_pos, end - byte_pos,
+                  skips + skip_pos, trigram.last, trigram.count);
+        if (list.num_skip_points() > num_skips - skip_pos ||
+            !list.well_formed(static_cast<uint32_t>(rows))) {
+            return false;
+        }
+        byte_pos = end;
+        skip_pos += list.num_skip_points();
+    }
+    return byte_pos == num_bytes && skip_pos == num_skips;
+}
+
+bool Catalog::open_snapshot (const std::string &path, bool verify,
+                             uint64_t database_id) {
+    std::unique_ptr<MappedFile> file(new MappedFile);
+    if (!file->open(path) || file->size() < sizeof(struct SnapshotHeader)) {
+        return false;
+    }
+
+    struct SnapshotHeader header;
+    memcpy(&header, file->data(), sizeof(header));
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.version != SNAPSHOT_VERSION || 
+        header.database_id != database_id) {
+        return false;
+    }
+
+    // every section must lie inside the file on an aligned offset, the row
+    // columns must hold exactly one value per row and the other tables
+    // whole values
+    for (int s = 0; s < SNAPSHOT_SECTIONS; s++) {
+        const struct SnapshotSection &section = header.sections[s];
+        if (section.offset % SNAPSHOT_ALIGN != 0 || 
+            section.offset > file->size() ||
+            section.bytes > file->size() - section.offset) {
+            return false;
+        }
+    }
+    const uint64_t rows = header.rows;
+    auto holds = [&](int s, size_t width) {
+        return header.sections[s].bytes == rows * width;
+    };
+    if (!holds(SNAPSHOT_IDS, sizeof(int64_t)) ||
+        !holds(SNAPSHOT_NAME_OFFSETS, sizeof(uint32_t)) ||
+        !holds(SNAPSHOT_SIZES, sizeof(int64_t)) ||
+        !holds(SNAPSHOT_DURATIONS, sizeof(int32_t)) ||
+        !holds(SNAPSHOT_BPMS, sizeof(int16_t)) ||
+        !holds(SNAPSHOT_KEYS, sizeof(int8_t)) ||
+        !holds(SNAPSHOT_DIRS, sizeof(uint32_t)) ||
+        !holds(SNAPSHOT_CHAR_MASKS, sizeof(uint64_t)) ||
+        header.sections[SNAPSHOT_NAMES].bytes != 
+            header.sections[SNAPSHOT_FOLDED].bytes) {
+        return false;
+    }
+    for (int s : {SNAPSHOT_DIR_OFFSETS, SNAPSHOT_TAG_OFFSETS,
+                  SNAPSHOT_POSTING_OFFSETS, SNAPSHOT_POSTINGS}) {
+        if (header.sections[s].bytes % sizeof(uint32_t) != 0) {
+            return false;
+        }
+    }
+    if (header.sections[SNAPSHOT_TRIGRAMS].bytes % 
+            sizeof(struct SnapshotTrigram) != 0 ||
+        header.sections[SNAPSHOT_TRIGRAM_SKIPS].bytes % 
+            sizeof(PostingSkip) != 0) {
+        return false;
+    }
+
+    if (verify) {
+        uint64_t checksum = snapshot_checksum(
+            file->data() + sizeof(header), file->size() - sizeof(header),
+            SNAPSHOT_CHECKSUM_SEED);
+        if (checksum != header.checksum) {
+            return false;
+        }
+    }
+    if (!snapshot_consistent(header, file->data())) {
+        return false;
+    }
+
+    const uint8_t *base = file->data();
+    auto section = [&](int s) {
+        return base + header.sections[s].offset;
+    };
+    auto count = [&](int s, size_t width) {
+        return static_cast<size_t>(header.sections[s].bytes / width);
+    };
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    ids.view(reinterpret_cast<const int64_t*>(section(SNAPSHOT_IDS)), rows);
+    name_offsets.view(reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_NAME_OFFSETS)), rows);
+    names.view(reinterpret_cast<const char*>(section(SNAPSHOT_NAMES)),
+               count(SNAPSHOT_NAMES, 1));
+    folded.view(reinterpret_cast<const char*>(section(SNAPSHOT_FOLDED)),
+                count(SNAPSHOT_FOLDED, 1));
+    sizes.view(reinterpret_cast<const int64_t*>(section(SNAPSHOT_SIZES)), rows);
+    durations.view(reinterpret_cast<const int32_t*>(
+        section(SNAPSHOT_DURATIONS)), rows);
+    bpms.view(reinterpret_cast<const int16_t*>(section(SNAPSHOT_BPMS)), rows);
+    keys.view(reinterpret_cast<const int8_t*>(section(SNAPSHOT_KEYS)), rows);
+    dirs.view(reinterpret_cast<const uint32_t*>(section(SNAPSHOT_DIRS)), rows);
+    char_masks.view(reinterpret_cast<const uint64_t*>(
+        section(SNAPSHOT_CHAR_MASKS)), rows);
+    dir_offsets.view(reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_DIR_OFFSETS)), count(SNAPSHOT_DIR_OFFSETS, 4));
+    dir_names.view(reinterpret_cast<const char*>(section(SNAPSHOT_DIR_NAMES)),
+                   count(SNAPSHOT_DIR_NAMES, 1));
+
+    // the tag dictionary is the only part built in memory
+    const uint32_t *tag_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_TAG_OFFSETS));
+    const char *tag_arena = reinterpret_cast<const char*>(
+        section(SNAPSHOT_TAG_NAMES));
+    const uint32_t *posting_offsets = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_POSTING_OFFSETS));
+    const uint32_t *postings = reinterpret_cast<const uint32_t*>(
+        section(SNAPSHOT_POSTINGS));
+    size_t num_tags = count(SNAPSHOT_TAG_OFFSETS, 4);
+    tag_ids.clear();
+    tag_names.clear();
+    tag_rows.clear();
+    tag_trigrams.clear();
+    for (size_t t = 0; t < num_tags; t++) {
+        tag_names.emplace_back(tag_arena + tag_offsets[t]);
+        tag_ids.emplace(tag_names.back(), static_cast<uint32_t>(t));
+        tag_rows.emplace_back(postings + posting_offsets[t],
+                              postings + posting_offsets[t + 1]);
+        tag_trigrams.add(static_cast<uint32_t>(t), fold_string(tag_names[t]));
+    }
+
+    // the name trigram lists view their encodings in the mapping
+    const struct SnapshotTrigram *trigrams = 
+        reinterpret_cast<const struct SnapshotTrigram*>(
+            section(SNAPSHOT_TRIGRAMS));
+    const uint8_t *trigram_bytes = section(SNAPSHOT_TRIGRAM_BYTES);
+    const PostingSkip *trigram_skips = reinterpret_cast<const PostingSkip*>(
+        section(SNAPSHOT_TRIGRAM_SKIPS));
+    size_t num_trigrams = count(SNAPSHOT_TRIGRAMS, sizeof(struct SnapshotTrigram));
+    name_trigrams.clear();
+    for (size_t t = 0; t < num_trigrams; t++) {
+        size_t end = (t + 1 < num_trigrams) ? trigrams[t + 1].bytes 
+                                            : count(SNAPSHOT_TRIGRAM_BYTES, 1);
+        CompressedPostingList list;
+        list.view(trigram_bytes + trigrams[t].bytes, end - trigrams[t].bytes,
+                  trigram_skips + trigrams[t].skips, trigrams[t].last,
+                  trigrams[t].count);
+        name_trigrams.set_list(trigrams[t].trigram, list);
+    }
+
+    snapshot = std::move(file);
+    row_epoch++;
+    return true;
+}
+
+void Catalog::clear (void) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    ids.view(nullptr, 0);
+    name_offsets.view(nullptr, 0);
+    names.view(nullptr, 0);
+    folded.view(nullptr, 0);
+    sizes.view(nullptr, 0);
+    durations.view(nullptr, 0);
+    bpms.view(nullptr, 0);
+    keys.view(nullptr, 0);
+    dirs.view(nullptr, 0);
+    char_masks.view(nullptr, 0);
+    dir_offsets.view(nullptr, 0);
+    dir_names.view(nullptr, 0);
+    tag_ids.clear();
+    tag_names.clear();
+    tag_rows.clear();
+    name_trigrams.clear();
+    tag_trigrams.clear();
+    snapshot.reset();
+    row_epoch++;
+}
@@ -1,30 +1,510 @@
 #include "..\inc\Database.h"
 
+//==============================================================================
+// SQL
+//==============================================================================
+
+// columns read by read_file_record, in order
+#define FILE_RECORD_COLUMNS "(SELECT path FROM directories "\
+                                "WHERE directories.id = dir_id), "\
+                            "file_name, "\
+                            "file_size, "\
+                            "duration, "\
+                            "num_user_tags, "\
+                            "user_tags, "\
+                            "num_auto_tags, "\
+                            "auto_tags, "\
+                            "user_bpm, "\
+                            "user_key, "\
+                            "auto_bpm, "\
+                            "auto_key"
+
+static const char* SQL_FIND_DIRECTORY =
+    "SELECT id FROM directories WHERE path = ?;";
+
+static const char* SQL_INSERT_DIRECTORY =
+    "INSERT INTO directories (path) VALUES (?);";
+
+static const char* SQL_DIRECTORY_FILES =
+    "SELECT file_name FROM audio_files WHERE dir_id = ?;";
+
+static const char* SQL_INSERT_FILE =
+    "INSERT OR IGNORE INTO audio_files ("\
+        "dir_id,"\
+        "file_name,"\
+        "file_size,"\
+        "duration,"\
+        "num_user_tags,"\
+        "user_tags,"\
+        "num_auto_tags,"\
+        "auto_tags,"\
+        "user_bpm,"\
+        "user_key,"\
+        "auto_bpm,"\
+        "auto_key,"\
+        "timbre,"\
+        "key_version,"\
+        "timbre_version,"\
+        "overview_version)"\
+        " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+// bulk load staging tables: plain rowid tables with no secondary indexes,
+// constraints or triggers, so each insert is an append
+static const char* SQL_CREATE_STAGING =
+    "CREATE TABLE IF NOT EXISTS audio_files_staging ("\
+        "id INTEGER PRIMARY KEY,"\
+        "dir_id INTEGER NOT NULL,"\
+        "file_name TEXT NOT NULL,"\
+        "file_size INTEGER,"\
+        "duration REAL,"\
+        "num_user_tags INTEGER,"\
+        "user_tags TEXT NOT NULL,"\
+        "num_auto_tags INTEGER,"\
+        "auto_tags TEXT NOT NULL,"\
+        "user_bpm INTEGER,"\
+        "user_key INTEGER,"\
+        "auto_bpm INTEGER,"\
+        "auto_key INTEGER,"\
+        "timbre BLOB,"\
+        "key_version INTEGER,"\
+        "timbre_version INTEGER,"\
+        "overview_version INTEGER"\
+    ");"\
+    "CREATE TABLE IF NOT EXISTS file_tags_staging ("\
+        "tag_id INTEGER, file_id INTEGER, source INTEGER);"\
+    "CREATE TABLE IF NOT EXISTS waveform_overviews_staging ("\
+        "file_id INTEGER, bins INTEGER, peaks BLOB);";
+
+// same parameters as SQL_INSERT_FILE, plus the row id as ?17
+static const char* SQL_STAGE_FILE =
+    "INSERT INTO audio_files_staging ("\
+        "dir_id,"\
+        "file_name,"\
+        "file_size,"\
+        "duration,"\
+        "num_user_tags,"\
+        "user_tags,"\
+        "num_auto_tags,"\
+        "auto_tags,"\
+        "user_bpm,"\
+        "user_key,"\
+        "auto_bpm,"\
+        "auto_key,"\
+        "timbre,"\
+        "key_version,"\
+        "timbre_version,"\
+        "overview_version,"\
+        "id)"\
+        " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+static const char* SQL_STAGE_FILE_TAG =
+    "INSERT INTO file_tags_staging (tag_id, file_id, source) VALUES (?, ?, ?);";
+
+static const char* SQL_STAGE_OVERVIEW =
+    "INSERT INTO waveform_overviews_staging (file_id, bins, peaks) "\
+    "VALUES (?, ?, ?);";
+
+// staged ids continue after every id used so far, staged or not
+static const char* SQL_NEXT_STAGED_ID =
+    "SELECT max("\
+        "coalesce((SELECT max(id) FROM audio_files), 0),"\
+        "coalesce((SELECT max(id) FROM audio_files_staging), 0),"\
+        "coalesce((SELECT seq FROM sqlite_sequence "\
+                  "WHERE name = 'audio_files'), 0)) + 1;";
+
+// Merge the staging tables into the catalog. The secondary indexes and the
+// FTS insert trigger are dropped first and rebuilt afterwards, so each is
+// built in one sorted pass instead of row by row. Staged rows that collide
+// with an existing file are dropped along with their tags and overviews.
+static const char* SQL_MERGE_STAGING =
+    "DROP TRIGGER IF EXISTS audio_files_fts_insert;"\
+    "DROP INDEX IF EXISTS file_tags_by_file;"\
+    "INSERT OR IGNORE INTO audio_files ("\
+        "id, dir_id, file_name, file_size, duration, "\
+        "num_user_tags, user_tags, num_auto_tags, auto_tags, "\
+        "user_bpm, user_key, auto_bpm, auto_key, timbre, "\
+        "key_version, timbre_version, overview_version) "\
+    "SELECT "\
+        "id, dir_id, file_name, file_size, duration, "\
+        "num_user_tags, user_tags, num_auto_tags, auto_tags, "\
+        "user_bpm, user_key, auto_bpm, auto_key, timbre, "\
+        "key_version, timbre_version, overview_version "\
+    "FROM audio_files_staging ORDER BY id;"\
+    "INSERT INTO audio_files_fts (rowid, file_name, auto_tags, user_tags) "\
+    "SELECT audio_files.id, audio_files.file_name, audio_files.auto_tags, "\
+        "audio_files.user_tags FROM audio_files_staging JOIN audio_files "\
+        "USING (id, dir_id, file_name) ORDER BY audio_files.id;"\
+    "INSERT OR IGNORE INTO file_tags (tag_id, file_id, source) "\
+    "SELECT tag_id, file_id, source FROM file_tags_staging "\
+    "WHERE file_id IN (SELECT id FROM audio_files_staging JOIN audio_files "\
+        "USING (id, dir_id, file_name)) "\
+    "ORDER BY tag_id, file_id, source;"\
+    "INSERT OR REPLACE INTO waveform_overviews (file_id, bins, peaks) "\
+    "SELECT file_id, bins, peaks FROM waveform_overviews_staging "\
+    "WHERE file_id IN (SELECT id FROM audio_files_staging JOIN audio_files "\
+        "USING (id, dir_id, file_name)) "\
+    "ORDER BY file_id, bins;"\
+    "DROP TABLE audio_files_staging;"\
+    "DROP TABLE file_tags_staging;"\
+    "DROP TABLE waveform_overviews_staging;"\
+    "CREATE INDEX IF NOT EXISTS file_tags_by_file "\
+        "ON file_tags (file_id, tag_id);";
+
+static const char* SQL_UPDATE_ANALYSIS =
+    "UPDATE audio_files SET "\
+        "duration = ?,"\
+        "auto_key = ?,"\
+        "timbre = ?,"\
+        "key_version = ?,"\
+        "timbre_version = ?,"\
+        "overview_version = ? "\
+    "WHERE id = ?;";
+
+static const char* SQL_DELETE_OVERVIEW =
+    "DELETE FROM waveform_overviews WHERE file_id = ?;";
+
+// rowid order lets the job resume from the last id it processed
+static const char* SQL_SELECT_STALE =
+    "SELECT audio_files.id, path, file_name FROM audio_files "\
+    "JOIN directories ON directories.id = dir_id WHERE audio_files.id > ?1 AND ("\
+        "key_version < ?2 OR timbre_version < ?3 OR overview_version < ?4"\
+    ") ORDER BY audio_files.id LIMIT ?5;";
+
+static const char* SQL_INSERT_OVERVIEW =
+    "INSERT OR REPLACE INTO waveform_overviews "\
+    "(file_id, bins, peaks) VALUES (?, ?, ?)";
+
+// keyset pagination on (score, id): ?2 is NULL for the first page
+static const char* SQL_SEARCH_BY_NAME =
+    "SELECT id, score, file_name, duration, auto_key FROM audio_files JOIN ("\
+        "SELECT rowid AS match_id, "\
+        "bm25(audio_files_fts, " FTS_WEIGHTS ") AS score "\
+        "FROM audio_files_fts WHERE audio_files_fts MATCH ?1"\
+    ") ON audio_files.id = match_id "\
+    "WHERE ?2 IS NULL OR (score, id) > (?2, ?3) "\
+    "ORDER BY score, id LIMIT ?4;";
+
+static const char* SQL_GET_FILE_ID =
+    "SELECT id FROM audio_files WHERE dir_id = ? AND file_name = ?;";
+
+// FTS external content triggers: keep audio_files_fts in sync with every
+// write to audio_files
+static const char* SQL_FTS_TRIGGERS =
+    "CREATE TRIGGER IF NOT EXISTS audio_files_fts_insert "\
+    "AFTER INSERT ON audio_files BEGIN "\
+        "INSERT INTO audio_files_fts "\
+        "(rowid, file_name, auto_tags, user_tags) VALUES "\
+        "(new.id, new.file_name, new.auto_tags, new.user_tags);"\
+    "END;"\
+    "CREATE TRIGGER IF NOT EXISTS audio_files_fts_delete "\
+    "AFTER DELETE ON audio_files BEGIN "\
+        "INSERT INTO audio_files_fts "\
+        "(audio_files_fts, rowid, file_name, auto_tags, user_tags) "\
+        "VALUES ('delete', old.id, old.file_name, old.auto_tags, "\
+        "old.user_tags);"\
+    "END;"\
+    "CREATE TRIGGER IF NOT EXISTS audio_files_fts_update "\
+    "AFTER UPDATE OF file_name, auto_tags, user_tags "\
+    "ON audio_files BEGIN "\
+        "INSERT INTO audio_files_fts "\
+        "(audio_files_fts, rowid, file_name, auto_tags, user_tags) "\
+        "VALUES ('delete', old.id, old.file_name, old.auto_tags, "\
+        "old.user_tags);"\
+        "INSERT INTO audio_files_fts "\
+        "(rowid, file_name, auto_tags, user_tags) VALUES "\
+        "(new.id, new.file_name, new.auto_tags, new.user_tags);"\
+    "END;";
+
+static const char* SQL_FILE_TAGS_TRIGGER =
+    "CREATE TRIGGER IF NOT EXISTS file_tags_delete "\
+    "AFTER DELETE ON audio_files BEGIN "\
+        "DELETE FROM file_tags WHERE file_id = old.id;"\
+    "END;";
+
+static const char* SQL_GET_FILE_BY_ID =
+    "SELECT " FILE_RECORD_COLUMNS " FROM audio_files WHERE id = ?;";
+
+static const char* SQL_LOAD_CATALOG =
+    "SELECT audio_files.id, dir_id, path, file_name, file_size, duration, "\
+    "effective_key, effective_bpm, auto_tags || ' ' || user_tags "\
+    "FROM audio_files JOIN directories ON directories.id = dir_id "\
+    "WHERE audio_files.id > ? ORDER BY audio_files.id;";
+
+static const char* SQL_LOAD_TIMBRE =
+    "SELECT id, timbre FROM audio_files "\
+    "WHERE id > ? AND timbre IS NOT NULL ORDER BY id;";
+
+static const char* SQL_DATABASE_ID =
+    "SELECT database_id FROM database_info WHERE id = 1;";
+
+static const char* SQL_LOAD_GRAPH =
+    "SELECT graph FROM similarity_graph WHERE id = 1;";
+
+static const char* SQL_SAVE_GRAPH =
+    "INSERT OR REPLACE INTO similarity_graph (id, graph) VALUES (1, ?);";
+
+static const char* SQL_DROP_GRAPH =
+    "DELETE FROM similarity_graph;";
+
+static const char* SQL_FIND_TAG =
+    "SELECT id FROM tags WHERE name = ?;";
+
+static const char* SQL_INSERT_TAG =
+    "INSERT INTO tags (name) VALUES (?);";
+
+static const char* SQL_INSERT_FILE_TAG =
+    "INSERT OR IGNORE INTO file_tags (tag_id, file_id, source) "\
+    "VALUES (?, ?, ?);";
+
+// a file carrying a tag from several sources appears once per source;
+// adjacent duplicates are dropped when the list is read
+static const char* SQL_TAG_POSTINGS =
+    "SELECT file_id FROM file_tags WHERE tag_id = ? ORDER BY file_id;";
+
+// tag names in [prefix, prefix + 0xff) start with prefix
+static const char* SQL_TAG_FREQUENCIES =
+    "SELECT name, COUNT(DISTINCT file_id) AS uses FROM tags "\
+    "JOIN file_tags ON file_tags.tag_id = tags.id "\
+    "WHERE name >= ?1 AND name < ?2 "\
+    "GROUP BY tags.id ORDER BY uses DESC, name LIMIT ?3;";
+
+// levels are ordered so the coarsest level with at least pixel_width bins
+// sorts first, falling back to the finest level; one indexed read either way
+static const char* SQL_FETCH_OVERVIEW =
+    "SELECT bins, peaks FROM waveform_overviews "\
+    "WHERE file_id = ?1 "\
+    "ORDER BY CASE WHEN bins >= ?2 THEN bins "\
+    "ELSE 1000000000 - bins END LIMIT 1;";
+
+// translate a search box query into an FTS5 MATCH expression
+// The query is split the same way the index tokenizes names, and each word
+// becomes a quoted prefix query: "kick hard" -> "kick"* "hard"*
+static std::string fts_match_expression (const std::string& query) {
+    std::string expr, token;
+    auto flush = [&]() {
+        if (!token.empty()) {
+            if (!expr.empty()) {
+                expr += " ";
+            }
+            expr += "\"" + token + "\"*";
+            token.clear();
+        }
+    };
+    for (char ch : query) {
+        // non-ascii bytes are kept so utf-8 names still match
+        if (std::isalnum(static_cast<unsigned char>(ch)) ||
+            static_cast<unsigned char>(ch) > 127) {
+            token += ch;
+        } else {
+            flush();
+        }
+    }
+    flush();
+    return expr;
+}
+
+// split a file path into its directory and file name
+static void split_path (const std::string& file_path, std::string* dir,
+                        std::string* name) {
+    fs::path path(file_path);
+    *dir = path.parent_path().string();
+    *name = path.filename().string();
+}
+
+// join a directory and file name back into a file path
+static std::string join_path (const char* dir, const char* name) {
+    return (fs::path(dir) / name).string();
+}
+
+// look up the id of a directory on a connection, -1 if it is unknown
+static int64_t find_directory (Connection& conn, const std::string& dir) {
+    CachedStatement stmt(conn, SQL_FIND_DIRECTORY);
+    sqlite3_bind_text(stmt, 1, dir.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        return sqlite3_column_int64(stmt, 0);
+    }
+    return -1;
+}
+
+// look up the row id of a file path on a connection
+static int64_t find_file_id (Connection& conn, const std::string& file_path) {
+    std::string dir, name;
+    split_path(file_path, &dir, &name);
+    int64_t dir_id = find_directory(conn, dir);
+    if (dir_id < 0) {
+        return -1;
+    }
+
+    CachedStatement stmt(conn, SQL_GET_FILE_ID);
+    sqlite3_bind_int64(stmt, 1, dir_id);
+    sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        return sqlite3_column_int64(stmt, 0);
+    }
+    return -1;
+}
+
+// read the FILE_RECORD_COLUMNS of the current result row into a FileRecord
+static void read_file_record (sqlite3_stmt *stmt, struct FileRecord *file) {
+    file->file_path = join_path(
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+    file->file_name = reinterpret_cast<const char*>(
+        sqlite3_column_text(stmt, 1));
+    file->file_size = sqlite3_column_int(stmt, 2);
+    file->duration = sqlite3_column_int(stmt, 3);
+    file->num_user_tags = sqlite3_column_int(stmt, 4);
+    file->user_tags = reinterpret_cast<const char*>(
+        sqlite3_column_text(stmt, 5));
+    file->num_auto_tags = sqlite3_column_int(stmt, 6);
+    file->auto_tags = reinterpret_cast<const char*>(
+        sqlite3_column_text(stmt, 7));
+    file->user_bpm = sqlite3_column_int(stmt, 8);
+    file->user_key = sqlite3_column_int(stmt, 9);
+    file->auto_bpm = sqlite3_column_int(stmt, 10);
+    file->auto_key = sqlite3_column_int(stmt, 11);
+}
+
+//==============================================================================
+// Connection Definitions
+//==============================================================================
+
+Connection::Connection (const std::string& path, int flags) {
+    if (sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        panicf("Connection: Cannot open database %s.\n", path.c_str());
+    }
+    sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT_MS);
+
+    // memory map the file and keep a large page cache and temp tables in
+    // memory; these are per connection and don't persist in the file
+    std::string pragmas =
+        "PRAGMA mmap_size = " + std::to_string(DB_MMAP_SIZE) + ";"
+        "PRAGMA cache_size = -" + std::to_string(DB_CACHE_SIZE_KB) + ";"
+        "PRAGMA temp_store = MEMORY;";
+    exec(pragmas.c_str(), "Connection");
+}
+
+Connection::~Connection (void) {
+    for (auto& entry : statements) {
+        sqlite3_finalize(entry.second);
+    }
+    sqlite3_close(db);
+}
+
+sqlite3* Connection::handle (void) {
+    return db;
+}
+
+// get the cached statement for sql, preparing it on first use
+sqlite3_stmt* Connection::statement (const char* sql) {
+    auto it = statements.find(sql);
+    if (it != statements.end()) [[likely]] {
+        return it->second;
+    }
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT,
+        &stmt, nullptr) != SQLITE_OK) {
+        panicf("Connection: Failed to prepare statement: %s\n%s\n",
+               sql, sqlite3_errmsg(db));
+    }
+    statements.emplace(sql, stmt);
+    return stmt;
+}
+
+// execute a statement with no results, panic on failure
+void Connection::exec (const char* sql, const char* caller) {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        fprintf(stderr, "%s: %s\n", caller, err_msg ? err_msg : "");
+        sqlite3_free(err_msg);
+        panicf("%s: Error executing statement.\n", caller);
+    }
+}
+
+CachedStatement::CachedStatement (Connection& conn, const char* sql) :
+    stmt(conn.statement(sql)) {}
+
+CachedStatement::~CachedStatement (void) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+}
+
+//==============================================================================
+// ConnectionPool Definitions
+//==============================================================================
+
+ConnectionPool::ConnectionPool (const std::string& path, int flags, int size) :
+    path(path), flags(flags), size(size) {}
+
+// connections are opened lazily, so the pool can be built before the writer
+// has created the schema
+Connection* ConnectionPool::acquire (void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (idle.empty() && static_cast<int>(connections.size()) < size) {
+        connections.emplace_back(std::make_unique<Connection>(path, flags));
+        return connections.back().get();
+    }
+    cv.wait(lock, [this]() { return !idle.empty(); });
+    Connection* conn = idle.back();
+    idle.pop_back();
+    return conn;
+}
+
+void ConnectionPool::release (Connection* conn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(conn);
+    }
+    cv.notify_one();
+}
+
+//==============================================================================
+// Database Definitions
+//==============================================================================
+
+Database::Database (const std::string& path) :
+    writer(path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | 
+                 SQLITE_OPEN_NOMUTEX),
+    readers(path, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 
+            DB_READ_CONNECTIONS) {
+
+    // write-ahead logging lets readers run alongside the insert transaction;
+    // NORMAL sync is durable at checkpoints and safe in WAL mode
+    writer.exec("PRAGMA journal_mode = WAL;"
+                "PRAGMA synchronous = NORMAL;", "Database");
+    initialize();
+}
+
 // checks if the given database table exists
-bool db_table_valid (sqlite3* db, const std::string& table_name) {
-    
-    // prepare statement to select 1 element from db and table
+bool Database::table_valid (const std::string& table_name) {
+    PooledConnection conn(readers);
+
+    // select 1 element from the table; the SQL names the table, so it is
+    // prepared for this call rather than cached
     std::string sql = "SELECT 1 FROM " + table_name + " LIMIT 1;";
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        panicf("db_table_valid: Failed to prepare statement.\n");
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn->handle(), sql.c_str(), -1, &stmt,
+        nullptr) != SQLITE_OK) {
+        panicf("table_valid: Failed to prepare statement.\n");
     }
-    
-    // execute statement: db table is valid if execution return matches row
+
+    // db table is valid if execution return matches row
     bool valid = (sqlite3_step(stmt) == SQLITE_ROW);
     sqlite3_finalize(stmt);
     return valid;
 }
 
-// print the number of rows in a databse table
-int db_get_num_rows (sqlite3 *db, const std::string& table_name) {
+// get the number of rows in a databse table
+int Database::get_num_rows (const std::string& table_name) {
+    PooledConnection conn(readers);
 
-    // prepare statement to select the count of all rows in the table
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT COUNT(*) FROM " + table_name;  
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        sqlite3_close(db);
-        panicf("db_print_num_rows: Failed to prepare statement.\n");
+    // select the count of all rows in the table
+    std::string sql = "SELECT COUNT(*) FROM " + table_name + ";";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn->handle(), sql.c_str(), -1, &stmt,
+        nullptr) != SQLITE_OK) {
+        panicf("get_num_rows: Failed to prepare statement.\n");
     }
 
     // execute the SELECT command
@@ -34,77 +514,187 @@ int db_get_num_rows (sqlite3 *db, const std::string& table_name) {
         return row_count;
     } else [[unlikely]] {
         sqlite3_finalize(stmt);
-        panicf("db_print_num_rows: Failed to execute SELECT COUNT(*)\n.");
+        panicf("get_num_rows: Failed to execute SELECT COUNT(*)\n.");
     }
 }
 
 // prints the first n entries in a database table
-void db_print_n_rows(sqlite3* db, const std::string& table_name, int num_rows) {
-    
-    sqlite3_stmt* stmt;
+void Database::print_n_rows (const std::string& table_name, int num_rows) {
+    PooledConnection conn(readers);
+
+    // select the first n entries in the databse
     std::string sql = "SELECT * FROM " + table_name + " LIMIT ?;";
-    
-    // prepare sql statement to select the first n entries in the databse
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        panicf("db_print_n_rows: Failed to prepare SELECT statement.\n");
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn->handle(), sql.c_str(), -1, &stmt,
+        nullptr) != SQLITE_OK) {
+        panicf("print_n_rows: Failed to prepare SELECT statement.\n");
     }
 
     // bind the limit value (number of entries to select) to the statement
     if (sqlite3_bind_int(stmt, 1, num_rows) != SQLITE_OK) {
         sqlite3_finalize(stmt);
-        panicf("db_print_n_rows: Failed to bind limit\n.");
+        panicf("print_n_rows: Failed to bind limit\n.");
     }
 
     // execute the SQL statement and print the result
     int columnCount = sqlite3_column_count(stmt);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         for (int col = 0; col < columnCount; ++col) {
-            
+
             // select column name and content
             const char* col_name = sqlite3_column_name(stmt, col);
             const char* col_text = (const char*)sqlite3_column_text(stmt, col);
-            
+
             // print the column contents
             fprintf(stderr, "%s: ", col_name);
             if (col_text) [[likely]] {
-                fprintf(stderr, "%s ", col_name);
+                fprintf(stderr, "%s ", col_text);
             } else {
                 fprintf(stderr, "NULL ");
             }
         }
         fprintf(stderr, "\n");
     }
+    sqlite3_finalize(stmt);
+}
+
+// determines if a file is already in the audio_files table
+// (directory, file name) pairs are the unique identifiers of table entries
+bool Database::entry_exists (const std::string& file_path) {
+    PooledConnection conn(readers);
+    return find_file_id(conn, file_path) >= 0;
 }
 
-// determines if an entry already exists in a database table
-// file paths are used as unique identifiers of table entries
-bool db_entry_exists (sqlite3* db, const std::string& table_name, 
-                    std::string file_path) {
+// get the names of the files in a directory that are in the audio_files table
+std::unordered_set<std::string> Database::directory_file_names (
+                                                const std::string& dir) {
+    PooledConnection conn(readers);
 
-    // prepare the SQL statement to select 1 entry with matching file_path
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT 1 FROM " + table_name + 
-                      " WHERE file_path = ? LIMIT 1;";
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        panicf("db_entry_exists: Failed to prepare SELECT statement\n");
+    std::unordered_set<std::string> names;
+    int64_t dir_id = find_directory(conn, dir);
+    if (dir_id < 0) {
+        return names;
     }
 
-    // bind the file path to the select statment
-    if (sqlite3_bind_text(stmt, 1, file_path.c_str(), -1, 
-        SQLITE_TRANSIENT) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        panicf("db_entry_exists: Failed to bind values.\n");
+    CachedStatement stmt(conn, SQL_DIRECTORY_FILES);
+    sqlite3_bind_int64(stmt, 1, dir_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        names.emplace(reinterpret_cast<const char*>(
+            sqlite3_column_text(stmt, 0)));
     }
+    return names;
+}
 
-    // execute the SQL statement to check if the file exists
-    bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
-    sqlite3_finalize(stmt);
-    return exists;
+// move audio_files from one full file_path per row to (dir_id, file_name)
+// SQLite can't drop a UNIQUE column, so the table is rebuilt: the new table
+// is filled from the old one keeping every row id, so the FTS index, tags,
+// overviews and similarity index stay valid, then the old table is dropped
+// and the triggers and indexes that went with it are recreated.
+void Database::migrate_directories (void) {
+    writer.exec("CREATE TABLE IF NOT EXISTS directories ("\
+                    "id INTEGER PRIMARY KEY,"\
+                    "path TEXT NOT NULL UNIQUE"\
+                ");"\
+                "ALTER TABLE audio_files ADD COLUMN dir_id INTEGER;",
+                "migrate_directories");
+
+    std::vector<std::pair<int64_t, std::string>> rows;
+    {
+        CachedStatement stmt(writer, "SELECT id, file_path FROM audio_files;");
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            rows.emplace_back(sqlite3_column_int64(stmt, 0),
+                reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        }
+    }
+    for (const auto& row : rows) {
+        std::string dir, name;
+        split_path(row.second, &dir, &name);
+        CachedStatement stmt(writer, 
+            "UPDATE audio_files SET dir_id = ?, file_name = ? WHERE id = ?;");
+        sqlite3_bind_int64(stmt, 1, intern_directory(dir));
+        sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 3, row.first);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            panicf("migrate_directories: Error updating data.\n");
+        }
+    }
+
+    writer.exec("CREATE TABLE audio_files_v7 ("\
+                    "id INTEGER PRIMARY KEY AUTOINCREMENT,"\
+                    "dir_id INTEGER NOT NULL,"\
+                    "file_name TEXT NOT NULL,"\
+                    "file_size INTEGER,"\
+                    "duration REAL,"\
+                    "num_user_tags INTEGER,"\
+                    "user_tags TEXT NOT NULL,"\
+                    "num_auto_tags INTEGER,"\
+                    "auto_tags TEXT NOT NULL,"\
+                    "user_bpm INTEGER,"\
+                    "user_key INTEGER,"\
+                    "auto_bpm INTEGER,"\
+                    "auto_key INTEGER,"\
+                    "timbre BLOB,"\
+                    "key_version INTEGER NOT NULL DEFAULT 0,"\
+                    "timbre_version INTEGER NOT NULL DEFAULT 0,"\
+                    "overview_version INTEGER NOT NULL DEFAULT 0,"\
+                    "effective_key INTEGER GENERATED ALWAYS AS (CASE "\
+                        "WHEN user_key > 0 THEN user_key - 1 "\
+                        "ELSE auto_key END) VIRTUAL,"\
+                    "effective_bpm INTEGER GENERATED ALWAYS AS (CASE "\
+                        "WHEN user_bpm > 0 THEN user_bpm "\
+                        "ELSE auto_bpm END) VIRTUAL,"\
+                    "UNIQUE (dir_id, file_name)"\
+                ");"\
+                "INSERT OR IGNORE INTO audio_files_v7 ("\
+                    "id, dir_id, file_name, file_size, duration, "\
+                    "num_user_tags, user_tags, num_auto_tags, auto_tags, "\
+                    "user_bpm, user_key, auto_bpm, auto_key, timbre, "\
+                    "key_version, timbre_version, overview_version) "\
+                "SELECT "\
+                    "id, dir_id, file_name, file_size, duration, "\
+                    "num_user_tags, user_tags, num_auto_tags, auto_tags, "\
+                    "user_bpm, user_key, auto_bpm, auto_key, timbre, "\
+                    "key_version, timbre_version, overview_version "\
+                "FROM audio_files ORDER BY id;"\
+                "DROP TABLE audio_files;"\
+                "ALTER TABLE audio_files_v7 RENAME TO audio_files;",
+                "migrate_directories");
+    writer.exec(SQL_FTS_TRIGGERS, "migrate_directories");
+    writer.exec(SQL_FILE_TAGS_TRIGGER, "migrate_directories");
+}
+
+// get the id of a directory, adding it to the directories table on first use
+// a scan inserts a directory's files together, so the last directory is
+// checked before the map
+int64_t Database::intern_directory (std::string_view dir) {
+    if (last_dir_id >= 0 && dir == last_dir) [[likely]] {
+        return last_dir_id;
+    }
+    last_dir.assign(dir.data(), dir.size());
+
+    auto it = dir_ids.find(last_dir);
+    if (it != dir_ids.end()) {
+        last_dir_id = it->second;
+        return last_dir_id;
+    }
+
+    int64_t id = find_directory(writer, last_dir);
+    if (id < 0) {
+        CachedStatement stmt(writer, SQL_INSERT_DIRECTORY);
+        sqlite3_bind_text(stmt, 1, last_dir.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            panicf("intern_directory: Error inserting directory.\n");
+        }
+        id = sqlite3_last_insert_rowid(writer.handle());
+    }
+    dir_ids.emplace(last_dir, id);
+    last_dir_id = id;
+    return id;
 }
 
 // set up the audio_files table if it doesn't already exist
-void db_initialize (sqlite3 *db) {
-    
+void Database::initialize (void) {
+
     const char* sql = "CREATE TABLE IF NOT EXISTS audio_files ("\
                         "id INTEGER PRIMARY KEY AUTOINCREMENT,"\
                         "file_path TEXT UNIQUE,"\
@@ -120,132 +710,753 @@ void db_initialize (sqlite3 *db) {
                         "auto_bpm INTEGER,"\
                         "auto_key INTEGER"\
                     ");";
+    writer.exec(sql, "initialize");
+
+    // migrate older databases one schema version at a time
+    int version = 0;
+    {
+        CachedStatement stmt(writer, "PRAGMA user_version;");
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int(stmt, 0);
+        }
+    }
+    if (version < DB_SCHEMA_VERSION) {
+        migrate(version);
+    }
+    {
+        CachedStatement stmt(writer, SQL_DATABASE_ID);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            panicf("initialize: Missing database id.\n");
+        }
+        identity = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+    }
+
+    // a bulk load that was interrupted left its staged rows behind; they
+    // were fully analyzed and committed, so finish the merge
+    {
+        CachedStatement stmt(writer, "SELECT 1 FROM sqlite_master "\
+                             "WHERE name = 'audio_files_staging';");
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            return;
+        }
+    }
+    merge_staging();
+}
+
+// migrate the schema from version to DB_SCHEMA_VERSION
+void Database::migrate (int version) {
+    writer.exec("BEGIN TRANSACTION;", "initialize");
+    if (version < 1) {
+        writer.exec("ALTER TABLE audio_files ADD COLUMN timbre BLOB;",
+                  "initialize");
+    }
+    if (version < 2) {
+        writer.exec("CREATE TABLE IF NOT EXISTS waveform_overviews ("\
+                      "file_id INTEGER NOT NULL,"\
+                      "bins INTEGER NOT NULL,"\
+                      "peaks BLOB NOT NULL,"\
+                      "PRIMARY KEY (file_id, bins)"\
+                  ") WITHOUT ROWID;", "initialize");
+    }
+    if (version < 3) {
+        // external content table: the index stores only tokens, rows are
+        // read from audio_files; triggers keep it in sync with every write
+        writer.exec("CREATE VIRTUAL TABLE IF NOT EXISTS audio_files_fts "\
+                  "USING fts5("\
+                      "file_name, auto_tags, user_tags,"\
+                      "content='audio_files', content_rowid='id',"\
+                      "tokenize='unicode61 remove_diacritics 2',"\
+                      "prefix='1 2 3'"\
+                  ");"\
+                  "INSERT INTO audio_files_fts(audio_files_fts) "\
+                  "VALUES ('rebuild');", "initialize");
+        writer.exec(SQL_FTS_TRIGGERS, "initialize");
+    }
+    if (version < 4) {
+        // (tag_id, file_id) order makes the primary key a covering posting
+        // list per tag; the second index serves per-file lookups
+        writer.exec("CREATE TABLE IF NOT EXISTS tags ("\
+                      "id INTEGER PRIMARY KEY,"\
+                      "name TEXT NOT NULL UNIQUE"\
+                  ");"\
+                  "CREATE TABLE IF NOT EXISTS file_tags ("\
+                      "tag_id INTEGER NOT NULL,"\
+                      "file_id INTEGER NOT NULL,"\
+                      "source INTEGER NOT NULL,"\
+                      "PRIMARY KEY (tag_id, file_id, source)"\
+                  ") WITHOUT ROWID;"\
+                  "CREATE INDEX IF NOT EXISTS file_tags_by_file "\
+                  "ON file_tags (file_id, tag_id);", "initialize");
+        writer.exec(SQL_FILE_TAGS_TRIGGER, "initialize");
+
+        // intern the tag strings of existing rows
+        std::vector<std::pair<int64_t, std::pair<std::string, std::string>>> rows;
+        {
+            CachedStatement stmt(writer, 
+                "SELECT id, auto_tags, user_tags FROM audio_files;");
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                rows.push_back({sqlite3_column_int64(stmt, 0), {
+                    reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                    reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))
+                }});
+            }
+        }
+        for (const auto& row : rows) {
+            insert_file_tags(row.first, row.second.first, TAG_SOURCE_AUTO);
+            insert_file_tags(row.first, row.second.second, TAG_SOURCE_USER);
+        }
+    }
+    if (version < 5) {
+        // rows analyzed since the timbre and overview columns were added are
+        // current; everything older is stale and gets re-analyzed
+        writer.exec("ALTER TABLE audio_files ADD COLUMN "\
+                        "key_version INTEGER NOT NULL DEFAULT 0;"\
+                    "ALTER TABLE audio_files ADD COLUMN "\
+                        "timbre_version INTEGER NOT NULL DEFAULT 0;"\
+                    "ALTER TABLE audio_files ADD COLUMN "\
+                        "overview_version INTEGER NOT NULL DEFAULT 0;"\
+                    "UPDATE audio_files SET "\
+                        "key_version = (timbre IS NOT NULL),"\
+                        "timbre_version = (timbre IS NOT NULL),"\
+                        "overview_version = EXISTS ("\
+                            "SELECT 1 FROM waveform_overviews "\
+                            "WHERE file_id = audio_files.id);", "initialize");
+    }
+    if (version < 6) {
+        // user overrides win over detected values; the catalog loads these
+        writer.exec("ALTER TABLE audio_files ADD COLUMN effective_key "\
+                        "INTEGER GENERATED ALWAYS AS (CASE WHEN user_key > 0 "\
+                        "THEN user_key - 1 ELSE auto_key END) VIRTUAL;"\
+                    "ALTER TABLE audio_files ADD COLUMN effective_bpm "\
+                        "INTEGER GENERATED ALWAYS AS (CASE WHEN user_bpm > 0 "\
+                        "THEN user_bpm ELSE auto_bpm END) VIRTUAL;", 
+                    "initialize");
+    }
+    if (version < 7) {
+        migrate_directories();
+    }
+    if (version < 8) {
+        // one row holding the serialized similarity graph
+        writer.exec("CREATE TABLE IF NOT EXISTS similarity_graph ("\
+                        "id INTEGER PRIMARY KEY CHECK (id = 1),"\
+                        "graph BLOB NOT NULL"\
+                    ");", "initialize");
+    }
+    if (version < 9) {
+        // random() draws from SQLite's generator, seeded from the OS
+        writer.exec("CREATE TABLE IF NOT EXISTS database_info ("\
+                        "id INTEGER PRIMARY KEY CHECK (id = 1),"\
+                        "database_id INTEGER NOT NULL"\
+                    ");"\
+                    "INSERT OR IGNORE INTO database_info (id, database_id) "\
+                    "VALUES (1, random());", "initialize");
+    }
+    if (version < 10) {
+        // filters and facets run on the in-memory catalog, so nothing reads
+        // the version 6 facet indexes; stop maintaining them on every write
+        writer.exec("DROP INDEX IF EXISTS audio_files_key_bpm;"\
+                    "DROP INDEX IF EXISTS audio_files_bpm;"\
+                    "DROP INDEX IF EXISTS audio_files_duration;", "initialize");
+    }
+    std::string set_version = "PRAGMA user_version = " +
+                              std::to_string(DB_SCHEMA_VERSION) + ";";
+    writer.exec(set_version.c_str(), "initialize");
+    writer.exec("COMMIT;", "initialize");
+}
+
+// this function works in conjunction with insert_files to submit files in
+// transactions. The cached statements are reused for every file, which is
+// much faster than preparing an insert per file. Text and blobs are bound
+// straight from the batch's arena, which outlives the statement step.
+void Database::insert_file (const RecordBatch& batch, 
+                            const PackedRecord& file,
+                            SimilarityIndex *index, Catalog *catalog) {
+
+    CachedStatement stmt(writer, bulk_loading ? SQL_STAGE_FILE : SQL_INSERT_FILE);
+
+    // bind the record's fields to the INSERT statement arguments
+    std::string_view dir = batch.text(file.dir);
+    std::string_view name = batch.text(file.file_name);
+    std::string_view user_tags = batch.text(file.user_tags);
+    std::string_view auto_tags = batch.text(file.auto_tags);
+    int64_t dir_id = intern_directory(dir);
+    sqlite3_bind_int64(stmt, 1, dir_id);
+    sqlite3_bind_text(stmt, 2, name.data(), static_cast<int>(name.size()),
+                      SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, file.file_size);
+    sqlite3_bind_double(stmt, 4, file.duration);
+    sqlite3_bind_int(stmt, 5, file.num_user_tags);
+    sqlite3_bind_text(stmt, 6, user_tags.data(), 
+                      static_cast<int>(user_tags.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 7, file.num_auto_tags);
+    sqlite3_bind_text(stmt, 8, auto_tags.data(), 
+                      static_cast<int>(auto_tags.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 9, file.user_bpm);
+    sqlite3_bind_int(stmt, 10, file.user_key);
+    sqlite3_bind_int(stmt, 11, file.auto_bpm);
+    sqlite3_bind_int(stmt, 12, file.auto_key);
+    if (file.timbre.length == 0) {
+        sqlite3_bind_null(stmt, 13);
+    } else {
+        sqlite3_bind_blob(stmt, 13, batch.floats(file.timbre),
+                          file.timbre.length, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, 14, KEY_ANALYZER_VERSION);
+    sqlite3_bind_int(stmt, 15, TIMBRE_ANALYZER_VERSION);
+    sqlite3_bind_int(stmt, 16, OVERVIEW_ANALYZER_VERSION);
+    if (bulk_loading) {
+        sqlite3_bind_int64(stmt, 17, bulk_next_id);
+    }
 
-    char* err_msg = nullptr;
-    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
-        sqlite3_free(err_msg);
-        panicf("db_initialize: Error creating table\n");
-    }
-}
-
-// this function works in conjunction with db_insert_files to submit files in
-// transactions. This allows the reuse of a sqlite3_stmt, which is much
-// faster than inserting entries one at a time
-void db_insert_file(sqlite3 *db, const struct FileRecord *file, 
-                    sqlite3_stmt *stmt) {
-    
-    // bind the FileRecord data to the INSERT statement arguments
-    sqlite3_bind_text(stmt, 1, file->file_path.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, file->file_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, file->file_size);
-    sqlite3_bind_double(stmt, 4, file->duration);
-    sqlite3_bind_int(stmt, 5, file->num_user_tags);
-    sqlite3_bind_text(stmt, 6, file->user_tags.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 7, file->num_auto_tags);
-    sqlite3_bind_text(stmt, 8, file->auto_tags.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 9, file->user_bpm);
-    sqlite3_bind_int(stmt, 10, file->user_key);
-    sqlite3_bind_int(stmt, 11, file->auto_bpm);
-    sqlite3_bind_int(stmt, 12, file->auto_key);
-    
     if (sqlite3_step(stmt) != SQLITE_DONE) {
-        panicf("db_insert_file: Error inserting data.\n");
-    }
-
-    // reset the statement for reuse
-    sqlite3_reset(stmt); 
-}
-
-// db_insert_files inserts entries in the audio_files database table
-// data to insert comes from a vector of FileRecord structs
-void db_insert_files (sqlite3 *db, ThreadSafeQueue<struct FileRecord *> *files) {
-
-    // create statement to insert all members of explorer file struct
-    const char* sql =   "INSERT OR IGNORE INTO audio_files ("\
-                            "file_path,"\
-                            "file_name,"\
-                            "file_size,"\
-                            "duration,"\
-                            "num_user_tags,"\
-                            "user_tags,"\
-                            "num_auto_tags,"\
-                            "auto_tags,"\
-                            "user_bpm,"\
-                            "user_key,"\
-                            "auto_bpm,"\
-                            "auto_key)"\
-                            " VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
-    sqlite3_stmt* stmt = nullptr;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        panicf("db_insert_files: Error preparing statemen.\n");
-    } 
+        panicf("insert_file: Error inserting data.\n");
+    }
+
+    // staged rows only become visible, and indexed, when the bulk load ends
+    if (bulk_loading) {
+        int64_t id = bulk_next_id++;
+        insert_file_tags(id, auto_tags, TAG_SOURCE_AUTO);
+        insert_file_tags(id, user_tags, TAG_SOURCE_USER);
+        batch.for_each_level(file, [&](int bins, const int8_t *peaks,
+                                       size_t bytes) {
+            insert_overview_level(id, bins, peaks, bytes);
+        });
+        return;
+    }
+
+    // ignored rows were already in the database
+    if (sqlite3_changes(writer.handle()) == 0) {
+        return;
+    }
+    int64_t id = sqlite3_last_insert_rowid(writer.handle());
+
+    // intern the tags into the inverted index
+    insert_file_tags(id, auto_tags, TAG_SOURCE_AUTO);
+    insert_file_tags(id, user_tags, TAG_SOURCE_USER);
+
+    // index the new row
+    if (catalog) {
+        catalog->insert(id, dir_id, batch, file);
+    }
+    if (index && file.timbre.length > 0) {
+        index->insert(id, batch.floats(file.timbre), 
+                      batch.num_floats(file.timbre));
+    }
+
+    // the id is new, so there are no old levels to delete
+    batch.for_each_level(file, [&](int bins, const int8_t *peaks,
+                                   size_t bytes) {
+        insert_overview_level(id, bins, peaks, bytes);
+    });
+}
+
+// add one overview level of a file, staged during a bulk load
+void Database::insert_overview_level (int64_t file_id, int bins,
+                                      const int8_t *peaks, size_t bytes) {
+    CachedStatement stmt(writer, bulk_loading ? SQL_STAGE_OVERVIEW : 
+                                                SQL_INSERT_OVERVIEW);
+    sqlite3_bind_int64(stmt, 1, file_id);
+    sqlite3_bind_int(stmt, 2, bins);
+    sqlite3_bind_blob(stmt, 3, peaks, static_cast<int>(bytes), SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        panicf("insert_overview_level: Error inserting overview.\n");
+    }
+}
+
+// replace the overview levels of a file
+// one row per level, so a fetch reads only the level it needs
+void Database::write_overview (int64_t file_id, 
+                               const WaveformOverview& overview) {
+    if (!bulk_loading) {
+        CachedStatement stmt(writer, SQL_DELETE_OVERVIEW);
+        sqlite3_bind_int64(stmt, 1, file_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            panicf("write_overview: Error deleting overview.\n");
+        }
+    }
+    for (const WaveformLevel &level : overview) {
+        insert_overview_level(file_id, level.bins, level.peaks.data(),
+                              level.peaks.size());
+    }
+}
+
+// get stale files after a row id, in id order
+std::vector<std::pair<int64_t, std::string>> Database::select_stale_files (
+                                                int64_t after_id, int limit) {
+    PooledConnection conn(readers);
+
+    CachedStatement stmt(conn, SQL_SELECT_STALE);
+    sqlite3_bind_int64(stmt, 1, after_id);
+    sqlite3_bind_int(stmt, 2, KEY_ANALYZER_VERSION);
+    sqlite3_bind_int(stmt, 3, TIMBRE_ANALYZER_VERSION);
+    sqlite3_bind_int(stmt, 4, OVERVIEW_ANALYZER_VERSION);
+    sqlite3_bind_int(stmt, 5, limit);
+
+    std::vector<std::pair<int64_t, std::string>> files;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        files.emplace_back(sqlite3_column_int64(stmt, 0), join_path(
+            reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+            reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2))));
+    }
+    return files;
+}
+
+// write re-analysis results in one transaction
+void Database::update_analysis (
+        const std::vector<std::pair<int64_t, const struct FileRecord*>>& files,
+        SimilarityIndex* index, Catalog* catalog) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+
+    writer.exec("BEGIN TRANSACTION;", "update_analysis");
+    bool timbre_changed = false;
+    for (const auto& entry : files) {
+        int64_t id = entry.first;
+        const struct FileRecord* file = entry.second;
+        {
+            CachedStatement stmt(writer, SQL_UPDATE_ANALYSIS);
+            sqlite3_bind_double(stmt, 1, file->duration);
+            sqlite3_bind_int(stmt, 2, file->auto_key);
+            if (file->timbre.empty()) {
+                sqlite3_bind_null(stmt, 3);
+            } else {
+                sqlite3_bind_blob(stmt, 3, file->timbre.data(),
+                                  file->timbre.size() * sizeof(float),
+                                  SQLITE_STATIC);
+            }
+            sqlite3_bind_int(stmt, 4, KEY_ANALYZER_VERSION);
+            sqlite3_bind_int(stmt, 5, TIMBRE_ANALYZER_VERSION);
+            sqlite3_bind_int(stmt, 6, OVERVIEW_ANALYZER_VERSION);
+            sqlite3_bind_int64(stmt, 7, id);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                panicf("update_analysis: Error updating data.\n");
+            }
+        }
+        write_overview(id, file->overview);
+        if (catalog) {
+            catalog->update_analysis(id, *file);
+        }
+        if (index && !file->timbre.empty()) {
+            index->update(id, file->timbre);
+        }
+        timbre_changed |= !file->timbre.empty();
+    }
+
+    // the saved graph holds the old vectors; it is saved again from the
+    // updated index, and until then the next start rebuilds it
+    if (timbre_changed) {
+        CachedStatement stmt(writer, SQL_DROP_GRAPH);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            panicf("update_analysis: Error dropping similarity graph.\n");
+        }
+    }
+    writer.exec("COMMIT;", "update_analysis");
+}
+
+// start staging inserts for a bulk load
+void Database::begin_bulk_load (void) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (bulk_loading) {
+        return;
+    }
+
+    writer.exec(SQL_CREATE_STAGING, "begin_bulk_load");
+    {
+        CachedStatement stmt(writer, SQL_NEXT_STAGED_ID);
+        if (sqlite3_step(stmt) != SQLITE_ROW) {
+            panicf("begin_bulk_load: Error reading row ids.\n");
+        }
+        bulk_next_id = sqlite3_column_int64(stmt, 0);
+    }
+
+    // staging keeps the connection's synchronous NORMAL: in WAL mode a power
+    // failure can roll back the last commits but never corrupts the file,
+    // and staged rows that are lost are simply scanned again
+    bulk_loading = true;
+}
+
+// merge the staging tables into the catalog in one transaction
+void Database::finish_bulk_load (void) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (!bulk_loading) {
+        return;
+    }
+    merge_staging();
+    bulk_loading = false;
+}
+
+// merge whatever is staged in one transaction
+void Database::merge_staging (void) {
+    writer.exec("BEGIN TRANSACTION;", "merge_staging");
+    writer.exec(SQL_MERGE_STAGING, "merge_staging");
+    writer.exec(SQL_FTS_TRIGGERS, "merge_staging");
+    writer.exec("COMMIT;", "merge_staging");
+}
+
+// insert_files inserts entries in the audio_files database table
+// data to insert comes from the packed records of a set of scan batches
+void Database::insert_files (const std::vector<RecordBatch*>& batches,
+                             SimilarityIndex *index, Catalog *catalog) {
+    std::lock_guard<std::mutex> lock(write_mutex);
 
     // insert files in a single transaction
-    sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
-    while (!files->empty()) {
-        struct FileRecord* file;
-        files->wait_pop(file);
-        db_insert_file(db, file, stmt);
-        delete file;
-    }
-    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
-    sqlite3_finalize(stmt);
+    writer.exec("BEGIN TRANSACTION;", "insert_files");
+    for (const RecordBatch* batch : batches) {
+        for (size_t i = 0; i < batch->size(); i++) {
+            insert_file(*batch, (*batch)[i], index, catalog);
+        }
+    }
+    writer.exec("COMMIT;", "insert_files");
 }
 
-// Function to search files by name
-std::vector<FileRecord> db_search_files_by_name (sqlite3* db, 
-                                            const std::string& search_query) {
-    
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT "\
-                    "file_path, "\
-                    "file_name, "\
-                    "file_size, "\
-                    "duration, "\
-                    "num_user_tags, "\
-                    "user_tags, "\
-                    "num_auto_tags, "\
-                    "auto_tags, "\
-                    "user_bpm, "\
-                    "user_key, "\
-                    "auto_bpm, "\
-                    "auto_key "\
-                    "FROM audio_files WHERE file_name LIKE ?;";
-    
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        panicf("search_files_by_name: Failed to prepare statement.\n");
-    }
-    
-    // Bind the search query with wildcard characters for pattern matching
-    std::string query_param = "%" + search_query + "%";
-    sqlite3_bind_text(stmt, 1, query_param.c_str(), -1, SQLITE_STATIC);
-    
-    // Execute the statement and process the results
-    std::vector<FileRecord> results;
+// CancelGuard makes a connection's statements fail with SQLITE_INTERRUPT
+// once a cancel flag is set, through a progress handler that SQLite calls
+// every DB_PROGRESS_OPS instructions. The handler is removed on destruction
+// so the pooled connection goes back clean.
+class CancelGuard {
+public:
+    CancelGuard (Connection& conn, const std::atomic<bool>* cancel) :
+        db(cancel ? conn.handle() : nullptr) {
+        if (db) {
+            sqlite3_progress_handler(db, DB_PROGRESS_OPS, &CancelGuard::check,
+                                     const_cast<std::atomic<bool>*>(cancel));
+        }
+    }
+    ~CancelGuard (void) {
+        if (db) {
+            sqlite3_progress_handler(db, 0, nullptr, nullptr);
+        }
+    }
+
+    CancelGuard (const CancelGuard&) = delete;
+    CancelGuard& operator= (const CancelGuard&) = delete;
+
+private:
+    sqlite3* db;
+
+    static int check (void* cancel) {
+        return static_cast<std::atomic<bool>*>(cancel)->load() ? 1 : 0;
+    }
+};
+
+// read up to page_size SearchHit rows (id, score, file_name, duration,
+// auto_key); a further row means another page follows
+static void read_search_page (sqlite3_stmt *stmt, int page_size, 
+                              SearchPage *page) {
+    page->hits.reserve(page_size);
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (static_cast<int>(page->hits.size()) == page_size) {
+            page->has_more = true;
+            break;
+        }
+        struct SearchHit hit;
+        hit.id = sqlite3_column_int64(stmt, 0);
+        hit.score = sqlite3_column_double(stmt, 1);
+        hit.file_name = reinterpret_cast<const char*>(
+            sqlite3_column_text(stmt, 2));
+        hit.duration = sqlite3_column_int(stmt, 3);
+        hit.auto_key = sqlite3_column_int(stmt, 4);
+        page->hits.push_back(std::move(hit));
+    }
+    page->cancelled = (rc == SQLITE_INTERRUPT);
+
+    if (!page->hits.empty()) {
+        page->next.valid = true;
+        page->next.score = page->hits.back().score;
+        page->next.id = page->hits.back().id;
+    }
+}
+
+// look up the id of a tag on a connection, -1 if the tag is unknown
+static int64_t find_tag (Connection& conn, const std::string& name) {
+    CachedStatement stmt(conn, SQL_FIND_TAG);
+    sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        return sqlite3_column_int64(stmt, 0);
+    }
+    return -1;
+}
+
+// search file names and tags with the full-text index, one page at a time
+SearchPage Database::search_files_by_name (const std::string& search_query,
+                                           const SearchCursor& after,
+                                           int page_size,
+                                           const std::atomic<bool>* cancel) {
+    SearchPage page;
+    std::string match = fts_match_expression(search_query);
+    if (match.empty() || page_size <= 0) {
+        return page;
+    }
+
+    PooledConnection conn(readers);
+    CancelGuard guard(conn, cancel);
+    CachedStatement stmt(conn, SQL_SEARCH_BY_NAME);
+    sqlite3_bind_text(stmt, 1, match.c_str(), -1, SQLITE_STATIC);
+    if (after.valid) {
+        sqlite3_bind_double(stmt, 2, after.score);
+        sqlite3_bind_int64(stmt, 3, after.id);
+    }
+    // one extra row tells whether another page follows
+    sqlite3_bind_int(stmt, 4, page_size + 1);
+
+    read_search_page(stmt, page_size, &page);
+    return page;
+}
+
+// get the full record of a row id
+bool Database::get_file (int64_t file_id, struct FileRecord* file) {
+    PooledConnection conn(readers);
+    CachedStatement stmt(conn, SQL_GET_FILE_BY_ID);
+    sqlite3_bind_int64(stmt, 1, file_id);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        return false;
+    }
+    read_file_record(stmt, file);
+    return true;
+}
+
+// get the row id of a file path, -1 if the file is not in the database
+int64_t Database::get_file_id (const std::string& file_path) {
+    PooledConnection conn(readers);
+    return find_file_id(conn, file_path);
+}
+
+// load the saved similarity graph, then index the rows added since
+void Database::load_similarity_index (SimilarityIndex* index) {
+    PooledConnection conn(readers);
+
+    // a graph that doesn't deserialize is rebuilt from the timbre column
+    if (index->size() == 0) {
+        CachedStatement stmt(conn, SQL_LOAD_GRAPH);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            index->deserialize(static_cast<const uint8_t*>(
+                                   sqlite3_column_blob(stmt, 0)),
+                               sqlite3_column_bytes(stmt, 0));
+        }
+    }
+
+    CachedStatement stmt(conn, SQL_LOAD_TIMBRE);
+    sqlite3_bind_int64(stmt, 1, index->last_id());
+    std::vector<float> timbre(TIMBRE_DIMS);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        struct FileRecord file;
-        
-        file.file_path = reinterpret_cast<const char*>(
-            sqlite3_column_text(stmt, 0));
-        file.file_name = reinterpret_cast<const char*>(
-            sqlite3_column_text(stmt, 1));
-        file.file_size = sqlite3_column_int(stmt, 2);
-        file.duration = sqlite3_column_int(stmt, 3);
-        file.num_user_tags = sqlite3_column_int(stmt, 4);
-        file.user_tags = reinterpret_cast<const char*>(
-            sqlite3_column_text(stmt, 5));
-        file.num_auto_tags = sqlite3_column_int(stmt, 6);
-        file.auto_tags = reinterpret_cast<const char*>(
-            sqlite3_column_text(stmt, 7));
-        file.user_bpm = sqlite3_column_int(stmt, 8);
-        file.user_key = sqlite3_column_int(stmt, 9);
-        file.auto_bpm = sqlite3_column_int(stmt, 10);
-        file.auto_key = sqlite3_column_int(stmt, 11);
-
-        results.push_back(file);
-    }
-    
-    sqlite3_finalize(stmt);
+        // skip embeddings written with a different TIMBRE_DIMS
+        int bytes = sqlite3_column_bytes(stmt, 1);
+        if (bytes != TIMBRE_DIMS * static_cast<int>(sizeof(float))) {
+            continue;
+        }
+        memcpy(timbre.data(), sqlite3_column_blob(stmt, 1), bytes);
+        index->insert(sqlite3_column_int64(stmt, 0), timbre);
+    }
+}
+
+// save the similarity graph, replacing the saved one
+void Database::save_similarity_index (const SimilarityIndex* index) {
+    std::vector<uint8_t> graph;
+    index->serialize(&graph);
+
+    std::lock_guard<std::mutex> lock(write_mutex);
+    CachedStatement stmt(writer, SQL_SAVE_GRAPH);
+    sqlite3_bind_blob64(stmt, 1, graph.data(), graph.size(), SQLITE_STATIC);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        panicf("save_similarity_index: Error saving similarity graph.\n");
+    }
+}
+
+// load the rows after the catalog's last row into the in-memory catalog
+bool Database::load_catalog (Catalog* catalog) {
+    PooledConnection conn(readers);
+
+    // a catalog from a snapshot ahead of this database would silently
+    // drop the rows that reuse its ids, so it is reloaded whole instead
+    bool consistent = true;
+    if (catalog->size() > 0) {
+        std::string last_path = catalog->path(
+            static_cast<uint32_t>(catalog->size() - 1));
+        if (find_file_id(conn, last_path) != catalog->last_id()) {
+            catalog->clear();
+            consistent = false;
+        }
+    }
+
+    CachedStatement stmt(conn, SQL_LOAD_CATALOG);
+    sqlite3_bind_int64(stmt, 1, catalog->last_id());
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* tags = reinterpret_cast<const char*>(
+            sqlite3_column_text(stmt, 8));
+        catalog->insert(sqlite3_column_int64(stmt, 0),
+                        sqlite3_column_int64(stmt, 1),
+                        reinterpret_cast<const char*>(
+                            sqlite3_column_text(stmt, 2)),
+                        reinterpret_cast<const char*>(
+                            sqlite3_column_text(stmt, 3)),
+                        sqlite3_column_int64(stmt, 4),
+                        sqlite3_column_int(stmt, 5),
+                        sqlite3_column_type(stmt, 6) == SQLITE_NULL ?
+                            -1 : sqlite3_column_int(stmt, 6),
+                        sqlite3_column_int(stmt, 7),
+                        tags ? tags : "");
+    }
+    return consistent;
+}
+
+uint64_t Database::database_id (void) const {
+    return identity;
+}
+
+// fetch the waveform overview level that best fits a pixel width
+bool Database::fetch_overview (int64_t file_id, int pixel_width,
+                               WaveformLevel* level) {
+    PooledConnection conn(readers);
+
+    CachedStatement stmt(conn, SQL_FETCH_OVERVIEW);
+    sqlite3_bind_int64(stmt, 1, file_id);
+    sqlite3_bind_int(stmt, 2, pixel_width);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        return false;
+    }
+    level->bins = sqlite3_column_int(stmt, 0);
+    const int8_t* peaks = static_cast<const int8_t*>(
+        sqlite3_column_blob(stmt, 1));
+    level->peaks.assign(peaks, peaks + sqlite3_column_bytes(stmt, 1));
+    return true;
+}
+
+// find the k files that sound most like the given file, closest first
+std::vector<FileRecord> Database::find_similar_files (
+                                            const SimilarityIndex* index,
+                                            const std::string& file_path,
+                                            int k) {
+    PooledConnection conn(readers);
+
+    std::vector<FileRecord> results;
+    int64_t id = find_file_id(conn, file_path);
+    if (id < 0) {
+        return results;
+    }
+
+    // fetch the neighbouring rows
+    for (const auto& neighbour : index->search_by_id(id, k)) {
+        CachedStatement stmt(conn, SQL_GET_FILE_BY_ID);
+        sqlite3_bind_int64(stmt, 1, neighbour.first);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            struct FileRecord file;
+            read_file_record(stmt, &file);
+            results.push_back(file);
+        }
+    }
     return results;
-}
\ No newline at end of file
+}
+
+// get the id of a tag, adding it to the tags table on first use
+int64_t Database::intern_tag (const std::string& name) {
+    auto it = tag_ids.find(name);
+    if (it != tag_ids.end()) [[likely]] {
+        return it->second;
+    }
+
+    int64_t id = find_tag(writer, name);
+    if (id < 0) {
+        CachedStatement stmt(writer, SQL_INSERT_TAG);
+        sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            panicf("intern_tag: Error inserting tag.\n");
+        }
+        id = sqlite3_last_insert_rowid(writer.handle());
+    }
+    tag_ids.emplace(name, id);
+    return id;
+}
+
+// link a file to each tag in a space separated tag string
+void Database::insert_file_tags (int64_t file_id, std::string_view tags,
+                                 int source) {
+    size_t start = 0;
+    while (start < tags.size()) {
+        size_t end = tags.find(' ', start);
+        if (end == std::string_view::npos) {
+            end = tags.size();
+        }
+        if (end > start) {
+            tag_buffer.assign(tags.data() + start, end - start);
+            CachedStatement stmt(writer, bulk_loading ? SQL_STAGE_FILE_TAG :
+                                                        SQL_INSERT_FILE_TAG);
+            sqlite3_bind_int64(stmt, 1, intern_tag(tag_buffer));
+            sqlite3_bind_int64(stmt, 2, file_id);
+            sqlite3_bind_int(stmt, 3, source);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                panicf("insert_file_tags: Error inserting file tag.\n");
+            }
+        }
+        start = end + 1;
+    }
+}
+
+// get the posting lists (sorted file ids) for a set of tag names
+// an unknown tag gets an empty list
+static std::vector<std::vector<int64_t>> tag_postings (Connection& conn,
+                                    const std::vector<std::string>& tags) {
+    std::vector<std::vector<int64_t>> postings;
+    for (const std::string& tag : tags) {
+        postings.emplace_back();
+        int64_t tag_id = find_tag(conn, tag);
+        if (tag_id < 0) {
+            continue;
+        }
+        CachedStatement stmt(conn, SQL_TAG_POSTINGS);
+        sqlite3_bind_int64(stmt, 1, tag_id);
+        std::vector<int64_t>& list = postings.back();
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int64_t file_id = sqlite3_column_int64(stmt, 0);
+            if (list.empty() || list.back() != file_id) {
+                list.push_back(file_id);
+            }
+        }
+    }
+    return postings;
+}
+
+// get the row ids of files carrying every tag (AND), in id order
+std::vector<int64_t> Database::files_with_all_tags (
+                                    const std::vector<std::string>& tags) {
+    PooledConnection conn(readers);
+    std::vector<std::vector<int64_t>> postings = tag_postings(conn, tags);
+    std::vector<const std::vector<int64_t>*> lists;
+    for (const auto& list : postings) {
+        lists.push_back(&list);
+    }
+    return intersect_postings(lists);
+}
+
+// get the row ids of files carrying any of the tags (OR), in id order
+std::vector<int64_t> Database::files_with_any_tags (
+                                    const std::vector<std::string>& tags) {
+    PooledConnection conn(readers);
+    std::vector<std::vector<int64_t>> postings = tag_postings(conn, tags);
+    std::vector<const std::vector<int64_t>*> lists;
+    for (const auto& list : postings) {
+        lists.push_back(&list);
+    }
+    return union_postings(lists);
+}
+
+// get (tag, file count) pairs for tags starting with prefix, most used first
+std::vector<std::pair<std::string, int>> Database::tag_frequencies (
+                                            const std::string& prefix,
+                                            int limit) {
+    PooledConnection conn(readers);
+
+    std::string upper = prefix + "\xff";
+    CachedStatement stmt(conn, SQL_TAG_FREQUENCIES);
+    sqlite3_bind_text(stmt, 1, prefix.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, upper.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    std::vector<std::pair<std::string, int>> frequencies;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        frequencies.emplace_back(
+            reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+            sqlite3_column_int(stmt, 1));
+    }
+    return frequencies;
+}
@@ -144,7 +144,7 @@ int assign_key (MidiMap *midi_map) {
 }
 
 void process_segment (const std::vector<float> *samples, int start, 
-                                        int sample_rate, MidiMap *midi_map) {
+                      int sample_rate, MidiMap *midi_map, TimbreMap *timbre_map) {
 
     // accumulate the results in the midi map
     if (!midi_map) {
@@ -152,11 +152,15 @@ void process_segment (const std::vector<float> *samples, int start,
     }
 
     // pack samples in fft input arrays
+    // short files and the tail of long ones are zero padded
     kiss_fft_cpx input[FFT_WINDOW_SIZE];
     kiss_fft_cpx output[FFT_WINDOW_SIZE];
+    int available = static_cast<int>(samples->size()) - start;
+    int num_samples = std::max(0, std::min(available, FFT_WINDOW_SIZE));
     for (int i=0; i<FFT_WINDOW_SIZE; i++) {
-        input[i].r = (*samples)[start+i];
-        input[i].i = (*samples)[start+i];
+        float sample = (i < num_samples) ? (*samples)[start+i] : 0.0f;
+        input[i].r = sample;
+        input[i].i = sample;
     }
 
     // perform the fft
@@ -169,45 +173,19 @@ void process_segment (const std::vector<float> *samples, int start,
     // 1. calculate nearest midi note
     // 2. accumualte magnitude of fft result in midi map
     int limit = FFT_WINDOW_SIZE / 2;
+    float magnitudes[FFT_WINDOW_SIZE / 2];
     for (int i=0; i<limit; i++) {
         int note_id = midi_note(i, sample_rate);
         float mag = magnitude(&output[i]);
         midi_map->inc_weight(note_id, mag);
+        magnitudes[i] = mag;
     }
 
-    return;
-}
-
-int kdet_detect_key (std::string path) {
-    
-    fprintf(stderr, "\r%s", path.c_str());
-
-    // get audio file samples
-    AudioFile<float> file;
-    if (!path_is_ascii(path) || !file.load(path)) {
-        return -1;
-    } 
-    int sample_rate = file.getSampleRate();
-    const std::vector<float> samples = make_mono(file.samples);
-
-    MidiMap midi_map;
-
-    // break file samples into segments and process each
-    int num_sub = file.getNumSamplesPerChannel() - FFT_WINDOW_SIZE;
-    int maxx = (num_sub > MAX_ANALYSIS_TIME) ? MAX_ANALYSIS_TIME : num_sub;
-    
-    std::vector<std::thread> threads;
-    for (int i=0; i<=num_sub; i += FFT_WINDOW_SIZE) {
-        threads.emplace_back(&process_segment, &samples, i, sample_rate, &midi_map);
-    }
-
-    // Join all threads
-    for (auto& t : threads) {
-        if (t.joinable()) {
-            t.join();
-        }
+    // the same spectrum feeds the timbre embedding
+    if (timbre_map && num_samples > 0) {
+        timbre_map->accumulate(magnitudes, limit, sample_rate, 
+                               samples->data() + start, num_samples);
     }
 
-    // assign key based on fft results
-    return assign_key(&midi_map);
-}
\ No newline at end of file
+    return;
+}
@@ -0,0 +1,110 @@
+#include "..\inc\FuzzyMatch.h"
+
+static inline int char_class_bit (unsigned char c) {
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a';
+    }
+    if (c >= '0' && c <= '9') {
+        return 26 + (c - '0');
+    }
+    return 36 + (c % 28);
+}
+
+uint64_t fuzzy_char_mask (std::string_view folded) {
+    uint64_t mask = 0;
+    for (char c : folded) {
+        mask |= 1ull << char_class_bit(static_cast<unsigned char>(c));
+    }
+    return mask;
+}
+
+bool is_subsequence (std::string_view text, std::string_view pattern) {
+    size_t p = 0;
+    for (size_t i = 0; i < text.size() && p < pattern.size(); i++) {
+        p += (text[i] == pattern[p]);
+    }
+    return p == pattern.size();
+}
+
+// bonus for a match at position i of the stored name
+static int boundary_bonus (std::string_view text, size_t i) {
+    unsigned char c = static_cast<unsigned char>(text[i]);
+    if (i == 0) {
+        return FUZZY_BONUS_BOUNDARY;
+    }
+    unsigned char prev = static_cast<unsigned char>(text[i - 1]);
+    if (!std::isalnum(prev) && std::isalnum(c)) {
+        return FUZZY_BONUS_BOUNDARY;
+    }
+    if ((std::islower(prev) && std::isupper(c)) ||
+        (std::isalpha(prev) && std::isdigit(c))) {
+        return FUZZY_BONUS_CAMEL;
+    }
+    return 0;
+}
+
+// The first occurrence found going forward is tightened by walking back from
+// its end, which gives the shortest window ending there; that window is
+// scored. This is fzf's linear matcher: it can miss a better scoring window
+// further right, but never rejects a match.
+bool fuzzy_score (std::string_view text, std::string_view folded,
+                  std::string_view pattern, int *score) {
+    if (pattern.empty()) {
+        *score = 0;
+        return true;
+    }
+
+    size_t p = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < folded.size(); i++) {
+        if (folded[i] == pattern[p] && ++p == pattern.size()) {
+            end = i + 1;
+            break;
+        }
+    }
+    if (p < pattern.size()) {
+        return false;
+    }
+
+    size_t start = end - 1;
+    p = pattern.size() - 1;
+    for (size_t i = end; i-- > 0;) {
+        if (folded[i] == pattern[p]) {
+            if (p == 0) {
+                start = i;
+                break;
+            }
+            p--;
+        }
+    }
+
+    int total = 0;
+    int first_bonus = 0;
+    bool in_run = false;
+    bool in_gap = false;
+    p = 0;
+    for (size_t i = start; i < end; i++) {
+        if (p < pattern.size() && folded[i] == pattern[p]) {
+            int bonus = boundary_bonus(text, i);
+            if (in_run) {
+                // a run keeps at least the bonus of its first character
+                bonus = std::max({bonus, first_bonus, FUZZY_BONUS_CONSECUTIVE});
+            } else {
+                first_bonus = bonus;
+            }
+            if (p == 0) {
+                bonus *= FUZZY_FIRST_CHAR_MULTIPLIER;
+            }
+            total += FUZZY_SCORE_MATCH + bonus;
+            in_run = true;
+            in_gap = false;
+            p++;
+        } else {
+            total -= in_gap ? FUZZY_GAP_EXTENSION : FUZZY_GAP_START;
+            in_run = false;
+            in_gap = true;
+        }
+    }
+    *score = total;
+    return true;
+}
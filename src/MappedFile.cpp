@@ -0,0 +1,88 @@
+#include "..\inc\MappedFile.h"
+
+MappedFile::~MappedFile (void) {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open (const std::string &path) {
+    close();
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    bytes = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!bytes) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(file_size.QuadPart);
+    return true;
+}
+
+void MappedFile::close (void) {
+    if (bytes) {
+        UnmapViewOfFile(bytes);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+    }
+    bytes = nullptr;
+    length = 0;
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open (const std::string &path) {
+    close();
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close();
+        return false;
+    }
+    void *addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, 
+                      MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return false;
+    }
+    bytes = static_cast<const uint8_t*>(addr);
+    length = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void MappedFile::close (void) {
+    if (bytes) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    bytes = nullptr;
+    length = 0;
+    fd = -1;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "..\inc\MemoryBudget.h"
+
+MemoryBudget::MemoryBudget (size_t limit) : limit_bytes(std::max<size_t>(limit, 1)) {}
+
+size_t MemoryBudget::reserve (size_t bytes) {
+    std::unique_lock<std::mutex> lock(mutex);
+    released.wait(lock, [this, &bytes]() {
+        bytes = std::min(bytes, limit_bytes);
+        return used + bytes <= limit_bytes;
+    });
+    used += bytes;
+    return bytes;
+}
+
+void MemoryBudget::release (size_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        used -= std::min(bytes, used);
+    }
+    released.notify_all();
+}
+
+void MemoryBudget::set_limit (size_t limit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        limit_bytes = std::max<size_t>(limit, 1);
+    }
+    released.notify_all();
+}
+
+size_t MemoryBudget::limit (void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit_bytes;
+}
+
+size_t MemoryBudget::in_use (void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
+
+MemoryReservation::MemoryReservation (MemoryBudget &budget, size_t bytes) :
+    budget(budget), bytes(budget.reserve(bytes)) {}
+
+MemoryReservation::~MemoryReservation (void) {
+    release();
+}
+
+void MemoryReservation::release (void) {
+    if (bytes > 0) {
+        budget.release(bytes);
+        bytes = 0;
+    }
+}
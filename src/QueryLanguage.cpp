@@ -0,0 +1,310 @@
+#include "..\inc\QueryLanguage.h"
+
+static std::string fold (const std::string &str) {
+    std::string folded_str(str);
+    for (char &c : folded_str) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return folded_str;
+}
+
+// Split a query into words. A quoted stretch, anywhere in a word, keeps its
+// spaces and loses its quotes; quoted records whether a word had one.
+static bool split_words (const std::string &query,
+                         std::vector<std::string> *words,
+                         std::vector<bool> *quoted, std::string *error) {
+    size_t i = 0;
+    while (i < query.size()) {
+        if (std::isspace(static_cast<unsigned char>(query[i]))) {
+            i++;
+            continue;
+        }
+        std::string word;
+        bool has_quote = false;
+        while (i < query.size() &&
+               !std::isspace(static_cast<unsigned char>(query[i]))) {
+            if (query[i] != '"') {
+                word += query[i++];
+                continue;
+            }
+            size_t close = query.find('"', i + 1);
+            if (close == std::string::npos) {
+                *error = "unterminated quote";
+                return false;
+            }
+            word += query.substr(i + 1, close - i - 1);
+            has_quote = true;
+            i = close + 1;
+        }
+        words->push_back(word);
+        quoted->push_back(has_quote);
+    }
+    return true;
+}
+
+// a number with an optional unit; durations are scaled to milliseconds
+// (seconds without a unit), bpm take no unit. unit receives the unit as
+// written.
+static bool parse_number (const std::string &str, bool duration,
+                          double *value, std::string *unit) {
+    const char *begin = str.c_str();
+    char *end;
+    double number = strtod(begin, &end);
+    if (end == begin || number < 0) {
+        return false;
+    }
+    *unit = fold(std::string(end));
+    *value = number;
+    if (!duration) {
+        return unit->empty();
+    }
+    return unit->empty() || *unit == "s" || *unit == "ms" ||
+           *unit == "m" || *unit == "min";
+}
+
+// Round a parsed bound to a whole unit. Bounds past INT32_MAX - 1 (bpm:1e30,
+// say), infinities and NaNs are rejected, so the rounded value and one past
+// it fit an int.
+static bool whole_units (double value, int *units) {
+    if (!std::isfinite(value) || value > INT32_MAX - 1) {
+        return false;
+    }
+    *units = static_cast<int>(std::lround(value));
+    return true;
+}
+
+static double unit_scale (const std::string &unit) {
+    if (unit == "ms") {
+        return 1.0;
+    }
+    if (unit == "m" || unit == "min") {
+        return 60000.0;
+    }
+    return 1000.0;
+}
+
+// N, N-M, <N, <=N, >N, >=N into an inclusive range of whole units
+static bool parse_range (const std::string &value, bool duration,
+                         int *lo, int *hi) {
+    std::string op;
+    size_t start = 0;
+    if (value.compare(0, 2, "<=") == 0 || value.compare(0, 2, ">=") == 0) {
+        op = value.substr(0, 2);
+        start = 2;
+    } else if (!value.empty() && (value[0] == '<' || value[0] == '>')) {
+        op = value.substr(0, 1);
+        start = 1;
+    }
+
+    std::string first = value.substr(start), second;
+    size_t dash = op.empty() ? first.find('-') : std::string::npos;
+    if (dash != std::string::npos) {
+        second = first.substr(dash + 1);
+        first = first.substr(0, dash);
+    }
+
+    double a, b = 0.0;
+    std::string unit_a, unit_b;
+    if (!parse_number(first, duration, &a, &unit_a)) {
+        return false;
+    }
+    if (dash != std::string::npos) {
+        if (!parse_number(second, duration, &b, &unit_b)) {
+            return false;
+        }
+        // 500-1500ms: the first bound takes the second's unit
+        if (unit_a.empty()) {
+            unit_a = unit_b;
+        }
+        b *= duration ? unit_scale(unit_b) : 1.0;
+    }
+    a *= duration ? unit_scale(unit_a) : 1.0;
+
+    int x, y = 0;
+    if (!whole_units(a, &x) || !whole_units(b, &y)) {
+        return false;
+    }
+    if (op == "<") {
+        *lo = 0;
+        *hi = x - 1;
+    } else if (op == "<=") {
+        *lo = 0;
+        *hi = x;
+    } else if (op == ">") {
+        *lo = x + 1;
+        *hi = INT32_MAX;
+    } else if (op == ">=") {
+        *lo = x;
+        *hi = INT32_MAX;
+    } else if (dash != std::string::npos) {
+        *lo = x;
+        *hi = y;
+    } else {
+        *lo = *hi = x;
+    }
+    return *lo <= *hi;
+}
+
+// Note name with an optional sharp or flat, then m/min/minor or
+// maj/major. Key numbers are major keys (see MidiMap::int_to_key); a minor
+// key is its relative major, a minor third up.
+static bool parse_key (const std::string &value, int *key) {
+    static const int pitch[7] = {9, 11, 0, 2, 4, 5, 7}; // a .. g
+    std::string str = fold(value);
+    if (str.empty() || str[0] < 'a' || str[0] > 'g') {
+        return false;
+    }
+    int pitch_class = pitch[str[0] - 'a'];
+    size_t i = 1;
+    if (i < str.size() && (str[i] == '#' || str[i] == 'b')) {
+        pitch_class += (str[i] == '#') ? 1 : -1;
+        i++;
+    }
+    std::string mode = str.substr(i);
+    if (mode == "m" || mode == "min" || mode == "minor") {
+        pitch_class += 3;
+    } else if (!mode.empty() && mode != "maj" && mode != "major") {
+        return false;
+    }
+    *key = (pitch_class + 12) % 12;
+    return true;
+}
+
+static bool field_kind (const std::string &field, QueryTermKind *kind) {
+    static const struct { const char *name; QueryTermKind kind; } fields[] = {
+        {"tag", TERM_TAG}, {"key", TERM_KEY}, {"bpm", TERM_BPM},
+        {"dur", TERM_DURATION}, {"path", TERM_PATH},
+    };
+    for (const auto &f : fields) {
+        if (field == f.name) {
+            *kind = f.kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_query (const std::string &query, struct ParsedQuery *parsed,
+                  std::string *error) {
+    std::vector<std::string> words;
+    std::vector<bool> quoted;
+    parsed->terms.clear();
+    if (!split_words(query, &words, &quoted, error)) {
+        return false;
+    }
+
+    for (size_t w = 0; w < words.size(); w++) {
+        struct QueryTerm term;
+        term.source = words[w];
+        std::string word = words[w];
+        if (word.size() > 1 && word[0] == '-') {
+            term.negated = true;
+            word = word.substr(1);
+        }
+
+        // field:value, unless the field is unknown or the colon was quoted
+        term.kind = TERM_TEXT;
+        size_t colon = word.find(':');
+        std::string value = word;
+        if (colon != std::string::npos &&
+            field_kind(fold(word.substr(0, colon)), &term.kind)) {
+            value = word.substr(colon + 1);
+            if (value.empty()) {
+                *error = "missing value in " + term.source;
+                return false;
+            }
+        }
+
+        bool valid = true;
+        switch (term.kind) {
+        case TERM_TEXT:
+        case TERM_TAG:
+            term.text = fold(value);
+            break;
+        case TERM_PATH:
+            // either separator matches either separator
+            term.text = fold(value);
+            std::replace(term.text.begin(), term.text.end(), '\\', '/');
+            break;
+        case TERM_KEY:
+            valid = parse_key(value, &term.lo);
+            term.hi = term.lo;
+            break;
+        case TERM_BPM:
+            if (value[0] == '~') {
+                term.half_double = true;
+                value = value.substr(1);
+            }
+            valid = parse_range(value, false, &term.lo, &term.hi);
+            break;
+        case TERM_DURATION:
+            valid = parse_range(value, true, &term.lo, &term.hi);
+            break;
+        }
+        if (!valid) {
+            *error = "bad value in " + term.source;
+            return false;
+        }
+        if (!term.text.empty() || term.kind != TERM_TEXT) {
+            parsed->terms.push_back(term);
+        }
+    }
+    return true;
+}
+
+bool is_structured_query (const std::string &query) {
+    struct ParsedQuery parsed;
+    std::string error;
+    if (!parse_query(query, &parsed, &error)) {
+        return true;
+    }
+    if (query.find('"') != std::string::npos) {
+        return true;
+    }
+    for (const struct QueryTerm &term : parsed.terms) {
+        if (term.kind != TERM_TEXT || term.negated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char *access_name (PlanAccess access) {
+    switch (access) {
+    case ACCESS_ALL_ROWS:      return "all rows";
+    case ACCESS_TAG_POSTINGS:  return "tag postings";
+    case ACCESS_TRIGRAMS:      return "trigram index";
+    case ACCESS_COLUMN_SCAN:   return "column scan";
+    case ACCESS_COLUMN_FILTER: return "column filter";
+    case ACCESS_TAG_PROBE:     return "tag probe";
+    case ACCESS_NAME_FILTER:   return "name filter";
+    case ACCESS_PATH_FILTER:   return "path filter";
+    }
+    return "?";
+}
+
+std::string explain_plan (const struct ParsedQuery &parsed,
+                          const struct QueryPlan &plan) {
+    char line[256];
+    std::string out;
+    snprintf(line, sizeof(line), "plan over %zu rows\n", plan.catalog_rows);
+    out += line;
+    snprintf(line, sizeof(line), "  %-3s %-24s %-14s %10s %10s %10s %9s\n",
+             "#", "term", "access", "estimate", "rows in", "rows out", "ms");
+    out += line;
+    for (size_t i = 0; i < plan.stages.size(); i++) {
+        const struct PlanStage &stage = plan.stages[i];
+        std::string term = (stage.term >= 0) ?
+                           parsed.terms[stage.term].source : "-";
+        snprintf(line, sizeof(line),
+                 "  %-3zu %-24s %-14s %10zu %10zu %10zu %9.3f\n",
+                 i + 1, term.c_str(), access_name(stage.access),
+                 stage.estimate, stage.rows_in, stage.rows_out,
+                 stage.milliseconds);
+        out += line;
+    }
+    size_t result = plan.stages.empty() ? 0 : plan.stages.back().rows_out;
+    snprintf(line, sizeof(line), "result: %zu rows\n", result);
+    out += line;
+    return out;
+}
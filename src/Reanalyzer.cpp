@@ -0,0 +1,90 @@
+#include "..\inc\Reanalyzer.h"
+
+void ReanalysisStop::request (void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        flag = true;
+    }
+    cv.notify_all();
+}
+
+bool ReanalysisStop::requested (void) const {
+    return flag.load();
+}
+
+bool ReanalysisStop::wait_for (std::chrono::steady_clock::duration duration) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return cv.wait_for(lock, duration, [this]() { return flag.load(); });
+}
+
+// re-analyze stale files a batch at a time
+// The cursor is the last row id selected, not the last one updated, so files
+// that fail to decode are passed over instead of being selected forever.
+int reanalyze_stale_files (Database *db, SimilarityIndex *index,
+                           Catalog *catalog,
+                           const ReanalysisOptions &options,
+                           ReanalysisStop *stop) {
+    
+    int batch_size = std::max(1, options.batch_size);
+    int64_t cursor = 0;
+    int updated = 0;
+
+    auto stopped = [stop]() { return stop && stop->requested(); };
+    while (!stopped()) {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::pair<int64_t, std::string>> stale = 
+            db->select_stale_files(cursor, batch_size);
+        if (stale.empty()) {
+            break;
+        }
+        cursor = stale.back().first;
+
+        // analyze the batch
+        std::vector<struct FileRecord> records(stale.size());
+        std::vector<char> decoded(stale.size(), 0);
+        TaskGroup group(PRIORITY_REANALYSIS);
+        for (size_t i = 0; i < stale.size() && !stopped(); i++) {
+            // wait for the file's decode footprint to fit in the budget
+            struct DecodePlan plan = plan_decode(stale[i].second);
+            auto reservation = std::make_shared<MemoryReservation>(
+                decode_budget(), plan.footprint);
+            group.run([&stale, &records, &decoded, &stopped, plan,
+                       reservation, i]() {
+                // files still queued when stop is requested are skipped
+                if (!stopped()) {
+                    decoded[i] = extract_audio_features(stale[i].second, plan,
+                                                        &records[i]);
+                }
+                reservation->release();
+            });
+        }
+        group.wait();
+
+        // write the batch back in one transaction
+        std::vector<std::pair<int64_t, const struct FileRecord*>> results;
+        for (size_t i = 0; i < stale.size(); i++) {
+            if (decoded[i]) {
+                results.emplace_back(stale[i].first, &records[i]);
+            }
+        }
+        if (!results.empty()) {
+            db->update_analysis(results, index, catalog);
+            updated += static_cast<int>(results.size());
+        }
+
+        // throttle: hold each batch to at least batch / rate seconds
+        if (options.max_files_per_second > 0) {
+            auto budget = std::chrono::milliseconds(
+                1000LL * static_cast<long long>(stale.size()) / 
+                options.max_files_per_second);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed < budget && stop) {
+                stop->wait_for(budget - elapsed);
+            } else if (elapsed < budget) {
+                std::this_thread::sleep_for(budget - elapsed);
+            }
+        }
+    }
+    return updated;
+}
@@ -0,0 +1,77 @@
+#include "..\inc\RecordBatch.h"
+
+static bool is_separator (char c) {
+    return c == '/' || c == '\\';
+}
+
+// length of the directory part of a path whose last element is name, as
+// fs::path::parent_path would split it: trailing separators are dropped
+// unless they are the root's
+static size_t directory_length (const std::string &path, size_t name_size) {
+    size_t root = (path.size() >= 2 && path[1] == ':') ? 2 : 0;
+    if (root < path.size() && is_separator(path[root])) {
+        root++;
+    }
+    size_t end = (path.size() >= name_size) ? path.size() - name_size : 0;
+    while (end > root && is_separator(path[end - 1])) {
+        end--;
+    }
+    return end;
+}
+
+ArenaSpan RecordBatch::append (const void *data, size_t bytes, size_t align) {
+    size_t offset = (arena.size() + align - 1) / align * align;
+    arena.resize(offset + bytes);
+    if (bytes > 0) {
+        memcpy(arena.data() + offset, data, bytes);
+    }
+    ArenaSpan span;
+    span.offset = static_cast<uint32_t>(offset);
+    span.length = static_cast<uint32_t>(bytes);
+    return span;
+}
+
+void RecordBatch::add (const struct FileRecord &file) {
+    PackedRecord record;
+    size_t dir_size = directory_length(file.file_path, file.file_name.size());
+    record.dir = append(file.file_path.data(), dir_size);
+    record.file_name = append(file.file_name.data(), file.file_name.size());
+    record.auto_tags = append(file.auto_tags.data(), file.auto_tags.size());
+    record.user_tags = append(file.user_tags.data(), file.user_tags.size());
+    record.timbre = append(file.timbre.data(),
+                           file.timbre.size() * sizeof(float), sizeof(float));
+
+    // levels are written back to back, each bin count followed by its peaks
+    size_t start = arena.size();
+    for (const WaveformLevel &level : file.overview) {
+        int32_t bins = level.bins;
+        append(&bins, sizeof(bins));
+        append(level.peaks.data(), level.peaks.size());
+    }
+    record.overview.offset = static_cast<uint32_t>(start);
+    record.overview.length = static_cast<uint32_t>(arena.size() - start);
+    record.overview_levels = static_cast<int32_t>(file.overview.size());
+
+    record.file_size = file.file_size;
+    record.duration = file.duration;
+    record.num_user_tags = file.num_user_tags;
+    record.num_auto_tags = file.num_auto_tags;
+    record.user_bpm = file.user_bpm;
+    record.user_key = file.user_key;
+    record.auto_bpm = file.auto_bpm;
+    record.auto_key = file.auto_key;
+    records.push_back(record);
+}
+
+void RecordBatch::clear (void) {
+    records.clear();
+    arena.clear();
+}
+
+int RecordBatch::effective_key (const PackedRecord &record) {
+    return (record.user_key > 0) ? record.user_key - 1 : record.auto_key;
+}
+
+int RecordBatch::effective_bpm (const PackedRecord &record) {
+    return (record.user_bpm > 0) ? record.user_bpm : record.auto_bpm;
+}
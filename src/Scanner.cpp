@@ -13,93 +13,95 @@ constexpr inline bool char_is_delimiter (char ch) {
 }
 
 // to_lower converts characters to their lowercase equivalent.
-// This function is used to convert tags to lowercase in generate_auto_tags()
+// This function is used to convert tags to lowercase in write_auto_tags()
 constexpr inline char to_lower (char c) {
     return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
 }
 
-// generate_auto_tags generates tags from filename based on a set of delimiters
+// write_auto_tags generates tags from filename based on a set of delimiters
 // the delimiters are set in char_is_delimiter()
 // tags must be 3 characters or greater
-// tags are returned in a vector of strings
-std::vector<std::string> generate_auto_tags(const std::string& file_name) {
+// tags are written to tags as one space delimited string, reusing its
+// buffer, and the number of tags is returned
+int write_auto_tags (const std::string& file_name, std::string *tags) {
     
-    std::vector<std::string> tags;
-    std::string token;
-    
-    // for all the characters in the filename:
-    // nondelimiter characters are accumualted in 'token'
-    // when a delimiter is hit, save token if long enough
+    tags->clear();
+    int num_tags = 0;
+    bool in_token = false;
+    size_t token_start = 0;
+
+    // keep the token that ends here if long enough, otherwise drop it
+    // along with the space in front of it
+    auto end_token = [&]() {
+        // tags must be 3 or more characters
+        if (tags->size() - token_start > 2) {
+            num_tags++;
+        } else {
+            tags->resize((token_start > 0) ? token_start - 1 : 0);
+        }
+        in_token = false;
+    };
 
+    // for all the characters in the filename:
+    // nondelimiter characters are accumualted at the end of tags
+    // when a delimiter is hit, the token ends
     for (char ch : file_name) {
         if (!char_is_delimiter(ch)) [[likely]] {
+            if (!in_token) {
+                if (!tags->empty()) {
+                    tags->push_back(' ');
+                }
+                token_start = tags->size();
+                in_token = true;
+            }
             // tags are lowercase
-            token += to_lower(ch);
-            continue;
+            tags->push_back(to_lower(ch));
         }
-        else if (!token.empty()) [[unlikely]] {
-            // tags must be 3 or more characters
-            if(token.size() > 2) {
-                tags.push_back(token);
-            }
-            token.clear();
+        else if (in_token) [[unlikely]] {
+            end_token();
         }
     }
 
-    // push the reminaing token, if one
-    if (!token.empty() && token.size() > 2) {
-        tags.push_back(token);
-    }
-    
-    return tags;
-}
-
-// concatenate strings in a vector of strings into one space delimited string
-std::string concatenate_tags(const std::vector<std::string>& tags) {
-    std::string result;
-    for (const auto& tag : tags) {
-        if (!result.empty()) [[likely]] {
-            result += " ";
-        }
-        result += tag;
+    // end the remaining token, if one
+    if (in_token) {
+        end_token();
     }
-    return result;
+    return num_tags;
 }
 
-// given a directory entry, find and record attributes in FileRecord struct
-struct FileRecord *process_file (sqlite3 *db, 
-                                    const fs::directory_entry& file) {
-    
-    // allocate memory for entry parameters
-    struct FileRecord *db_entry = new struct FileRecord;
+// given a directory entry, find and record attributes in a FileRecord
+// The record is the caller's scratch record; its strings keep their buffers
+// from file to file.
+void process_file (Database *db, const fs::directory_entry& file,
+                   const struct DecodePlan &plan, struct FileRecord *record) {
 
     // identification
-    db_entry->file_path = file.path().string();
-    db_entry->file_name = file.path().filename().string();
-    db_entry->file_size = fs::file_size(file.path());
+    const fs::path &path = file.path();
+    record->file_path = path.string();
+    record->file_name = path.filename().string();
+    record->file_size = fs::file_size(path);
     
     // calculate file duration
-    db_entry->duration = 0;
+    record->duration = 0;
     
     // default user tags
-    db_entry->num_user_tags = 0;
-    db_entry->user_tags = "";
+    record->num_user_tags = 0;
+    record->user_tags.clear();
     
     // generate auto tags
-    std::vector<std::string> tags = generate_auto_tags(db_entry->file_name);
-    db_entry->num_auto_tags = tags.size();
-    db_entry->auto_tags = concatenate_tags(tags);
+    record->num_auto_tags = write_auto_tags(record->file_name, 
+                                            &record->auto_tags);
     
     // default user bpm and key
-    db_entry->user_bpm = 0;
-    db_entry->user_key = 0;
+    record->user_bpm = 0;
+    record->user_key = 0;
     
-    // TODO: predict bpm and key
-    db_entry->auto_bpm = 0;
-    std::string path = file.path().string();
-    db_entry->auto_key = kdet_detect_key(path);
-
-    return db_entry;
+    // TODO: predict bpm
+    // key, duration and timbre come from a single decode of the file; the
+    // scan runs before the UI starts, so it can report progress on stderr
+    record->auto_bpm = 0;
+    fprintf(stderr, "\r%s", record->file_path.c_str());
+    extract_audio_features(record->file_path, plan, record);
 }
 
 // check if file extension is .mp3 or .wav
@@ -129,10 +131,12 @@ std::vector<fs::path> find_sub_dirs (const fs::path& root_path) {
 }
 
 // Check if file meets the requirements to be analyzed and included in the db
-// Files must exist, be a regular file, and have a .mp3 or .wav extension.
-bool requires_processing (sqlite3* db, const fs::directory_entry *file) {
+// Files must exist, be a regular file, have a .mp3 or .wav extension, and not
+// be among known, the names of the directory's files already in the db.
+bool requires_processing (const std::unordered_set<std::string> &known, 
+                          const fs::directory_entry *file) {
     if (file->is_regular_file() && validate_file_extension(file) && 
-            !db_entry_exists(db, "audio_files", file->path().string()))[[unlikely]]{
+            !known.count(file->path().filename().string()))[[unlikely]]{
         return true;
     
     } else {
@@ -140,69 +144,164 @@ bool requires_processing (sqlite3* db, const fs::directory_entry *file) {
     }
 }
 
-void queue_files (sqlite3 *db, const fs::path &dir_path, 
+// Walk a directory tree depth first on the calling thread. The walk is
+// bound by the file system, not the cpu, and pushing into the bounded
+// process queue may wait, so it doesn't run on the task scheduler.
+void queue_files (Database *db, const fs::path &dir_path, 
                 ThreadSafeQueue<fs::directory_entry> *proc_queue) {
     
-    std::vector<std::thread> threads;            
+    std::vector<fs::path> sub_dirs;
+
+    // look up the directory's cataloged files once, keyed the same way the
+    // insert stage splits file paths
+    std::unordered_set<std::string> known = 
+        db->directory_file_names((dir_path / "x").parent_path().string());
     
     for (const auto& entry : fs::directory_iterator(dir_path)) {
-        if(requires_processing(db, &entry)) {
+        if(requires_processing(known, &entry)) {
             proc_queue->push(entry);
         } 
         else if (entry.is_directory()) {
-            threads.emplace_back(&queue_files, db, entry, proc_queue);
+            sub_dirs.push_back(entry.path());
         }
     }
 
-    // join all threads
-    for (auto& t : threads) {
-        if (t.joinable()) {
-            t.join();
-        }
+    for (const fs::path &sub_dir : sub_dirs) {
+        queue_files(db, sub_dir, proc_queue);
     }
 }
 
-void queue_all_files (sqlite3 *db, const fs::path &dir_path, 
+void queue_all_files (Database *db, const fs::path &dir_path, 
                 ThreadSafeQueue<fs::directory_entry> *proc_queue ) {
     queue_files(db, dir_path, proc_queue);
-    proc_queue->stop_producing();
+    proc_queue->close();
 }
 
-void process_and_queue (sqlite3 *db, fs::directory_entry file, 
-    ThreadSafeQueue<struct FileRecord *> *insrt_queue) {
-    
-    struct FileRecord *procd_file = process_file(db, file);
-    insrt_queue->push(procd_file);
+// take a recycled batch, or a new one if none is free
+static RecordBatch *take_batch (ThreadSafeQueue<RecordBatch *> *free_batches) {
+    RecordBatch *batch = nullptr;
+    if (!free_batches->try_pop(batch)) {
+        batch = new RecordBatch;
+    }
+    return batch;
 }
 
-void process_queued_files (sqlite3 *db, 
+// The process stage takes files a batch at a time and analyzes the batch
+// in parallel on the task scheduler, one task per file, helping with the
+// tasks while it waits for them. Each task fills one of a set of scratch
+// records; the records are then packed into a RecordBatch, which goes to
+// the insert stage in one push.
+// A file's task is only submitted once its decode footprint fits in the
+// decode budget, so the stage waits here while earlier files hold it.
+void process_queued_files (Database *db, 
         ThreadSafeQueue<fs::directory_entry> *proc_queue,
-        ThreadSafeQueue<struct FileRecord *> *insrt_queue) {
-
-    while (!proc_queue->empty() || proc_queue->is_producing()) {
-        
-        fs::directory_entry file;
-        proc_queue->try_pop(file);
-        
-        if (!file.path().empty()) {
-            struct FileRecord *procd_file = process_file(db, file);
-            insrt_queue->push(procd_file);
+        ThreadSafeQueue<RecordBatch *> *insrt_queue,
+        ThreadSafeQueue<RecordBatch *> *free_batches) {
+
+    const size_t batch_size = SCAN_FILES_PER_THREAD * 
+                              TaskScheduler::instance().num_threads();
+    std::vector<fs::directory_entry> files;
+    std::vector<struct FileRecord> records(batch_size);
+
+    // pop_batch sleeps while the queue is empty and returns 0 once it is
+    // closed and drained
+    while (proc_queue->pop_batch(&files, batch_size) > 0) {
+        TaskGroup group(PRIORITY_SCAN);
+        for (size_t i = 0; i < files.size(); i++) {
+            struct DecodePlan plan = plan_decode(files[i].path().string());
+            auto reservation = std::make_shared<MemoryReservation>(
+                decode_budget(), plan.footprint);
+            group.run([db, &files, &records, plan, reservation, i]() {
+                process_file(db, files[i], plan, &records[i]);
+                reservation->release();
+            });
+        }
+        group.wait();
+
+        RecordBatch *batch = take_batch(free_batches);
+        for (size_t i = 0; i < files.size(); i++) {
+            batch->add(records[i]);
         }
+        insrt_queue->push(batch);
+        files.clear();
     }
 
-    insrt_queue->stop_producing();
+    insrt_queue->close();
 }
 
-void insert_processed_files (sqlite3* db, 
-    ThreadSafeQueue<struct FileRecord *> *insrt_queue) {
+// commit the records of a set of batches, then clear the batches and hand
+// them back to the process stage
+// returns how long the commit took
+static std::chrono::milliseconds commit_batch (Database *db, 
+    std::vector<RecordBatch *> &batches, SimilarityIndex *index, 
+    Catalog *catalog, ThreadSafeQueue<RecordBatch *> *free_batches) {
     
-    while (insrt_queue->is_producing()) {
-        if(insrt_queue->size() >= TRANSACTION_SIZE) {
-            db_insert_files(db, insrt_queue);
+    auto start = std::chrono::steady_clock::now();
+    db->insert_files(batches, index, catalog);
+    auto end = std::chrono::steady_clock::now();
+
+    for (RecordBatch *batch : batches) {
+        batch->clear();
+        if (!free_batches->try_push(batch)) {
+            delete batch;
         }
     }
-    while (!insrt_queue->empty()) {
-        db_insert_files(db, insrt_queue);
+    batches.clear();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+}
+
+// group committer for the insert stage
+// With nothing pending the committer sleeps on the queue. Once a record is
+// pending, it waits for more until the batch is full or the oldest pending
+// record has waited COMMIT_MAX_LATENCY_MS, whichever comes first. After each
+// commit the batch size is doubled if the commit was cheap and halved if it
+// overran COMMIT_TARGET_MS. The batch size counts records, not the
+// RecordBatches they arrive in.
+void insert_processed_files (Database *db, 
+    ThreadSafeQueue<RecordBatch *> *insrt_queue, 
+    ThreadSafeQueue<RecordBatch *> *free_batches, SimilarityIndex *index,
+    Catalog *catalog) {
+    
+    const auto max_latency = std::chrono::milliseconds(COMMIT_MAX_LATENCY_MS);
+    const auto target = std::chrono::milliseconds(COMMIT_TARGET_MS);
+
+    std::vector<RecordBatch *> pending;
+    size_t pending_records = 0;
+    size_t batch_size = COMMIT_MIN_BATCH;
+    std::chrono::steady_clock::time_point deadline;
+
+    while (true) {
+        // take one RecordBatch at a time: a RecordBatch can hold many
+        // records, so the batch size is only overshot by the last one
+        size_t popped = pending.empty() ? 
+            insrt_queue->pop_batch(&pending, 1) :
+            insrt_queue->pop_batch_until(&pending, 1, deadline);
+
+        if (popped > 0) {
+            if (pending.size() == 1) {
+                deadline = std::chrono::steady_clock::now() + max_latency;
+            }
+            pending_records += pending.back()->size();
+        } else if (pending.empty()) {
+            // closed and fully drained
+            break;
+        }
+
+        // commit on a full batch, on the deadline, or when input has ended
+        if (pending_records < batch_size && popped > 0 &&
+            std::chrono::steady_clock::now() < deadline) {
+            continue;
+        }
+        size_t committed = pending_records;
+        auto cost = commit_batch(db, pending, index, catalog, free_batches);
+        pending_records = 0;
+
+        // adapt the batch size to the observed commit cost
+        if (cost > target) {
+            batch_size = std::max<size_t>(COMMIT_MIN_BATCH, batch_size / 2);
+        } else if (cost < target / 4 && committed >= batch_size) {
+            batch_size = std::min<size_t>(COMMIT_MAX_BATCH, batch_size * 2);
+        }
     }
 }
 
@@ -214,25 +313,42 @@ void insert_processed_files (sqlite3* db,
 //    Files that require processing are queued in proc_queue.
 // 2. proc_queue -> insrt_queue
 //    process_queued_files pops files from the queue as fs::directory_entry
-//    objects, transforms them into struct FileRecord * objects, and pushes 
-//    them in the insrt_queue.
+//    objects, packs their FileRecords into RecordBatch objects, and pushes 
+//    the batches in the insrt_queue. The files themselves are analyzed by
+//    PRIORITY_SCAN tasks on the shared task scheduler, so the number of
+//    threads doesn't depend on the shape of the library.
 // 3. insrt_queue -> database
-//    insert_processed_files pops FileRecord objects off the insert queue and
-//    inserts their data as entries in the database. Insertions are broken up
-//    into transactions for faster insertion (see DBINT::db_insert_files)
-void scan_directory (sqlite3 *db, const fs::path& dir_path) {
-    
-    ThreadSafeQueue<fs::directory_entry> proc_queue;
-    proc_queue.start_producing();
+//    insert_processed_files pops RecordBatch objects off the insert queue
+//    and inserts their records as entries in the database. Committed
+//    batches are cleared and go back to the process stage through
+//    free_batches, so their buffers are reused. Insertions are grouped
+//    into transactions by a latency bounded group committer (see 
+//    insert_processed_files and Database::insert_files)
+//    Each new row is added to the catalog and its timbre embedding to the
+//    similarity index.
+//
+// The first scan, into an empty catalog, runs in bulk load mode (see
+// Database::begin_bulk_load): rows are staged and merged in one pass when
+// the pipeline finishes, then the merged rows, the ones after the
+// catalog's and the index's last ids, are loaded into them. The merge also
+// runs if the scan unwinds early. Rescans insert directly, so they never
+// drop and rebuild the indexes of an existing library.
+void scan_directory (Database *db, const fs::path& dir_path, 
+                     SimilarityIndex *index, Catalog *catalog) {
+
+    BulkLoad bulk_load(*db, db->get_num_rows("audio_files") == 0);
     
-    ThreadSafeQueue<struct FileRecord *> insrt_queue;
-    insrt_queue.start_producing();
+    ThreadSafeQueue<fs::directory_entry> proc_queue(SCAN_QUEUE_CAPACITY);
+    ThreadSafeQueue<RecordBatch *> insrt_queue(SCAN_QUEUE_CAPACITY);
+    ThreadSafeQueue<RecordBatch *> free_batches(SCAN_FREE_BATCHES);
 
     std::vector<std::thread> threads;
 
     threads.emplace_back(&queue_all_files, db, dir_path, &proc_queue);
-    threads.emplace_back(&process_queued_files, db, &proc_queue, &insrt_queue);
-    threads.emplace_back(&insert_processed_files, db, &insrt_queue);
+    threads.emplace_back(&process_queued_files, db, &proc_queue, &insrt_queue,
+                         &free_batches);
+    threads.emplace_back(&insert_processed_files, db, &insrt_queue, 
+                         &free_batches, index, catalog);
 
     // Join all threads
     for (auto& t : threads) {
@@ -240,4 +356,14 @@ void scan_directory (sqlite3 *db, const fs::path& dir_path) {
             t.join();
         }
     }
+
+    RecordBatch *batch;
+    while (free_batches.try_pop(batch)) {
+        delete batch;
+    }
+
+    if (bulk_load.finish()) {
+        db->load_similarity_index(index);
+        db->load_catalog(catalog);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "..\inc\SearchExecutor.h"
+
+SearchExecutor::SearchExecutor (const Catalog *catalog, size_t num_results,
+                                SearchPublisher publisher) :
+    catalog(catalog), num_results(num_results), 
+    publisher(std::move(publisher)), session(catalog, SEARCH_FUZZY),
+    tasks(PRIORITY_INTERACTIVE) {}
+
+SearchExecutor::~SearchExecutor (void) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        has_pending = false;
+        cancel.store(true);
+    }
+    tasks.wait();
+}
+
+uint64_t SearchExecutor::submit (const std::string &query) {
+    uint64_t query_generation;
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = query;
+        has_pending = true;
+        query_generation = ++generation;
+        cancel.store(true);
+        start = !running;
+        running = true;
+    }
+    if (start) {
+        tasks.run([this]() { run(); });
+    }
+    return query_generation;
+}
+
+// Take the newest pending query and run it, until none is left. The cancel
+// flag is cleared under the mutex, so a submit after this point always
+// cancels the query taken here.
+void SearchExecutor::run (void) {
+    while (true) {
+        std::string query;
+        uint64_t query_generation;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!has_pending) {
+                running = false;
+                return;
+            }
+            query.swap(pending);
+            query_generation = generation;
+            has_pending = false;
+            cancel.store(false);
+        }
+        execute(query, query_generation);
+    }
+}
+
+void SearchExecutor::execute (const std::string &query, 
+                              uint64_t query_generation) {
+    if (is_structured_query(query)) {
+        execute_structured(query, query_generation);
+        return;
+    }
+
+    // show the best of the first chunk that fills the list right away
+    bool shown = false;
+    auto progress = [&](const std::vector<uint32_t> &rows) {
+        if (shown || rows.size() < num_results) {
+            return;
+        }
+        std::vector<FuzzyHit> best = catalog->rank_fuzzy(rows, query, 
+                                                         num_results, &cancel);
+        if (!cancel.load()) {
+            publisher(make_update(query_generation, best, rows.size(), false));
+            shown = true;
+        }
+    };
+
+    const std::vector<uint32_t> *rows = session.search(query, &cancel, 
+                                                       progress);
+    if (rows == nullptr) {
+        return;
+    }
+    std::vector<FuzzyHit> best = catalog->rank_fuzzy(*rows, query, num_results,
+                                                     &cancel);
+    if (cancel.load()) {
+        return;
+    }
+    publisher(make_update(query_generation, best, rows->size(), true));
+}
+
+// Structured queries are planned and run in one go; they read only the
+// rows their most selective term leads to, and stop once superseded. A
+// malformed query matches nothing.
+void SearchExecutor::execute_structured (const std::string &query,
+                                         uint64_t query_generation) {
+    struct ParsedQuery parsed;
+    std::string error;
+    std::vector<FuzzyHit> best;
+    size_t total = 0;
+    struct FacetCounts facets;
+    if (parse_query(query, &parsed, &error)) {
+        for (uint32_t row : catalog->run_query(parsed, num_results, &total,
+                                               nullptr, &facets, &cancel)) {
+            best.push_back(FuzzyHit{row, 0});
+        }
+    }
+    if (cancel.load()) {
+        return;
+    }
+    SearchUpdate update = make_update(query_generation, best, total, true);
+    update.facets = std::move(facets);
+    publisher(std::move(update));
+}
+
+SearchUpdate SearchExecutor::make_update (uint64_t query_generation,
+                                          const std::vector<FuzzyHit> &best,
+                                          size_t num_matches, 
+                                          bool final) const {
+    SearchUpdate update;
+    update.generation = query_generation;
+    update.hits.resize(best.size());
+    for (size_t i = 0; i < best.size(); i++) {
+        catalog->hit(best[i].row, &update.hits[i]);
+        update.hits[i].score = best[i].score;
+    }
+    update.num_matches = static_cast<int64_t>(num_matches);
+    update.final = final;
+    return update;
+}
@@ -0,0 +1,116 @@
+#include "..\inc\SearchSession.h"
+
+static std::string fold_query (const std::string &query) {
+    std::string folded;
+    for (char c : query) {
+        folded.push_back(static_cast<char>(
+            std::tolower(static_cast<unsigned char>(c))));
+    }
+    return folded;
+}
+
+SearchSession::SearchSession (const Catalog *catalog, SearchMode mode,
+                              size_t cache_size) :
+    catalog(catalog), mode(mode), cache_size(cache_size), 
+    epoch(catalog->epoch()) {}
+
+void SearchSession::clear (void) {
+    levels.clear();
+    recent.clear();
+    cached.clear();
+}
+
+bool SearchSession::catch_up (Level *level, const std::atomic<bool> *cancel,
+                              const SearchProgress &progress) {
+    while (true) {
+        if (cancel && cancel->load()) {
+            return false;
+        }
+        size_t first_row = level->rows_seen;
+        size_t end_row = 0;
+        std::vector<uint32_t> added = (mode == SEARCH_FUZZY) ?
+            catalog->fuzzy_rows(level->query, first_row, &end_row, 
+                                SEARCH_CHUNK_ROWS) :
+            catalog->rows_containing(level->query, first_row, &end_row,
+                                     SEARCH_CHUNK_ROWS);
+        level->rows.insert(level->rows.end(), added.begin(), added.end());
+        level->rows_seen = end_row;
+
+        // a short chunk reached the end of the catalog
+        if (end_row - first_row < SEARCH_CHUNK_ROWS) {
+            return true;
+        }
+        if (progress) {
+            progress(level->rows);
+        }
+    }
+}
+
+void SearchSession::touch (const LevelPtr &level) {
+    auto it = cached.find(level->query);
+    if (it != cached.end()) {
+        recent.splice(recent.begin(), recent, it->second);
+        return;
+    }
+    recent.push_front(level);
+    cached[level->query] = recent.begin();
+    if (recent.size() > cache_size) {
+        cached.erase(recent.back()->query);
+        recent.pop_back();
+    }
+}
+
+// find the results of query, from the cheapest source available:
+// the current level, the cache, a refinement of the longest cached prefix,
+// and only then a scan of the catalog
+const std::vector<uint32_t> *SearchSession::search (
+    const std::string &query, const std::atomic<bool> *cancel,
+    const SearchProgress &progress) {
+    uint64_t current_epoch = catalog->epoch();
+    if (current_epoch != epoch) {
+        clear();
+        epoch = current_epoch;
+    }
+
+    std::string folded = fold_query(query);
+
+    // backspace or an edit: drop the levels that aren't prefixes of query
+    while (!levels.empty() && 
+           folded.compare(0, levels.back()->query.size(), 
+                          levels.back()->query) != 0) {
+        levels.pop_back();
+    }
+
+    if (levels.empty() || levels.back()->query != folded) {
+        LevelPtr level;
+        auto it = cached.find(folded);
+        if (it != cached.end()) {
+            level = *it->second;
+        } else if (!levels.empty() && !levels.back()->query.empty()) {
+            // rows the refinement misses were appended after the parent's
+            // rows_seen, so catch_up below finds them
+            const Level &parent = *levels.back();
+            level = std::make_shared<Level>();
+            level->query = folded;
+            level->rows = (mode == SEARCH_FUZZY) ? 
+                          catalog->refine_fuzzy(parent.rows, folded, cancel) :
+                          catalog->refine_rows(parent.rows, folded, cancel);
+            level->rows_seen = parent.rows_seen;
+            // a cut short refinement is incomplete, unlike a cut short scan
+            if (cancel && cancel->load()) {
+                return nullptr;
+            }
+        } else {
+            level = std::make_shared<Level>();
+            level->query = folded;
+        }
+        levels.push_back(level);
+    }
+
+    Level *level = levels.back().get();
+    if (!catch_up(level, cancel, progress)) {
+        return nullptr;
+    }
+    touch(levels.back());
+    return &level->rows;
+}
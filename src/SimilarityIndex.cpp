@@ -0,0 +1,494 @@
+#include "..\inc\SimilarityIndex.h"
+
+SimilarityIndex::SimilarityIndex (int dims) :
+    dims(dims),
+    level_mult(1.0 / std::log(static_cast<double>(HNSW_MAX_LINKS))),
+    rng(0x5eed) {}
+
+inline const float *SimilarityIndex::vector_of (uint32_t node) const {
+    return &vectors[static_cast<size_t>(node) * dims];
+}
+
+// squared euclidean distance
+float SimilarityIndex::distance (const float *a, const float *b) const {
+    float sum = 0.0f;
+    for (int i = 0; i < dims; i++) {
+        float d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+std::vector<SimilarityIndex::Candidate> SimilarityIndex::search_layer (
+        const float *query, uint32_t entry, int ef, int level) const {
+
+    // visited marks are kept per thread and invalidated by bumping the
+    // generation, so a search doesn't clear or allocate a node-sized set
+    thread_local std::vector<uint32_t> visited;
+    thread_local uint32_t generation = 0;
+    if (visited.size() < ids.size()) {
+        visited.resize(ids.size() + ids.size() / 2 + 1, 0);
+    }
+    if (++generation == 0) [[unlikely]] {
+        std::fill(visited.begin(), visited.end(), 0);
+        generation = 1;
+    }
+
+    // candidates: min-heap to expand, results: max-heap of the ef best
+    std::priority_queue<Candidate, std::vector<Candidate>,
+                        std::greater<Candidate>> candidates;
+    std::priority_queue<Candidate> results;
+
+    float d = distance(query, vector_of(entry));
+    candidates.emplace(d, entry);
+    results.emplace(d, entry);
+    visited[entry] = generation;
+
+    while (!candidates.empty()) {
+        Candidate current = candidates.top();
+        if (current.first > results.top().first &&
+                static_cast<int>(results.size()) >= ef) {
+            break;
+        }
+        candidates.pop();
+
+        for (uint32_t neighbour : links[current.second][level]) {
+            if (visited[neighbour] == generation) {
+                continue;
+            }
+            visited[neighbour] = generation;
+
+            float nd = distance(query, vector_of(neighbour));
+            if (static_cast<int>(results.size()) < ef ||
+                    nd < results.top().first) {
+                candidates.emplace(nd, neighbour);
+                results.emplace(nd, neighbour);
+                if (static_cast<int>(results.size()) > ef) {
+                    results.pop();
+                }
+            }
+        }
+    }
+
+    std::vector<Candidate> sorted(results.size());
+    for (size_t i = sorted.size(); i-- > 0; ) {
+        sorted[i] = results.top();
+        results.pop();
+    }
+    return sorted;
+}
+
+std::vector<uint32_t> SimilarityIndex::select_neighbours (
+        const std::vector<Candidate> &candidates, int max_links) const {
+
+    std::vector<uint32_t> selected;
+    for (const Candidate &c : candidates) {
+        if (static_cast<int>(selected.size()) >= max_links) {
+            break;
+        }
+        bool diverse = true;
+        for (uint32_t s : selected) {
+            if (distance(vector_of(c.second), vector_of(s)) < c.first) {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse) {
+            selected.push_back(c.second);
+        }
+    }
+
+    // top up with the closest pruned candidates so sparse regions stay linked
+    for (const Candidate &c : candidates) {
+        if (static_cast<int>(selected.size()) >= max_links) {
+            break;
+        }
+        if (std::find(selected.begin(), selected.end(), c.second) ==
+                selected.end()) {
+            selected.push_back(c.second);
+        }
+    }
+    return selected;
+}
+
+// the link capacity of a layer; the base layer is twice as dense
+static inline int max_links_at (int level) {
+    return (level == 0) ? 2 * HNSW_MAX_LINKS : HNSW_MAX_LINKS;
+}
+
+// re-select a node's links on a layer from a pool of nodes
+void SimilarityIndex::reselect (uint32_t node, int level,
+                                const std::vector<uint32_t> &pool) {
+    std::vector<Candidate> candidates;
+    candidates.reserve(pool.size());
+    for (uint32_t n : pool) {
+        if (n != node) {
+            candidates.emplace_back(distance(vector_of(node), vector_of(n)), n);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    links[node][level] = select_neighbours(candidates, max_links_at(level));
+}
+
+// link a node to the best of the candidates found for it on a layer, and
+// link them back, pruning any neighbour that goes over capacity
+void SimilarityIndex::connect (uint32_t node, int level,
+                               const std::vector<Candidate> &found) {
+    links[node][level] = select_neighbours(found, HNSW_MAX_LINKS);
+    for (uint32_t neighbour : links[node][level]) {
+        std::vector<uint32_t> &back = links[neighbour][level];
+        if (std::find(back.begin(), back.end(), node) != back.end()) {
+            continue;
+        }
+        back.push_back(node);
+        if (static_cast<int>(back.size()) > max_links_at(level)) {
+            std::vector<uint32_t> pool = back;
+            reselect(neighbour, level, pool);
+        }
+    }
+}
+
+void SimilarityIndex::insert (int64_t id, const std::vector<float> &vec) {
+    insert(id, vec.data(), vec.size());
+}
+
+void SimilarityIndex::insert (int64_t id, const float *vec, size_t n) {
+    if (static_cast<int>(n) != dims) {
+        return;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    if (nodes_by_id.count(id)) {
+        return;
+    }
+
+    // draw the node's top level from an exponentially decaying distribution
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    int level = static_cast<int>(-std::log(1.0 - uniform(rng)) * level_mult);
+
+    uint32_t node = static_cast<uint32_t>(ids.size());
+    ids.push_back(id);
+    vectors.insert(vectors.end(), vec, vec + n);
+    links.emplace_back(level + 1);
+    nodes_by_id[id] = node;
+    highest_id = std::max(highest_id, id);
+    changes++;
+
+    if (max_level < 0) {
+        entry_point = node;
+        max_level = level;
+        return;
+    }
+
+    // descend greedily through the layers above the node's level
+    const float *query = vector_of(node);
+    uint32_t entry = entry_point;
+    for (int l = max_level; l > level; l--) {
+        entry = search_layer(query, entry, 1, l)[0].second;
+    }
+
+    // link the node into every layer it belongs to
+    for (int l = std::min(level, max_level); l >= 0; l--) {
+        std::vector<Candidate> found =
+            search_layer(query, entry, HNSW_EF_CONSTRUCTION, l);
+        entry = found[0].second;
+        connect(node, l, found);
+    }
+
+    if (level > max_level) {
+        entry_point = node;
+        max_level = level;
+    }
+}
+
+void SimilarityIndex::update (int64_t id, const std::vector<float> &vec) {
+    if (static_cast<int>(vec.size()) != dims) {
+        return;
+    }
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = nodes_by_id.find(id);
+        if (it != nodes_by_id.end()) {
+            std::copy(vec.begin(), vec.end(),
+                      vectors.begin() + static_cast<size_t>(it->second) * dims);
+            relink(it->second);
+            changes++;
+            return;
+        }
+    }
+    insert(id, vec);
+}
+
+// move a node whose vector changed to its new place in the graph
+void SimilarityIndex::relink (uint32_t node) {
+    int level = static_cast<int>(links[node].size()) - 1;
+
+    // unlink the node from its old neighbours, and let each one re-select
+    // from its remaining links and the node's, so the neighbourhood the
+    // node bridged stays connected. The node's own links are kept until
+    // each layer is re-searched, so a search can still pass through it.
+    for (int l = 0; l <= level; l++) {
+        std::vector<uint32_t> old = links[node][l];
+        for (uint32_t neighbour : old) {
+            std::vector<uint32_t> pool = links[neighbour][l];
+            pool.erase(std::remove(pool.begin(), pool.end(), node), pool.end());
+            pool.insert(pool.end(), old.begin(), old.end());
+            pool.erase(std::remove(pool.begin(), pool.end(), node), pool.end());
+            reselect(neighbour, l, pool);
+        }
+    }
+
+    // search for the new neighbours as an insert would, skipping the node
+    const float *query = vector_of(node);
+    uint32_t entry = entry_point;
+    for (int l = max_level; l > level; l--) {
+        entry = search_layer(query, entry, 1, l)[0].second;
+    }
+    for (int l = level; l >= 0; l--) {
+        std::vector<Candidate> found =
+            search_layer(query, entry, HNSW_EF_CONSTRUCTION, l);
+        entry = found[0].second;
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [node] (const Candidate &c) {
+                                       return c.second == node;
+                                   }),
+                    found.end());
+        connect(node, l, found);
+    }
+}
+
+SimilarityResults SimilarityIndex::search_locked (const float *query, int k,
+                                                  int64_t exclude) const {
+    SimilarityResults results;
+    if (max_level < 0 || k <= 0) {
+        return results;
+    }
+
+    uint32_t entry = entry_point;
+    for (int l = max_level; l > 0; l--) {
+        entry = search_layer(query, entry, 1, l)[0].second;
+    }
+
+    int ef = std::max(HNSW_EF_SEARCH, k + 1);
+    for (const Candidate &c : search_layer(query, entry, ef, 0)) {
+        if (ids[c.second] == exclude) {
+            continue;
+        }
+        results.emplace_back(ids[c.second], c.first);
+        if (static_cast<int>(results.size()) == k) {
+            break;
+        }
+    }
+    return results;
+}
+
+SimilarityResults SimilarityIndex::search (const std::vector<float> &query,
+                                           int k) const {
+    if (static_cast<int>(query.size()) != dims) {
+        return SimilarityResults();
+    }
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return search_locked(query.data(), k, -1);
+}
+
+SimilarityResults SimilarityIndex::search_by_id (int64_t id, int k) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = nodes_by_id.find(id);
+    if (it == nodes_by_id.end()) {
+        return SimilarityResults();
+    }
+    return search_locked(vector_of(it->second), k, id);
+}
+
+bool SimilarityIndex::get (int64_t id, std::vector<float> *vec) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = nodes_by_id.find(id);
+    if (it == nodes_by_id.end()) {
+        return false;
+    }
+    const float *v = vector_of(it->second);
+    vec->assign(v, v + dims);
+    return true;
+}
+
+bool SimilarityIndex::contains (int64_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return nodes_by_id.count(id) > 0;
+}
+
+size_t SimilarityIndex::size (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return ids.size();
+}
+
+int64_t SimilarityIndex::last_id (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return highest_id;
+}
+
+uint64_t SimilarityIndex::revision (void) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return changes;
+}
+
+struct GraphHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dims;
+    uint32_t nodes;
+    uint32_t entry_point;
+    int32_t max_level;
+};
+
+template <typename T>
+static void append_values (std::vector<uint8_t> *out, const T *values,
+                           size_t n) {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(values);
+    out->insert(out->end(), bytes, bytes + n * sizeof(T));
+}
+
+// GraphReader copies values out of a serialized graph, failing instead of
+// reading past its end
+class GraphReader {
+public:
+    GraphReader (const uint8_t *data, size_t bytes) : 
+        data(data), bytes(bytes) {}
+
+    // are n more values of type T left
+    template <typename T>
+    bool has (size_t n) const {
+        return n <= (bytes - pos) / sizeof(T);
+    }
+
+    template <typename T>
+    bool read (T *values, size_t n) {
+        if (!has<T>(n)) {
+            return false;
+        }
+        memcpy(values, data + pos, n * sizeof(T));
+        pos += n * sizeof(T);
+        return true;
+    }
+
+    inline bool done (void) const { return pos == bytes; }
+
+private:
+    const uint8_t *data;
+    size_t bytes;
+    size_t pos = 0;
+};
+
+void SimilarityIndex::serialize (std::vector<uint8_t> *out) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    struct GraphHeader header;
+    header.magic = HNSW_FORMAT_MAGIC;
+    header.version = HNSW_FORMAT_VERSION;
+    header.dims = static_cast<uint32_t>(dims);
+    header.nodes = static_cast<uint32_t>(ids.size());
+    header.entry_point = entry_point;
+    header.max_level = max_level;
+    append_values(out, &header, 1);
+
+    std::vector<uint8_t> levels(ids.size());
+    size_t num_links = 0;
+    for (size_t node = 0; node < ids.size(); node++) {
+        levels[node] = static_cast<uint8_t>(links[node].size() - 1);
+        for (const std::vector<uint32_t> &level : links[node]) {
+            num_links += 1 + level.size();
+        }
+    }
+    out->reserve(out->size() + ids.size() * sizeof(int64_t) + levels.size() +
+                 vectors.size() * sizeof(float) + 
+                 num_links * sizeof(uint32_t));
+    append_values(out, ids.data(), ids.size());
+    append_values(out, levels.data(), levels.size());
+    append_values(out, vectors.data(), vectors.size());
+    for (const auto &node_links : links) {
+        for (const std::vector<uint32_t> &level : node_links) {
+            uint32_t count = static_cast<uint32_t>(level.size());
+            append_values(out, &count, 1);
+            append_values(out, level.data(), level.size());
+        }
+    }
+}
+
+// Every link must name a node that exists on the link's level, or a search
+// would index past that node's levels, so links are checked against the
+// node levels before anything is replaced.
+bool SimilarityIndex::deserialize (const uint8_t *data, size_t bytes) {
+    GraphReader in(data, bytes);
+    struct GraphHeader header;
+    if (!in.read(&header, 1) || header.magic != HNSW_FORMAT_MAGIC ||
+        header.version != HNSW_FORMAT_VERSION ||
+        header.dims != static_cast<uint32_t>(dims)) {
+        return false;
+    }
+    const size_t n = header.nodes;
+    if (!in.has<int64_t>(n)) {
+        return false;
+    }
+    std::vector<int64_t> new_ids(n);
+    std::vector<uint8_t> levels(n);
+    if (!in.read(new_ids.data(), n) || !in.read(levels.data(), n) ||
+        !in.has<float>(n * dims)) {
+        return false;
+    }
+    std::vector<float> new_vectors(n * dims);
+    if (!in.read(new_vectors.data(), new_vectors.size())) {
+        return false;
+    }
+
+    std::vector<std::vector<std::vector<uint32_t>>> new_links(n);
+    for (size_t node = 0; node < n; node++) {
+        if (levels[node] > HNSW_MAX_LEVEL) {
+            return false;
+        }
+        new_links[node].resize(levels[node] + 1);
+        for (int l = 0; l <= levels[node]; l++) {
+            uint32_t count;
+            uint32_t max_links = (l == 0) ? 2 * HNSW_MAX_LINKS : HNSW_MAX_LINKS;
+            if (!in.read(&count, 1) || count > max_links) {
+                return false;
+            }
+            std::vector<uint32_t> &level = new_links[node][l];
+            level.resize(count);
+            if (!in.read(level.data(), count)) {
+                return false;
+            }
+            for (uint32_t link : level) {
+                if (link >= n || levels[link] < l) {
+                    return false;
+                }
+            }
+        }
+    }
+    if (!in.done() || (n == 0 && header.max_level != -1) ||
+        (n > 0 && (header.entry_point >= n || 
+                   header.max_level != levels[header.entry_point]))) {
+        return false;
+    }
+
+    std::unordered_map<int64_t, uint32_t> new_nodes;
+    new_nodes.reserve(n);
+    int64_t new_highest = 0;
+    for (size_t node = 0; node < n; node++) {
+        if (!new_nodes.emplace(new_ids[node], 
+                               static_cast<uint32_t>(node)).second) {
+            return false;
+        }
+        new_highest = std::max(new_highest, new_ids[node]);
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    ids.swap(new_ids);
+    vectors.swap(new_vectors);
+    links.swap(new_links);
+    nodes_by_id.swap(new_nodes);
+    entry_point = header.entry_point;
+    max_level = header.max_level;
+    highest_id = new_highest;
+    changes++;
+    return true;
+}
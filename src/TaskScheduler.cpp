@@ -0,0 +1,204 @@
+#include "..\inc\TaskScheduler.h"
+
+// the scheduler and worker the calling thread belongs to, and the priority
+// of the task it is running
+static thread_local TaskScheduler *this_scheduler = nullptr;
+static thread_local int this_worker = -1;
+static thread_local int this_priority = -1;
+
+TaskScheduler::TaskScheduler (size_t num_threads) {
+    num_threads = std::max<size_t>(num_threads, 1);
+    for (int p = 0; p < TASK_PRIORITIES; p++) {
+        queued[p].store(0);
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        workers.emplace_back(new Worker);
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back(&TaskScheduler::worker_loop, this,
+                             static_cast<int>(i));
+    }
+}
+
+// queued tasks that haven't started are dropped
+TaskScheduler::~TaskScheduler (void) {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+TaskScheduler &TaskScheduler::instance (void) {
+    static TaskScheduler scheduler(std::thread::hardware_concurrency());
+    return scheduler;
+}
+
+size_t TaskScheduler::num_threads (void) const {
+    return threads.size();
+}
+
+TaskPriority TaskScheduler::current_priority (TaskPriority fallback) {
+    return (this_priority >= 0) ? static_cast<TaskPriority>(this_priority)
+                                : fallback;
+}
+
+int TaskScheduler::worker_index (void) const {
+    return (this_scheduler == this) ? this_worker : -1;
+}
+
+void TaskScheduler::submit (TaskPriority priority, Task task) {
+    int index = worker_index();
+    if (index >= 0) {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks[priority].push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(shared_mutex);
+        shared[priority].push_back(std::move(task));
+    }
+    queued[priority].fetch_add(1);
+    wake_sleepers();
+}
+
+bool TaskScheduler::has_work (int max_priority) const {
+    for (int p = 0; p <= max_priority; p++) {
+        if (queued[p].load() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The fence pairs with the sleeper's: either the waker sees the sleeper
+// count, or the sleeper sees the new task or finished group before it
+// sleeps.
+void TaskScheduler::wake_sleepers (void) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        wake.notify_all();
+    }
+}
+
+bool TaskScheduler::take (int index, int max_priority, Task *task,
+                          TaskPriority *priority) {
+    const int num_workers = static_cast<int>(workers.size());
+    for (int p = 0; p <= max_priority; p++) {
+        if (queued[p].load() == 0) {
+            continue;
+        }
+        *priority = static_cast<TaskPriority>(p);
+
+        // own tasks newest first, while their data is still in cache
+        if (index >= 0) {
+            Worker &own = *workers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks[p].empty()) {
+                *task = std::move(own.tasks[p].back());
+                own.tasks[p].pop_back();
+                queued[p].fetch_sub(1);
+                return true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(shared_mutex);
+            if (!shared[p].empty()) {
+                *task = std::move(shared[p].front());
+                shared[p].pop_front();
+                queued[p].fetch_sub(1);
+                return true;
+            }
+        }
+        // steal the oldest, which tends to be the largest piece of work
+        for (int k = 1; k <= num_workers; k++) {
+            int victim = (std::max(index, 0) + k) % num_workers;
+            if (victim == index) {
+                continue;
+            }
+            Worker &other = *workers[victim];
+            std::lock_guard<std::mutex> lock(other.mutex);
+            if (!other.tasks[p].empty()) {
+                *task = std::move(other.tasks[p].front());
+                other.tasks[p].pop_front();
+                queued[p].fetch_sub(1);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool TaskScheduler::run_one (int max_priority) {
+    Task task;
+    TaskPriority priority;
+    if (!take(worker_index(), max_priority, &task, &priority)) {
+        return false;
+    }
+    int outer = this_priority;
+    this_priority = priority;
+    task();
+    this_priority = outer;
+    return true;
+}
+
+void TaskScheduler::worker_loop (int index) {
+    this_scheduler = this;
+    this_worker = index;
+    while (true) {
+        if (run_one(TASK_PRIORITIES - 1)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake.wait(lock, [this]() {
+            return stopping || has_work(TASK_PRIORITIES - 1);
+        });
+        sleepers.fetch_sub(1);
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+TaskGroup::TaskGroup (TaskPriority priority, TaskScheduler &scheduler) :
+    scheduler(scheduler), priority(priority),
+    pending(std::make_shared<std::atomic<size_t>>(0)) {}
+
+TaskGroup::~TaskGroup (void) {
+    wait();
+}
+
+// the counter is shared with the tasks, so the last one can finish after
+// the group is gone
+void TaskGroup::run (Task task) {
+    pending->fetch_add(1);
+    std::shared_ptr<std::atomic<size_t>> counter = pending;
+    TaskScheduler *owner = &scheduler;
+    scheduler.submit(priority, [task = std::move(task), counter, owner]() {
+        task();
+        if (counter->fetch_sub(1) == 1) {
+            owner->wake_sleepers();
+        }
+    });
+}
+
+void TaskGroup::wait (void) {
+    while (pending->load() > 0) {
+        if (scheduler.run_one(priority)) {
+            continue;
+        }
+        // sleep until the group is done or there is work this thread may
+        // help with
+        std::unique_lock<std::mutex> lock(scheduler.sleep_mutex);
+        scheduler.sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        scheduler.wake.wait(lock, [this]() {
+            return pending->load() == 0 || scheduler.has_work(priority);
+        });
+        scheduler.sleepers.fetch_sub(1);
+    }
+}
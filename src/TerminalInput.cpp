@@ -0,0 +1,404 @@
+#include "..\inc\TerminalInput.h"
+
+//=============================================================================
+// InputDecoder
+//=============================================================================
+
+static struct InputEvent key_event (InputKey key, char ch = 0,
+                                    uint8_t modifiers = 0) {
+    struct InputEvent event;
+    event.type = INPUT_KEY;
+    event.key = key;
+    event.ch = ch;
+    event.modifiers = modifiers;
+    return event;
+}
+
+// a key sent as a single byte
+static struct InputEvent decode_byte (unsigned char b) {
+    switch (b) {
+        case '\r':
+        case '\n': return key_event(KEY_ENTER);
+        case '\t': return key_event(KEY_TAB);
+        case 0x08:
+        case 0x7f: return key_event(KEY_BACKSPACE);
+        case 0x1b: return key_event(KEY_ESCAPE);
+        case 0x00: return key_event(KEY_CHAR, ' ', MOD_CTRL);
+        default:   break;
+    }
+    // Ctrl-A to Ctrl-Z, then Ctrl-\ ] ^ _
+    if (b <= 26) {
+        return key_event(KEY_CHAR, static_cast<char>('a' + b - 1), MOD_CTRL);
+    }
+    if (b < 0x20) {
+        return key_event(KEY_CHAR, static_cast<char>(b + 0x40), MOD_CTRL);
+    }
+    return key_event(KEY_CHAR, static_cast<char>(b));
+}
+
+// the key of a CSI sequence ending in '~', by its first parameter
+static InputKey tilde_key (int code) {
+    switch (code) {
+        case 1: case 7: return KEY_HOME;
+        case 2:         return KEY_INSERT;
+        case 3:         return KEY_DELETE;
+        case 4: case 8: return KEY_END;
+        case 5:         return KEY_PAGE_UP;
+        case 6:         return KEY_PAGE_DOWN;
+        default:        break;
+    }
+    // F1-F5 are 11-15, F6-F10 are 17-21 and F11-F12 are 23-24
+    static const int function_codes[12] = {11, 12, 13, 14, 15, 17, 18, 19,
+                                           20, 21, 23, 24};
+    for (int n = 0; n < 12; n++) {
+        if (function_codes[n] == code) {
+            return static_cast<InputKey>(KEY_F1 + n);
+        }
+    }
+    return KEY_NONE;
+}
+
+// the key of a CSI or SS3 sequence by its final byte, KEY_NONE for '~'
+static InputKey final_key (char final) {
+    switch (final) {
+        case 'A': return KEY_UP;
+        case 'B': return KEY_DOWN;
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        case 'Z': return KEY_TAB;
+        case 'P': case 'Q': case 'R': case 'S':
+            return static_cast<InputKey>(KEY_F1 + (final - 'P'));
+        default:  return KEY_NONE;
+    }
+}
+
+size_t InputDecoder::decode (size_t pos, bool complete,
+                             struct InputEvent *event) const {
+    const size_t size = buffer.size();
+    unsigned char b = static_cast<unsigned char>(buffer[pos]);
+    if (b != 0x1b) {
+        *event = decode_byte(b);
+        return 1;
+    }
+    if (pos + 1 == size) {
+        if (!complete) {
+            return 0;
+        }
+        *event = key_event(KEY_ESCAPE);
+        return 1;
+    }
+
+    char next = buffer[pos + 1];
+    if (next == '[') {
+        // CSI: parameter bytes, intermediate bytes, then a final byte
+        size_t end = pos + 2;
+        while (end < size && (static_cast<unsigned char>(buffer[end]) < 0x40 ||
+                              static_cast<unsigned char>(buffer[end]) > 0x7e)) {
+            end++;
+        }
+        if (end == size) {
+            if (!complete) {
+                return 0;
+            }
+            *event = key_event(KEY_CHAR, '[', MOD_ALT);
+            return 2;
+        }
+        // parameters are ';' separated numbers: the key code, then the
+        // modifiers plus one
+        int params[2] = {0, 0};
+        int count = 0;
+        for (size_t i = pos + 2; i < end && count < 2; i++) {
+            char c = buffer[i];
+            if (c >= '0' && c <= '9') {
+                params[count] = std::min(params[count] * 10 + (c - '0'),
+                                         INPUT_MAX_PARAM);
+            } else if (c == ';') {
+                count++;
+            }
+        }
+        char final = buffer[end];
+        InputKey key = (final == '~') ? tilde_key(params[0]) : final_key(final);
+        uint8_t modifiers = (params[1] > 1) ?
+            static_cast<uint8_t>((params[1] - 1) & 
+                                 (MOD_SHIFT | MOD_ALT | MOD_CTRL)) : 0;
+        if (final == 'Z') {
+            modifiers |= MOD_SHIFT;
+        }
+        *event = key_event(key, 0, modifiers);
+        return end + 1 - pos;
+    }
+    if (next == 'O') {
+        // SS3: one final byte
+        if (pos + 2 == size) {
+            if (!complete) {
+                return 0;
+            }
+            *event = key_event(KEY_CHAR, 'O', MOD_ALT);
+            return 2;
+        }
+        *event = key_event(final_key(buffer[pos + 2]));
+        return 3;
+    }
+
+    // escape then a key is that key with Alt
+    *event = decode_byte(static_cast<unsigned char>(next));
+    event->modifiers |= MOD_ALT;
+    return 2;
+}
+
+void InputDecoder::feed (const char *bytes, size_t n,
+                         std::vector<struct InputEvent> *events) {
+    buffer.append(bytes, n);
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+        struct InputEvent event;
+        size_t used = decode(pos, false, &event);
+        if (used == 0) {
+            break;
+        }
+        if (event.key != KEY_NONE) {
+            events->push_back(event);
+        }
+        pos += used;
+    }
+    buffer.erase(0, pos);
+}
+
+void InputDecoder::flush (std::vector<struct InputEvent> *events) {
+    size_t pos = 0;
+    while (pos < buffer.size()) {
+        struct InputEvent event;
+        pos += decode(pos, true, &event);
+        if (event.key != KEY_NONE) {
+            events->push_back(event);
+        }
+    }
+    buffer.clear();
+}
+
+//=============================================================================
+// TerminalInput
+//=============================================================================
+
+void TerminalInput::push_events (void) {
+    for (struct InputEvent &event : events) {
+        queue->push(event);
+    }
+    events.clear();
+}
+
+#ifdef _WIN32
+
+TerminalInput::TerminalInput (ThreadSafeQueue<struct InputEvent> *queue) :
+    queue(queue) {
+    console = GetStdHandle(STD_INPUT_HANDLE);
+    stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (GetConsoleMode(console, &saved_mode)) {
+        // key and resize records, without line input or echo
+        SetConsoleMode(console, ENABLE_WINDOW_INPUT | ENABLE_PROCESSED_INPUT);
+        restore_mode = true;
+    }
+    reader = std::thread(&TerminalInput::read_loop, this);
+}
+
+TerminalInput::~TerminalInput (void) {
+    SetEvent(stop_event);
+    reader.join();
+    if (restore_mode) {
+        SetConsoleMode(console, saved_mode);
+    }
+    CloseHandle(stop_event);
+}
+
+// the event of a console key record
+static struct InputEvent console_key (const KEY_EVENT_RECORD &record) {
+    uint8_t modifiers = 0;
+    DWORD state = record.dwControlKeyState;
+    if (state & SHIFT_PRESSED) {
+        modifiers |= MOD_SHIFT;
+    }
+    if (state & (LEFT_ALT_PRESSED | RIGHT_ALT_PRESSED)) {
+        modifiers |= MOD_ALT;
+    }
+    if (state & (LEFT_CTRL_PRESSED | RIGHT_CTRL_PRESSED)) {
+        modifiers |= MOD_CTRL;
+    }
+
+    WORD vk = record.wVirtualKeyCode;
+    switch (vk) {
+        case VK_UP:     return key_event(KEY_UP, 0, modifiers);
+        case VK_DOWN:   return key_event(KEY_DOWN, 0, modifiers);
+        case VK_LEFT:   return key_event(KEY_LEFT, 0, modifiers);
+        case VK_RIGHT:  return key_event(KEY_RIGHT, 0, modifiers);
+        case VK_HOME:   return key_event(KEY_HOME, 0, modifiers);
+        case VK_END:    return key_event(KEY_END, 0, modifiers);
+        case VK_PRIOR:  return key_event(KEY_PAGE_UP, 0, modifiers);
+        case VK_NEXT:   return key_event(KEY_PAGE_DOWN, 0, modifiers);
+        case VK_INSERT: return key_event(KEY_INSERT, 0, modifiers);
+        case VK_DELETE: return key_event(KEY_DELETE, 0, modifiers);
+        default:        break;
+    }
+    if (vk >= VK_F1 && vk <= VK_F12) {
+        return key_event(static_cast<InputKey>(KEY_F1 + (vk - VK_F1)), 0,
+                         modifiers);
+    }
+    if ((modifiers & MOD_CTRL) && vk >= 'A' && vk <= 'Z') {
+        return key_event(KEY_CHAR, static_cast<char>('a' + (vk - 'A')),
+                         modifiers & ~MOD_SHIFT);
+    }
+    char ch = record.uChar.AsciiChar;
+    if (ch == 0) {
+        return key_event(KEY_NONE);
+    }
+    struct InputEvent event = decode_byte(static_cast<unsigned char>(ch));
+    event.modifiers |= modifiers & MOD_ALT;
+    return event;
+}
+
+void TerminalInput::read_loop (void) {
+    HANDLE handles[2] = {console, stop_event};
+    INPUT_RECORD records[INPUT_READ_BYTES];
+    while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+           WAIT_OBJECT_0) {
+        DWORD count = 0;
+        if (!ReadConsoleInput(console, records, INPUT_READ_BYTES, &count)) {
+            break;
+        }
+        for (DWORD i = 0; i < count; i++) {
+            if (records[i].EventType == WINDOW_BUFFER_SIZE_EVENT) {
+                struct InputEvent event;
+                event.type = INPUT_RESIZE;
+                events.push_back(event);
+            } else if (records[i].EventType == KEY_EVENT &&
+                       records[i].Event.KeyEvent.bKeyDown) {
+                struct InputEvent event = console_key(records[i].Event.KeyEvent);
+                for (WORD r = 0; event.key != KEY_NONE &&
+                     r < records[i].Event.KeyEvent.wRepeatCount; r++) {
+                    events.push_back(event);
+                }
+            }
+        }
+        push_events();
+    }
+}
+
+#else
+
+// the write end of the running reader's wake pipe, for the SIGWINCH handler
+static std::atomic<int> resize_fd(-1);
+
+static void on_resize (int) {
+    int fd = resize_fd.load();
+    if (fd >= 0) {
+        char byte = 'r';
+        ssize_t ignored = write(fd, &byte, 1);
+        (void)ignored;
+    }
+}
+
+TerminalInput::TerminalInput (ThreadSafeQueue<struct InputEvent> *queue) :
+    queue(queue) {
+    if (pipe(wake_pipe) != 0) {
+        panicf("TerminalInput: Error creating wake pipe.\n");
+    }
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved_mode) == 0) {
+        struct termios raw = saved_mode;
+        raw.c_iflag &= ~(IXON | ICRNL | INLCR | ISTRIP | BRKINT);
+        raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+#ifdef VSTATUS
+        raw.c_cc[VSTATUS] = _POSIX_VDISABLE;
+#endif
+        tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+        restore_mode = true;
+    }
+
+    resize_fd = wake_pipe[1];
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_resize;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, &saved_winch);
+
+    reader = std::thread(&TerminalInput::read_loop, this);
+}
+
+TerminalInput::~TerminalInput (void) {
+    char byte = 'q';
+    ssize_t ignored = write(wake_pipe[1], &byte, 1);
+    (void)ignored;
+    reader.join();
+
+    sigaction(SIGWINCH, &saved_winch, nullptr);
+    resize_fd = -1;
+    if (restore_mode) {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_mode);
+    }
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+}
+
+// poll sleeps until stdin has bytes or the pipe is written; it only times
+// out while an escape sequence is unfinished
+void TerminalInput::read_loop (void) {
+    struct pollfd fds[2];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_pipe[0];
+    fds[1].events = POLLIN;
+    char bytes[INPUT_READ_BYTES];
+
+    while (true) {
+        int timeout = decoder.pending() ? INPUT_ESCAPE_MS : -1;
+        int ready = poll(fds, 2, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (ready == 0) {
+            decoder.flush(&events);
+            push_events();
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            ssize_t n = read(wake_pipe[0], bytes, sizeof(bytes));
+            for (ssize_t i = 0; i < n; i++) {
+                if (bytes[i] == 'q') {
+                    return;
+                }
+                struct InputEvent event;
+                event.type = INPUT_RESIZE;
+                events.push_back(event);
+            }
+            push_events();
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(STDIN_FILENO, bytes, sizeof(bytes));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                // nothing more can be typed; poll skips a negative fd
+                decoder.flush(&events);
+                push_events();
+                queue->close();
+                fds[0].fd = -1;
+                continue;
+            }
+            decoder.feed(bytes, static_cast<size_t>(n), &events);
+            push_events();
+        }
+    }
+}
+
+#endif
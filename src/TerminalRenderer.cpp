@@ -0,0 +1,176 @@
+#include "..\inc\TerminalRenderer.h"
+
+#ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#endif
+
+static const char *style_sequence (uint8_t style) {
+    switch (style) {
+        case STYLE_BOLD:    return "\x1b[0;1m";
+        case STYLE_REVERSE: return "\x1b[0;7m";
+        default:            return "\x1b[0m";
+    }
+}
+
+TerminalRenderer::TerminalRenderer (FILE *out) : out(out) {
+#ifdef _WIN32
+    // the console only interprets escape sequences once asked to
+    HANDLE console = GetStdHandle(out == stdout ? STD_OUTPUT_HANDLE
+                                                : STD_ERROR_HANDLE);
+    DWORD mode = 0;
+    if (GetConsoleMode(console, &mode)) {
+        SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+#endif
+    // alternate screen, hidden cursor
+    fputs("\x1b[?1049h\x1b[?25l", out);
+    fflush(out);
+}
+
+TerminalRenderer::~TerminalRenderer (void) {
+    fputs("\x1b[0m\x1b[?25h\x1b[?1049l", out);
+    fflush(out);
+}
+
+void TerminalRenderer::query_size (int *rows, int *cols) const {
+    *rows = RENDER_DEFAULT_ROWS;
+    *cols = RENDER_DEFAULT_COLS;
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    HANDLE console = GetStdHandle(out == stdout ? STD_OUTPUT_HANDLE
+                                                : STD_ERROR_HANDLE);
+    if (GetConsoleScreenBufferInfo(console, &info)) {
+        *rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        *cols = info.srWindow.Right - info.srWindow.Left + 1;
+    }
+#else
+    struct winsize size;
+    if (ioctl(fileno(out), TIOCGWINSZ, &size) == 0 &&
+        size.ws_row > 0 && size.ws_col > 0) {
+        *rows = size.ws_row;
+        *cols = size.ws_col;
+    }
+#endif
+}
+
+void TerminalRenderer::begin_frame (void) {
+    int rows, cols;
+    query_size(&rows, &cols);
+    if (rows != height || cols != width) {
+        height = rows;
+        width = cols;
+        front.assign(static_cast<size_t>(width) * height, TerminalCell());
+        full_repaint = true;
+    }
+    back.assign(static_cast<size_t>(width) * height, TerminalCell());
+}
+
+int TerminalRenderer::put (int row, int col, std::string_view text,
+                           uint8_t style) {
+    if (row < 0 || row >= height) {
+        return col + static_cast<int>(text.size());
+    }
+    for (char ch : text) {
+        if (col >= width) {
+            break;
+        }
+        if (col >= 0) {
+            unsigned char byte = static_cast<unsigned char>(ch);
+            TerminalCell &cell = back[static_cast<size_t>(row) * width + col];
+            cell.ch = (byte >= 0x20 && byte < 0x7f) ? ch : '?';
+            cell.style = style;
+        }
+        col++;
+    }
+    return col;
+}
+
+void TerminalRenderer::fill (int row, int col, int count, char ch,
+                             uint8_t style) {
+    if (row < 0 || row >= height) {
+        return;
+    }
+    int end = std::min(width, col + count);
+    for (int c = std::max(col, 0); c < end; c++) {
+        TerminalCell &cell = back[static_cast<size_t>(row) * width + c];
+        cell.ch = ch;
+        cell.style = style;
+    }
+}
+
+void TerminalRenderer::move_cursor (int row, int col) {
+    char sequence[32];
+    int n = snprintf(sequence, sizeof(sequence), "\x1b[%d;%dH", row + 1,
+                     col + 1);
+    output.append(sequence, n);
+}
+
+void TerminalRenderer::set_style (uint8_t style) {
+    output += style_sequence(style);
+}
+
+// The cursor and style are tracked while the frame is written, so a run of
+// changed cells costs one cursor move and a style change only where the
+// style actually changes.
+size_t TerminalRenderer::present (void) {
+    output.clear();
+
+    // after a clear the screen is blank, which the front buffer already says
+    if (full_repaint) {
+        output += "\x1b[0m\x1b[2J";
+        full_repaint = false;
+    }
+
+    int cursor_row = -1;
+    int cursor_col = -1;
+    uint8_t style = STYLE_NORMAL;
+    for (int r = 0; r < height; r++) {
+        const TerminalCell *now = &back[static_cast<size_t>(r) * width];
+        const TerminalCell *shown = &front[static_cast<size_t>(r) * width];
+        for (int c = 0; c < width; c++) {
+            if (now[c] == shown[c]) {
+                continue;
+            }
+
+            // rewriting a short gap of unchanged cells in the current style
+            // is cheaper than moving over it
+            bool bridge = cursor_row == r && cursor_col < c &&
+                          c - cursor_col <= RENDER_MAX_GAP;
+            for (int g = cursor_col; bridge && g < c; g++) {
+                bridge = now[g].style == style;
+            }
+            if (bridge) {
+                for (int g = cursor_col; g < c; g++) {
+                    output += now[g].ch;
+                }
+            } else if (cursor_row != r || cursor_col != c) {
+                move_cursor(r, c);
+            }
+
+            if (now[c].style != style) {
+                style = now[c].style;
+                set_style(style);
+            }
+            output += now[c].ch;
+            cursor_row = r;
+            cursor_col = c + 1;
+
+            // the cursor doesn't advance past the last column
+            if (cursor_col >= width) {
+                cursor_row = -1;
+            }
+        }
+    }
+    if (style != STYLE_NORMAL) {
+        set_style(STYLE_NORMAL);
+    }
+    front.swap(back);
+
+    if (!output.empty()) {
+        fwrite(output.data(), 1, output.size(), out);
+        fflush(out);
+    }
+    return output.size();
+}
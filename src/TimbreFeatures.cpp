@@ -0,0 +1,129 @@
+#include "../inc/TimbreFeatures.h"
+
+// map a frequency to its log-spaced timbre band, -1 if out of range
+static inline int freq_to_band (float freq) {
+    if (freq < TIMBRE_MIN_FREQ || freq >= TIMBRE_MAX_FREQ) {
+        return -1;
+    }
+    static const float span = std::log(TIMBRE_MAX_FREQ / TIMBRE_MIN_FREQ);
+    return static_cast<int>(std::log(freq / TIMBRE_MIN_FREQ) / span * TIMBRE_BANDS);
+}
+
+// normalize a frequency onto [0, 1] on the same log scale as the bands
+static inline float log_freq_position (double freq) {
+    if (freq <= TIMBRE_MIN_FREQ) {
+        return 0.0f;
+    }
+    static const double span = std::log(TIMBRE_MAX_FREQ / TIMBRE_MIN_FREQ);
+    return static_cast<float>(std::log(freq / TIMBRE_MIN_FREQ) / span);
+}
+
+void TimbreMap::accumulate (const float *magnitudes, int num_bins,
+                            int sample_rate, const float *samples,
+                            int num_samples) {
+
+    if (num_bins <= 0 || num_samples <= 0) [[unlikely]] {
+        return;
+    }
+
+    // spectral statistics
+    // every bin is (i * sample_rate / fft_size) Hz, where fft_size = 2 * bins
+    const double bin_hz = static_cast<double>(sample_rate) / (2 * num_bins);
+    double bands[TIMBRE_BANDS] = {0.0};
+    double total = 0.0, weighted = 0.0, log_sum = 0.0;
+    for (int i = 1; i < num_bins; i++) {
+        double mag = magnitudes[i];
+        int band = freq_to_band(i * bin_hz);
+        if (band >= 0) {
+            bands[band] += mag * mag;
+        }
+        total += mag;
+        weighted += mag * i * bin_hz;
+        log_sum += std::log(mag + 1e-9);
+    }
+
+    double win_centroid = (total > 0.0) ? weighted / total : 0.0;
+    double win_spread = 0.0, win_rolloff = 0.0, running = 0.0;
+    for (int i = 1; i < num_bins; i++) {
+        double freq = i * bin_hz;
+        double mag = magnitudes[i];
+        if (total > 0.0) {
+            win_spread += mag * (freq - win_centroid) * (freq - win_centroid);
+        }
+        running += mag;
+        if (win_rolloff == 0.0 && running >= 0.85 * total) {
+            win_rolloff = freq;
+        }
+    }
+    win_spread = (total > 0.0) ? std::sqrt(win_spread / total) : 0.0;
+    double arith_mean = total / (num_bins - 1);
+    double win_flatness = (arith_mean > 0.0) ?
+        std::exp(log_sum / (num_bins - 1)) / arith_mean : 0.0;
+
+    // temporal statistics
+    double energy = 0.0, peak = 0.0;
+    int crossings = 0;
+    for (int i = 0; i < num_samples; i++) {
+        double s = samples[i];
+        energy += s * s;
+        peak = std::max(peak, std::fabs(s));
+        if (i > 0 && ((samples[i - 1] < 0.0f) != (s < 0.0))) {
+            crossings++;
+        }
+    }
+    double rms = std::sqrt(energy / num_samples);
+    double win_loudness = std::log10(rms + 1e-6);
+    double win_crest = (rms > 0.0) ? peak / rms : 0.0;
+
+    // accumulate the window in the map
+    std::lock_guard<std::mutex> guard(mutex);
+    num_windows++;
+    for (int b = 0; b < TIMBRE_BANDS; b++) {
+        band_energy[b] += bands[b];
+    }
+    centroid += win_centroid;
+    spread += win_spread;
+    rolloff += win_rolloff;
+    flatness += win_flatness;
+    loudness += win_loudness;
+    loudness_sq += win_loudness * win_loudness;
+    zero_crossings += static_cast<double>(crossings) / num_samples;
+    crest += win_crest;
+}
+
+std::vector<float> TimbreMap::embedding (void) {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (num_windows == 0) {
+        return std::vector<float>();
+    }
+
+    std::vector<float> vec(TIMBRE_DIMS, 0.0f);
+    const double n = num_windows;
+
+    // band shape: log energies relative to their mean, so gain doesn't matter
+    double mean = 0.0;
+    for (int b = 0; b < TIMBRE_BANDS; b++) {
+        vec[b] = static_cast<float>(std::log10(band_energy[b] / n + 1e-9));
+        mean += vec[b];
+    }
+    mean /= TIMBRE_BANDS;
+    for (int b = 0; b < TIMBRE_BANDS; b++) {
+        vec[b] = static_cast<float>((vec[b] - mean) / 4.0);
+    }
+
+    // spectral shape, frequencies on the band scale
+    vec[TIMBRE_BANDS + 0] = log_freq_position(centroid / n);
+    vec[TIMBRE_BANDS + 1] = log_freq_position(spread / n);
+    vec[TIMBRE_BANDS + 2] = log_freq_position(rolloff / n);
+    vec[TIMBRE_BANDS + 3] = static_cast<float>(flatness / n);
+
+    // dynamics
+    double loud_mean = loudness / n;
+    double loud_var = std::max(0.0, loudness_sq / n - loud_mean * loud_mean);
+    vec[TIMBRE_BANDS + 4] = static_cast<float>(loud_mean / 3.0);
+    vec[TIMBRE_BANDS + 5] = static_cast<float>(std::sqrt(loud_var));
+    vec[TIMBRE_BANDS + 6] = static_cast<float>(zero_crossings / n * 4.0);
+    vec[TIMBRE_BANDS + 7] = static_cast<float>(std::log10(1.0 + crest / n));
+
+    return vec;
+}
@@ -0,0 +1,189 @@
+#include "..\inc\TrigramIndex.h"
+
+static inline uint32_t trigram_key (const char *s) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(s[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(s[1])) << 8) |
+            static_cast<uint32_t>(static_cast<uint8_t>(s[2]));
+}
+
+void TrigramIndex::add (uint32_t doc, std::string_view text) {
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        CompressedPostingList &list = postings[trigram_key(&text[i])];
+        // a trigram repeated within the document is listed once
+        if (list.empty() || list.last() != doc) {
+            list.append(doc);
+        }
+    }
+}
+
+std::vector<uint32_t> TrigramIndex::candidates (std::string_view pattern) const {
+    std::vector<uint32_t> keys;
+    for (size_t i = 0; i + 3 <= pattern.size(); i++) {
+        keys.push_back(trigram_key(&pattern[i]));
+    }
+    if (keys.empty()) {
+        return std::vector<uint32_t>();
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<const CompressedPostingList*> lists;
+    for (uint32_t key : keys) {
+        auto it = postings.find(key);
+        if (it == postings.end()) {
+            return std::vector<uint32_t>();
+        }
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(),
+        [](const CompressedPostingList* a, const CompressedPostingList* b) {
+            return a->size() < b->size();
+        });
+
+    // decode the rarest list, then probe the others with seeks; once few
+    // candidates are left, verifying them is cheaper than more probing
+    std::vector<uint32_t> result;
+    lists[0]->decode(&result);
+    for (size_t i = 1; i < lists.size() && 
+                       result.size() > TRIGRAM_DIRECT_VERIFY; i++) {
+        CompressedPostingList::Reader reader(*lists[i]);
+        size_t kept = 0;
+        uint32_t value;
+        for (uint32_t doc : result) {
+            if (!reader.seek(doc, &value)) {
+                break;
+            }
+            if (value == doc) {
+                result[kept++] = doc;
+            }
+        }
+        result.resize(kept);
+    }
+    return result;
+}
+
+size_t TrigramIndex::estimate (std::string_view pattern) const {
+    size_t rarest = SIZE_MAX;
+    for (size_t i = 0; i + 3 <= pattern.size(); i++) {
+        auto it = postings.find(trigram_key(&pattern[i]));
+        if (it == postings.end()) {
+            return 0;
+        }
+        rarest = std::min(rarest, it->second.size());
+    }
+    return (rarest == SIZE_MAX) ? 0 : rarest;
+}
+
+void TrigramIndex::clear (void) {
+    postings.clear();
+}
+
+std::vector<std::pair<uint32_t, const CompressedPostingList*>> 
+TrigramIndex::lists (void) const {
+    std::vector<std::pair<uint32_t, const CompressedPostingList*>> result;
+    result.reserve(postings.size());
+    for (const auto &entry : postings) {
+        result.emplace_back(entry.first, &entry.second);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void TrigramIndex::set_list (uint32_t trigram, 
+                             const CompressedPostingList &list) {
+    postings[trigram] = list;
+}
+
+size_t TrigramIndex::memory (void) const {
+    size_t bytes = 0;
+    for (const auto &entry : postings) {
+        bytes += entry.second.memory();
+    }
+    return bytes;
+}
+
+// is some prefix of text within one edit of pattern
+// At the first mismatch the rest must line up after a substitution, a
+// deletion or an insertion.
+static bool one_edit_prefix (std::string_view text, std::string_view pattern) {
+    size_t i = 0;
+    while (i < text.size() && i < pattern.size() && text[i] == pattern[i]) {
+        i++;
+    }
+    if (i == pattern.size()) {
+        return true;
+    }
+    std::string_view rest = pattern.substr(i + 1);
+    if (text.substr(i).substr(0, rest.size()) == rest) {
+        return true;
+    }
+    if (i < text.size()) {
+        std::string_view after = text.substr(i + 1);
+        if (after.substr(0, rest.size()) == rest ||
+            after.substr(0, pattern.size() - i) == pattern.substr(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// is some suffix of text within one edit of pattern
+static bool one_edit_suffix (std::string_view text, std::string_view pattern) {
+    auto ends_with = [](std::string_view s, std::string_view end) {
+        return s.size() >= end.size() && 
+               s.substr(s.size() - end.size()) == end;
+    };
+    size_t i = 0;
+    while (i < text.size() && i < pattern.size() && 
+           text[text.size() - 1 - i] == pattern[pattern.size() - 1 - i]) {
+        i++;
+    }
+    if (i == pattern.size()) {
+        return true;
+    }
+    std::string_view head_text = text.substr(0, text.size() - i);
+    std::string_view head = pattern.substr(0, pattern.size() - i);
+    std::string_view rest = head.substr(0, head.size() - 1);
+    if (ends_with(head_text, rest)) {
+        return true;
+    }
+    if (!head_text.empty()) {
+        std::string_view before = head_text.substr(0, head_text.size() - 1);
+        if (ends_with(before, rest) || ends_with(before, head)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// With one edit, one half of the needle occurs unchanged, so the search
+// only has to look around exact occurrences of the two halves
+size_t find_approximate (std::string_view text, std::string_view needle,
+                         int max_edits, int *edits) {
+    size_t pos = text.find(needle);
+    if (pos != std::string_view::npos) {
+        *edits = 0;
+        return pos;
+    }
+    if (max_edits < 1 || needle.size() < 2) {
+        return std::string_view::npos;
+    }
+
+    *edits = 1;
+    size_t half = needle.size() / 2;
+    std::string_view left = needle.substr(0, half);
+    std::string_view right = needle.substr(half);
+    for (size_t p = text.find(left); p != std::string_view::npos; 
+         p = text.find(left, p + 1)) {
+        if (one_edit_prefix(text.substr(p + half), right)) {
+            return p;
+        }
+    }
+    for (size_t q = text.find(right); q != std::string_view::npos;
+         q = text.find(right, q + 1)) {
+        if (one_edit_suffix(text.substr(0, q), left)) {
+            return (q > half) ? q - half : 0;
+        }
+    }
+    return std::string_view::npos;
+}
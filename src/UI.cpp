@@ -12,60 +12,94 @@ std::string format_string (std::string str, size_t length) {
     }
 }
 
-void render_ui (UIState *ui_state) {
+// indent of the result rows, where a tab used to be
+#define UI_RESULT_INDENT 8
 
-    std::string display = format_string(ui_state->search_buffer, UI_SEARCH_WIDTH);
+// facet values shown per line, most matches first
+#define UI_FACET_VALUES 6
 
-    std::string result[5];
-    for(size_t i=0; i<5; i++) {
-        if(i >= ui_state->files.size()) {
-            result[i] = format_string("", UI_RESULT_WIDTH);
-        } else {
-            int index = ui_state->file_scroll;
-            struct FileRecord file = ui_state->files[index];
-            result[i] = format_string(file.file_name, UI_RESULT_WIDTH
-            );
+// key numbers are major keys (see MidiMap::int_to_key)
+static const char *KEY_LABELS[12] = {
+    "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"
+};
+
+static std::string key_label (int key) {
+    return (key >= 0 && key < 12) ? KEY_LABELS[key] : "?";
+}
+
+static std::string bpm_label (int bucket) {
+    return (bucket < 0) ? "?" : std::to_string(bucket * FACET_BPM_BUCKET) + 
+                                "s";
+}
+
+// the most common values of a facet as "label count" pairs
+static std::string facet_line (const std::map<int, int64_t> &counts,
+                               std::string (*label) (int)) {
+    std::vector<std::pair<int64_t, int>> sorted;
+    for (const auto &count : counts) {
+        sorted.emplace_back(-count.second, count.first);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::string line;
+    for (size_t i = 0; i < sorted.size() && i < UI_FACET_VALUES; i++) {
+        line += label(sorted[i].second) + " " + 
+                std::to_string(-sorted[i].first) + "  ";
+    }
+    return line;
+}
+
+// Draw the ui into the renderer's back buffer and present it. Only the
+// cells that differ from the last frame reach the terminal.
+void render_ui (UIState *ui_state, TerminalRenderer *renderer) {
+
+    renderer->begin_frame();
+    const int rule_width = UI_SEARCH_WIDTH;
+
+    int row = 0;
+    renderer->fill(row++, 0, rule_width, '=');
+    renderer->put(renderer->put(row, 0, "UI_State: "), row, 
+                  std::string(1, ui_state->frame));
+    row++;
+    std::string queued_inputs = std::to_string(ui_state->control_queue->size());
+    renderer->put(renderer->put(row, 0, "Queued Inputs: "), row, queued_inputs);
+    row++;
+    renderer->fill(row++, 0, rule_width, '=');
+    int col = renderer->put(row, 0, "Search Bar: ");
+    renderer->put(row++, col, format_string(ui_state->search_buffer, 
+                                            UI_SEARCH_WIDTH), STYLE_BOLD);
+    renderer->fill(row++, 0, rule_width, '-');
+    {
+        std::lock_guard<std::mutex> lock(ui_state->results_mutex);
+        col = renderer->put(row, 0, "Search Results: ");
+        renderer->put(row++, col, std::to_string(ui_state->num_matches));
+
+        // structured queries also break their matches down by key and bpm
+        const struct FacetCounts &facets = ui_state->facets;
+        col = renderer->put(row, 0, "Keys: ");
+        renderer->put(row++, col, format_string(
+            facet_line(facets.keys, key_label), UI_RESULT_WIDTH));
+        col = renderer->put(row, 0, "BPM:  ");
+        renderer->put(row++, col, format_string(
+            facet_line(facets.bpm_buckets, bpm_label), UI_RESULT_WIDTH));
+
+        for (size_t i = 0; i < UI_RESULT_ROWS; i++) {
+            size_t index = ui_state->file_scroll + i;
+            if (index < ui_state->files.size()) {
+                renderer->put(row, UI_RESULT_INDENT, format_string(
+                    ui_state->files[index].file_name, UI_RESULT_WIDTH));
+            }
+            row++;
         }
     }
+    renderer->fill(row++, 0, rule_width, '=');
 
-    std::string ui_frame(1, ui_state->frame);
-    std::string queued_inputs = std::to_string((int) ui_state->control_queue->size());
-    
-    std::string ui =     
-    "======================================================================\n" \
-    "UI_State: " + ui_frame + "\n" \
-    "Queued Inputs: " + queued_inputs + "\n" \
-    "======================================================================\n" \
-    "Search Bar: " + display + "\n"\
-    "----------------------------------------------------------------------\n" \
-    "Search Results:\n" \
-    "\t" + result[0] + "\n" \
-    "\t" + result[1] + "\n" \
-    "\t" + result[2] + "\n" \
-    "\t" + result[3] + "\n" \
-    "\t" + result[4] + "\n" \
-    "======================================================================\n";
-    
-    std::cerr << ui << std::endl;
+    renderer->present();
 }
 
-void print_search_results (std::vector<struct FileRecord> results, int n) {
+void print_search_results (const std::vector<struct SearchHit> &results, int n) {
     int print_limit = static_cast<int>(results.size()) > n ? n : results.size();
     for(int i=0; i<print_limit; i++) {
         fprintf(stderr, "[%d] %s\n", i, results[i].file_name.c_str());
     }
     return;
 }
-
-void ui_hide_cursor (void) {
-    // Get the console handle
-    HANDLE consoleHandle = GetStdHandle(STD_OUTPUT_HANDLE);
-    
-    // Get the current console cursor information
-    CONSOLE_CURSOR_INFO cursorInfo;
-    GetConsoleCursorInfo(consoleHandle, &cursorInfo);
-    
-    // Set the cursor visibility to false
-    cursorInfo.bVisible = FALSE;
-    SetConsoleCursorInfo(consoleHandle, &cursorInfo);
-}
\ No newline at end of file
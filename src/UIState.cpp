@@ -1,27 +1,30 @@
 #include "..\inc\UIState.h"
 
 void UIState::process_inputs (void) {
-    while (!control_queue->empty()) {
-        char input_container;
-        control_queue->wait_pop(input_container);
+    struct InputEvent input_container;
+    while (control_queue->try_pop(input_container)) {
         this->input_dispatch(input_container);
     }
 }
 
-inline bool UIState::is_command (char input) {
-    int character = static_cast<int>(input);
-    if (character == KBD_CTRL_S || character == KBD_CTRL_R || 
-        character == KBD_CTRL_T || character == KBD_CTRL_Q) {
+inline bool UIState::is_command (const struct InputEvent &input) {
+    if (input.is_ctrl('s') || input.is_ctrl('r') ||
+        input.is_ctrl('t') || input.is_ctrl('q')) {
         return true;
     } else {
         return false;
     }
 }
 
-void UIState::input_dispatch (char input) {
-    
+void UIState::input_dispatch (const struct InputEvent &input) {
+
+    // resizes and new results only need a redraw
+    if (input.type != INPUT_KEY) {
+        return;
+    }
+
     if(this->is_command(input)){
-        command_handler(input);
+        command_handler(input.ch);
         return;
     }
     
@@ -45,17 +48,18 @@ void UIState::input_dispatch (char input) {
 
 void UIState::command_handler (char commmand) {
     switch(commmand) {
-        case KBD_CTRL_S: // Ctrl-S
+        case 's': // Ctrl-S
             this->frame = 's';
             return;
-        case KBD_CTRL_R: // Ctrl-R
+        case 'r': // Ctrl-R
             this->frame = 'r';
             return;
-        case KBD_CTRL_T: // Ctrl-T 
+        case 't': // Ctrl-T
             this->frame = 't';
             return;
-        case KBD_CTRL_Q: // Ctrl-Q
+        case 'q': // Ctrl-Q: the ui thread stops once the queue drains
             this->frame = 'q';
+            control_queue->close();
             return;
         default:
             return;
@@ -66,18 +70,18 @@ void UIState::command_handler (char commmand) {
 // Handle inputs in SEARCH frame
 //==============================================================================
 
-void UIState::search_control_handler (char c) {
-    if (c == '\n') {
+void UIState::search_control_handler (const struct InputEvent &input) {
+    if (input.key == KEY_ENTER) {
         this->frame = 'r';
     } else {
-        update_search_buffer(c);
+        update_search_buffer(input);
     }
 }
 
 // add a character to the serach buffer
-void UIState::update_search_buffer (char c) {    
+void UIState::update_search_buffer (const struct InputEvent &input) {
     // backspace
-    if (c == '\b') {
+    if (input.key == KEY_BACKSPACE) {
         if(search_cursor > 0) {
             search_buffer.erase(--search_cursor);
         }
@@ -85,16 +89,17 @@ void UIState::update_search_buffer (char c) {
 
     // Del Key: delete character in front of cursor
     // TODO: Cursor scroll
-    else if (c == 127) {
+    else if (input.key == KEY_DELETE) {
         // if(size_t(search_cursor) < search_buffer.length()-1) {
         //     search_buffer.erase(search_cursor + 1);
         // }
     }
 
     // printable characters
-    else if (std::isprint(c)) {
+    else if (input.key == KEY_CHAR && !(input.modifiers & (MOD_CTRL | MOD_ALT)) &&
+             std::isprint(static_cast<unsigned char>(input.ch))) {
         search_buffer.reserve(search_buffer.length() + 1);
-        search_buffer.push_back(c);
+        search_buffer.push_back(input.ch);
         search_cursor++;
     }
 
@@ -121,4 +126,21 @@ void UIState::update_search_buffer (char c) {
 
 // int UIState::add_results_scroll (int offset) {
 //     set_results_scroll(file_scroll + offset);
-// }
\ No newline at end of file
+// }
+
+void UIState::publish_results (SearchUpdate &&update) {
+    std::lock_guard<std::mutex> lock(results_mutex);
+    if (update.generation != search_generation) {
+        return;
+    }
+    files = std::move(update.hits);
+    num_matches = update.num_matches;
+    facets = std::move(update.facets);
+    results_final = update.final;
+    file_scroll = 0;
+
+    // a full queue already holds an event that wakes the ui thread
+    struct InputEvent event;
+    event.type = INPUT_RESULTS;
+    control_queue->try_push(event);
+}
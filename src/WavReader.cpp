@@ -0,0 +1,140 @@
+#include "..\inc\WavReader.h"
+
+// WAV files are little endian
+static uint32_t read_u32 (const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint16_t read_u16 (const uint8_t *p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+bool WavReader::open (const std::string &path) {
+    fmt = WavFormat();
+    position = 0;
+    file.close();
+    file.clear();
+    file.open(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.seekg(0, std::ios::end);
+    uint64_t file_size = static_cast<uint64_t>(file.tellg());
+    file.seekg(0, std::ios::beg);
+
+    uint8_t header[12];
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+        memcmp(header, "RIFF", 4) != 0 || memcmp(header + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    // walk the chunks for fmt and data, in either order
+    bool have_fmt = false;
+    uint64_t data_bytes = 0;
+    uint64_t offset = sizeof(header);
+    while ((!have_fmt || fmt.data_offset == 0) && offset + 8 <= file_size) {
+        uint8_t chunk[8];
+        file.seekg(static_cast<std::streamoff>(offset));
+        if (!file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+            return false;
+        }
+        uint64_t size = read_u32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t body[40] = {0};
+            size_t n = static_cast<size_t>(std::min<uint64_t>(size, sizeof(body)));
+            if (n < 16 || !file.read(reinterpret_cast<char*>(body), n)) {
+                return false;
+            }
+            fmt.format = read_u16(body);
+            fmt.channels = read_u16(body + 2);
+            fmt.sample_rate = static_cast<int>(read_u32(body + 4));
+            fmt.block_align = read_u16(body + 12);
+            fmt.bits_per_sample = read_u16(body + 14);
+            // extensible files carry the real format tag in their sub format
+            if (fmt.format == WAV_FORMAT_EXTENSIBLE && n >= 26) {
+                fmt.format = read_u16(body + 24);
+            }
+            have_fmt = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            fmt.data_offset = offset + 8;
+            data_bytes = size;
+        }
+        // chunks are padded to an even size
+        offset += 8 + size + (size & 1);
+    }
+    if (!have_fmt || fmt.data_offset == 0 || fmt.channels <= 0) {
+        return false;
+    }
+
+    bool pcm = fmt.format == WAV_FORMAT_PCM && (fmt.bits_per_sample == 8 ||
+               fmt.bits_per_sample == 16 || fmt.bits_per_sample == 24 ||
+               fmt.bits_per_sample == 32);
+    bool floats = fmt.format == WAV_FORMAT_FLOAT && fmt.bits_per_sample == 32;
+    if ((!pcm && !floats) ||
+        fmt.block_align != fmt.channels * fmt.bits_per_sample / 8) {
+        return false;
+    }
+
+    // a truncated file has fewer frames than its data chunk claims
+    data_bytes = std::min(data_bytes, file_size -
+                          std::min(file_size, fmt.data_offset));
+    fmt.frames = data_bytes / fmt.block_align;
+    file.seekg(static_cast<std::streamoff>(fmt.data_offset));
+    return true;
+}
+
+float WavReader::sample (const uint8_t *p) const {
+    switch (fmt.bits_per_sample) {
+        case 8:
+            return static_cast<float>(static_cast<int>(p[0]) - 128) /
+                   static_cast<float>(128.);
+        case 16:
+            return static_cast<float>(static_cast<int16_t>(read_u16(p))) /
+                   static_cast<float>(32768.);
+        case 24: {
+            // sign extend from the top byte
+            int32_t value = static_cast<int32_t>(
+                (static_cast<uint32_t>(p[0]) << 8) |
+                (static_cast<uint32_t>(p[1]) << 16) |
+                (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+            return static_cast<float>(value) / static_cast<float>(8388608.);
+        }
+        default:
+            if (fmt.format == WAV_FORMAT_FLOAT) {
+                uint32_t bits = read_u32(p);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                return value;
+            }
+            return static_cast<float>(static_cast<int32_t>(read_u32(p))) /
+                   static_cast<float>(2147483648.);
+    }
+}
+
+size_t WavReader::read_mono (float *out, size_t n) {
+    const size_t bytes_per_sample = fmt.bits_per_sample / 8;
+    size_t done = 0;
+    n = static_cast<size_t>(std::min<uint64_t>(n, fmt.frames - position));
+    while (done < n) {
+        size_t frames = std::min<size_t>(WAV_READ_FRAMES, n - done);
+        raw.resize(frames * fmt.block_align);
+        if (!file.read(reinterpret_cast<char*>(raw.data()), raw.size())) {
+            break;
+        }
+        // sum the channels of each frame, then average, as make_mono() does
+        const uint8_t *p = raw.data();
+        for (size_t f = 0; f < frames; f++) {
+            float mono = 0.0f;
+            for (int ch = 0; ch < fmt.channels; ch++) {
+                mono += sample(p);
+                p += bytes_per_sample;
+            }
+            out[done + f] = mono / static_cast<size_t>(fmt.channels);
+        }
+        done += frames;
+    }
+    position += done;
+    return done;
+}
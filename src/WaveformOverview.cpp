@@ -0,0 +1,94 @@
+#include "../inc/WaveformOverview.h"
+
+// scale a sample in [-1, 1] to a signed byte
+static inline int8_t quantize (float value) {
+    float clamped = std::max(-1.0f, std::min(1.0f, value));
+    return static_cast<int8_t>(std::lround(clamped * 127.0f));
+}
+
+WaveformMap::WaveformMap (size_t total_samples) :
+    total_samples(total_samples),
+    bins(static_cast<int>(std::min<size_t>(OVERVIEW_MAX_BINS, 
+                                           std::max<size_t>(1, total_samples)))),
+    bin_min(bins, 0.0f),
+    bin_max(bins, 0.0f),
+    bin_sum_sq(bins, 0.0),
+    bin_count(bins, 0) {}
+
+void WaveformMap::accumulate (size_t start, const float *samples, 
+                              size_t num_samples) {
+    
+    for (size_t i = 0; i < num_samples; i++) {
+        size_t index = start + i;
+        if (index >= total_samples) [[unlikely]] {
+            return;
+        }
+        int bin = static_cast<int>(index * bins / total_samples);
+        float s = samples[i];
+        if (bin_count[bin] == 0) {
+            bin_min[bin] = s;
+            bin_max[bin] = s;
+        } else {
+            bin_min[bin] = std::min(bin_min[bin], s);
+            bin_max[bin] = std::max(bin_max[bin], s);
+        }
+        bin_sum_sq[bin] += s * s;
+        bin_count[bin]++;
+    }
+}
+
+WaveformOverview WaveformMap::pyramid (void) {
+    
+    WaveformOverview overview;
+    if (total_samples == 0) {
+        return overview;
+    }
+
+    // finest level straight from the accumulated bins
+    std::vector<float> lo = bin_min, hi = bin_max;
+    std::vector<double> sum_sq = bin_sum_sq;
+    std::vector<int> count = bin_count;
+
+    for (int level = 0; level < OVERVIEW_LEVELS; level++) {
+        int n = static_cast<int>(lo.size());
+        WaveformLevel out;
+        out.bins = n;
+        out.peaks.resize(n * OVERVIEW_BYTES_PER_BIN);
+        for (int b = 0; b < n; b++) {
+            float rms = count[b] ? std::sqrt(sum_sq[b] / count[b]) : 0.0f;
+            out.peaks[b * 3] = quantize(lo[b]);
+            out.peaks[b * 3 + 1] = quantize(hi[b]);
+            out.peaks[b * 3 + 2] = quantize(rms);
+        }
+        overview.push_back(std::move(out));
+
+        // merge OVERVIEW_LEVEL_STEP bins into one for the next level
+        if (n <= 1) {
+            break;
+        }
+        int next = (n + OVERVIEW_LEVEL_STEP - 1) / OVERVIEW_LEVEL_STEP;
+        std::vector<float> next_lo(next, 0.0f), next_hi(next, 0.0f);
+        std::vector<double> next_sum_sq(next, 0.0);
+        std::vector<int> next_count(next, 0);
+        for (int b = 0; b < n; b++) {
+            int m = b / OVERVIEW_LEVEL_STEP;
+            if (count[b] == 0) {
+                continue;
+            }
+            if (next_count[m] == 0) {
+                next_lo[m] = lo[b];
+                next_hi[m] = hi[b];
+            } else {
+                next_lo[m] = std::min(next_lo[m], lo[b]);
+                next_hi[m] = std::max(next_hi[m], hi[b]);
+            }
+            next_sum_sq[m] += sum_sq[b];
+            next_count[m] += count[b];
+        }
+        lo.swap(next_lo);
+        hi.swap(next_hi);
+        sum_sq.swap(next_sum_sq);
+        count.swap(next_count);
+    }
+    return overview;
+}
@@ -1,74 +1,155 @@
 // Project Inclusions
 #include "..\inc\SystemUtilities.h"
 #include "..\inc\Database.h"
-#include "..\inc\MKBDIO.h"
+#include "..\inc\TerminalInput.h"
 #include "..\inc\UI.h"
 #include "..\inc\ThreadSafeQueue.h"
 #include "..\inc\Scanner.h"
+#include "..\inc\Reanalyzer.h"
+#include "..\inc\SearchExecutor.h"
 
 // definitions
 namespace fs = std::filesystem;
 
-void fetch_results (sqlite3* db, UIState *ui_state) {
-    if (ui_state->search_exec) {
-        const std::string &query = ui_state->search_buffer;
-        ui_state->files = db_search_files_by_name(db, query);
-    }
-}
+// interactive searches run against the in-memory catalog on the search
+// executor's worker, so a slow query never holds up input or rendering
+// The loop sleeps until an event arrives: a key press or resize from the
+// terminal reader, or new results from the executor. Frames are drawn at
+// most every RENDER_FRAME_MS; events arriving in between are drawn together.
+void thread2 (Catalog *catalog, UIState *ui_state) {
+    SearchExecutor executor(catalog, UI_RESULT_ROWS, 
+        [ui_state](SearchUpdate &&update) {
+            ui_state->publish_results(std::move(update));
+        });
+    TerminalRenderer renderer;
+    const auto frame_interval = std::chrono::milliseconds(RENDER_FRAME_MS);
+    auto next_frame = std::chrono::steady_clock::now();
+    bool dirty = true;
 
-void thread1 (UIState *ui_state, MKBDIO *io_handle) {
-    while(1) {
-        for (int i=0; i<256; i++) {
-            if(io_handle->key_is_fresh(i) == true) {
-                io_handle->key_mark_unfresh(i);
-                ui_state->control_queue->push(io_handle->code_to_char(i));
+    while (true) {
+        if (!dirty) {
+            struct InputEvent input;
+            if (!ui_state->control_queue->pop(input)) {
+                break;
             }
+            ui_state->input_dispatch(input);
         }
-    }
-}
 
-void thread2 (sqlite3 *db, UIState *ui_state) {
-    while(1) {
-        ui_state->control_queue->start_producing();
-        Sleep(200);
-        while(ui_state->control_queue->is_producing()) {
-            ui_state->process_inputs();
-            if(ui_state->search_exec) {
-                fetch_results(db, ui_state);
-            }
-            std::system("cls");
-            render_ui(ui_state);
-            while (ui_state->control_queue->is_producing() && 
-                   ui_state->control_queue->empty()) {
-                Sleep(100);
-            }
+        std::this_thread::sleep_until(next_frame);
+        ui_state->process_inputs();
+        if(ui_state->search_exec) {
+            std::lock_guard<std::mutex> lock(ui_state->results_mutex);
+            ui_state->search_generation = executor.submit(
+                                            ui_state->search_buffer);
+            ui_state->results_final = false;
+            ui_state->search_exec = false;
         }
+        render_ui(ui_state, &renderer);
+        next_frame = std::chrono::steady_clock::now() + frame_interval;
+        dirty = false;
     }
 }
 
 int main (int argc, char* argv[]) {
+
+    // --snapshot <file>: start from a catalog snapshot of this database
+    // --export <file>: write a catalog snapshot after the scan and exit
+    // --explain <query>: run a structured query, print its plan and exit
+    // --decode-budget <MB>: memory for audio decoding (DECODE_BUDGET_MB)
+    std::string snapshot_path, export_path, explain_query;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--snapshot") == 0) {
+            snapshot_path = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0) {
+            export_path = argv[++i];
+        } else if (strcmp(argv[i], "--explain") == 0) {
+            explain_query = argv[++i];
+        } else if (strcmp(argv[i], "--decode-budget") == 0) {
+            long megabytes = strtol(argv[++i], nullptr, 10);
+            if (megabytes <= 0) {
+                panicf("Bad decode budget: %s\n", argv[i]);
+            }
+            decode_budget().set_limit(static_cast<size_t>(megabytes) << 20);
+        }
+    }
    
     // open the database
-    sqlite3* db = nullptr;
-    if (sqlite3_open("audio_files.db", &db) != SQLITE_OK) {
-        panicf("Cannot open database.\n");
+    Database database("audio_files.db");
+    Database *db = &database;
+
+    // restore the similarity index from the saved graph and the files
+    // analyzed since it was saved
+    SimilarityIndex similarity_index(TIMBRE_DIMS);
+    db->load_similarity_index(&similarity_index);
+    uint64_t saved_revision = similarity_index.revision();
+    auto save_similarity_index = [&]() {
+        if (similarity_index.revision() != saved_revision) {
+            db->save_similarity_index(&similarity_index);
+            saved_revision = similarity_index.revision();
+        }
+    };
+
+    // load the browsing columns into memory for interactive queries
+    // A snapshot is verified and mapped as is; only rows added since it was
+    // written are read from the database. A snapshot of another database,
+    // or one ahead of this one, is not used.
+    Catalog catalog;
+    if (!snapshot_path.empty() && 
+        !catalog.open_snapshot(snapshot_path, true, db->database_id())) {
+        fprintf(stderr, "Ignoring snapshot %s: unreadable, damaged or from "
+                "another database\n", snapshot_path.c_str());
+    }
+    if (!db->load_catalog(&catalog)) {
+        fprintf(stderr, "Ignoring snapshot %s: it has rows this database "
+                "doesn't\n", snapshot_path.c_str());
+    }
+
+    if (!explain_query.empty()) {
+        struct ParsedQuery parsed;
+        struct QueryPlan plan;
+        std::string error;
+        if (!parse_query(explain_query, &parsed, &error)) {
+            panicf("Bad query: %s\n", error.c_str());
+        }
+        size_t total;
+        for (uint32_t row : catalog.run_query(parsed, 10, &total, &plan)) {
+            printf("%s\n", catalog.path(row).c_str());
+        }
+        printf("%s", explain_plan(parsed, plan).c_str());
+        return EXIT_SUCCESS;
     }
-    db_initialize(db);
 
     // scan the files
     fprintf(stderr, "Scanning Files...\n");
     const std::string dir_path = "D:/Samples/Instruments/Keys";
-    int db_size_before = db_get_num_rows (db, "audio_files");
+    int db_size_before = db->get_num_rows("audio_files");
     auto start = std::chrono::high_resolution_clock::now();
-    scan_directory(db, dir_path);
+    scan_directory(db, dir_path, &similarity_index, &catalog);
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double, std::milli> duration = end - start;
-    int db_size_after = db_get_num_rows (db, "audio_files");
+    int db_size_after = db->get_num_rows("audio_files");
 
     // report results
     fprintf(stderr, "Files Scanned: %d\n", db_size_after - db_size_before);
     fprintf(stderr, "Scan duration: %f\n", duration.count() / 1000);
     fprintf(stderr, "Scan Performance: %f Files / Second\n", float(db_size_after - db_size_before) / (duration.count()/1000));
+    save_similarity_index();
+
+    if (!export_path.empty()) {
+        if (!catalog.write_snapshot(export_path, db->database_id())) {
+            panicf("Failed to write snapshot %s\n", export_path.c_str());
+        }
+        fprintf(stderr, "Snapshot written to %s\n", export_path.c_str());
+        return EXIT_SUCCESS;
+    }
+
+    // refresh files analyzed by older analyzer versions in the background,
+    // throttled so searches stay responsive
+    ReanalysisStop stop_reanalysis;
+    ReanalysisOptions reanalysis;
+    reanalysis.max_files_per_second = 50;
+    std::thread reanalyzer(&reanalyze_stale_files, db, &similarity_index,
+                           &catalog, std::cref(reanalysis), &stop_reanalysis);
 
     fprintf(stderr, "\rStarting in 3...");
     Sleep(1000);
@@ -78,21 +159,21 @@ int main (int argc, char* argv[]) {
     Sleep(1000);
     fprintf(stderr, "\r\n");
 
-    // // create the UI
-    // ui_hide_cursor();
-    // ThreadSafeQueue<char> queue;
-    // UIState *ui_state = new UIState;
-    // ui_state->control_queue = &queue;
-    // MKBDIO io_handle;
-    // std::thread t1(&thread1, ui_state, &io_handle);
-    // std::thread t2(&thread2, db, ui_state);
-    // t1.join();
-    // t2.join();
-
-    // // clean up and exit
-    // std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  
-    // delete ui_state->control_queue;
-    // delete ui_state;
+    // run the UI until Ctrl-Q closes the queue, or the terminal's input
+    // ends; the input reader restores the terminal when it goes
+    ThreadSafeQueue<struct InputEvent> queue;
+    UIState ui_state;
+    ui_state.control_queue = &queue;
+    {
+        TerminalInput input(&queue);
+        std::thread t2(&thread2, &catalog, &ui_state);
+        t2.join();
+    }
+
+    // clean up and exit
+    stop_reanalysis.request();
+    reanalyzer.join();
+    save_similarity_index();
     fprintf(stderr, "Successful Exit\n");
     return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef TEST_UTILITIES_H
+#define TEST_UTILITIES_H
+
+// Standard Library Inclusions
+#include <cstdio>
+#include <string>
+#include <filesystem>
+
+// Each test binary runs its checks top to bottom and exits nonzero if any
+// failed. A failed check is reported and the test carries on, so one run
+// lists every failure.
+
+inline int &test_failures (void) {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,       \
+                    __LINE__, #cond);                                    \
+            test_failures()++;                                           \
+        }                                                                \
+    } while (0)
+
+// report the test's outcome, returns its exit status
+inline int test_result (const char *name) {
+    if (test_failures() == 0) {
+        fprintf(stderr, "%s: passed\n", name);
+        return 0;
+    }
+    fprintf(stderr, "%s: %d checks failed\n", name, test_failures());
+    return 1;
+}
+
+// A path in the temp directory for a scratch file, with any file left there
+// by an earlier run removed, along with SQLite's -wal and -shm files
+inline std::string scratch_path (const std::string &name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::string str = path.string();
+    std::filesystem::remove(str);
+    std::filesystem::remove(str + "-wal");
+    std::filesystem::remove(str + "-shm");
+    return str;
+}
+
+#endif // TEST_UTILITIES_H
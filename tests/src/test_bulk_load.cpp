@@ -0,0 +1,131 @@
+// Standard Library Inclusions
+#include <random>
+#include <stdexcept>
+
+// Project Inclusions
+#include "..\..\inc\Database.h"
+#include "..\..\inc\Catalog.h"
+#include "..\..\inc\SimilarityIndex.h"
+#include "TestUtilities.h"
+
+// files first..last-1, each with a name, tags and a timbre
+static void insert_files (Database *db, int first, int last,
+                          SimilarityIndex *index, Catalog *catalog) {
+    std::mt19937 rng(first);
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    RecordBatch batch;
+    for (int i = first; i < last; i++) {
+        struct FileRecord file{};
+        file.file_name = "hit_" + std::to_string(i) + ".wav";
+        file.file_path = "/library/" + file.file_name;
+        file.duration = 500 + i;
+        file.auto_tags = (i % 2) ? "drum" : "drum perc";
+        file.num_auto_tags = (i % 2) ? 1 : 2;
+        file.timbre.resize(TIMBRE_DIMS);
+        for (float &x : file.timbre) {
+            x = value(rng);
+        }
+        batch.add(file);
+    }
+    db->insert_files({&batch}, index, catalog);
+}
+
+static void test_merge (void) {
+    Database db(scratch_path("test_bulk_load.db"));
+    SimilarityIndex index(TIMBRE_DIMS);
+    Catalog catalog;
+    insert_files(&db, 0, 10, &index, &catalog);
+
+    // staged rows stay out of the table, the catalog and the index
+    // until the merge
+    {
+        BulkLoad bulk_load(db, true);
+        insert_files(&db, 10, 200, &index, &catalog);
+        CHECK(db.get_num_rows("audio_files") == 10);
+        CHECK(db.get_file_id("/library/hit_50.wav") == -1);
+        CHECK(catalog.size() == 10 && index.size() == 10);
+        CHECK(bulk_load.finish());
+        CHECK(!bulk_load.finish());
+    }
+    CHECK(db.get_num_rows("audio_files") == 200);
+
+    // the merged rows follow the existing ids, and are loaded on top of
+    // what the catalog and index already hold
+    CHECK(db.get_file_id("/library/hit_10.wav") == 11);
+    CHECK(db.get_file_id("/library/hit_199.wav") == 200);
+    db.load_catalog(&catalog);
+    db.load_similarity_index(&index);
+    CHECK(catalog.size() == 200 && catalog.last_id() == 200);
+    CHECK(index.size() == 200 && index.last_id() == 200);
+    CHECK(catalog.path(150).find("hit_150.wav") != std::string::npos);
+
+    // tags and the full-text index cover the merged rows
+    CHECK(db.files_with_all_tags({"perc"}).size() == 100);
+    SearchPage page = db.search_files_by_name("hit_123", SearchCursor(), 10);
+    CHECK(page.hits.size() == 1 && page.hits[0].id == 124);
+
+    // a file already in the table is not staged twice
+    {
+        BulkLoad bulk_load(db, true);
+        insert_files(&db, 190, 210, nullptr, nullptr);
+    }
+    CHECK(db.get_num_rows("audio_files") == 210);
+
+    // a disabled guard leaves inserts direct
+    {
+        BulkLoad bulk_load(db, false);
+        insert_files(&db, 210, 220, &index, &catalog);
+        CHECK(catalog.size() == 220 - 10);
+        CHECK(!bulk_load.finish());
+    }
+}
+
+// the guard merges when the scan unwinds early
+static void test_unwind (void) {
+    Database db(scratch_path("test_bulk_load.db"));
+    try {
+        BulkLoad bulk_load(db, true);
+        insert_files(&db, 0, 50, nullptr, nullptr);
+        throw std::runtime_error("scan stopped");
+    } catch (const std::runtime_error &) {
+    }
+    CHECK(db.get_num_rows("audio_files") == 50);
+    CHECK(db.get_file_id("/library/hit_49.wav") == 50);
+}
+
+// staged rows of a process that stopped before the merge are merged the
+// next time the database opens
+static void test_recovery (void) {
+    std::string path = scratch_path("test_bulk_load.db");
+    {
+        Database db(path);
+        insert_files(&db, 0, 5, nullptr, nullptr);
+        db.begin_bulk_load();
+        insert_files(&db, 5, 80, nullptr, nullptr);
+    }
+    Database db(path);
+    CHECK(db.get_num_rows("audio_files") == 80);
+    CHECK(db.get_file_id("/library/hit_79.wav") == 80);
+    CHECK(db.files_with_all_tags({"perc"}).size() == 40);
+    SearchPage page = db.search_files_by_name("hit_42", SearchCursor(), 10);
+    CHECK(page.hits.size() == 1 && page.hits[0].id == 43);
+    Catalog catalog;
+    SimilarityIndex index(TIMBRE_DIMS);
+    db.load_catalog(&catalog);
+    db.load_similarity_index(&index);
+    CHECK(catalog.size() == 80 && index.size() == 80);
+
+    // and a new bulk load starts cleanly after the recovered one
+    {
+        BulkLoad bulk_load(db, true);
+        insert_files(&db, 80, 90, nullptr, nullptr);
+    }
+    CHECK(db.get_num_rows("audio_files") == 90);
+}
+
+int main (void) {
+    test_merge();
+    test_unwind();
+    test_recovery();
+    return test_result("test_bulk_load");
+}
@@ -0,0 +1,471 @@
+// Standard Library Inclusions
+#include <random>
+#include <set>
+#include <cctype>
+
+// Project Inclusions
+#include "..\..\inc\Catalog.h"
+#include "TestUtilities.h"
+
+#define NUM_ROWS 3000
+
+// enough rows that fuzzy scans are split into parallel slices
+#define NUM_PARALLEL_ROWS (FUZZY_PARALLEL_MIN_ROWS + 4000)
+
+// The catalog's searches checked against brute force over the same rows.
+// Names come from a small alphabet so trigrams are shared by many rows.
+
+struct Row {
+    std::string dir;
+    std::string name;
+    std::vector<std::string> tags;
+    int duration;
+    int key;
+    int bpm;
+};
+
+static const char *TAG_WORDS[] = {"drum", "kick", "snare", "synth", "pad",
+                                  "bass", "analog", "vocal", "loop", "fx"};
+
+static std::vector<Row> make_rows (size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    const std::string alphabet = "abcdeKLM_ 01";
+    std::uniform_int_distribution<size_t> letter(0, alphabet.size() - 1);
+    std::uniform_int_distribution<int> length(1, 14);
+    std::uniform_int_distribution<int> tag(0, 9);
+    std::uniform_int_distribution<int> num_tags(0, 3);
+    std::uniform_int_distribution<int> key(-1, 11);
+    std::uniform_int_distribution<int> bpm(0, 200);
+    std::uniform_int_distribution<int> duration(0, 20000);
+    std::vector<Row> rows(n);
+    for (size_t i = 0; i < n; i++) {
+        Row &row = rows[i];
+        row.dir = "/library/Pack_" + std::to_string(i % 7);
+        for (int c = length(rng); c > 0; c--) {
+            row.name += alphabet[letter(rng)];
+        }
+        row.name += ".wav";
+        for (int t = num_tags(rng); t > 0; t--) {
+            std::string word = TAG_WORDS[tag(rng)];
+            if (std::find(row.tags.begin(), row.tags.end(), word) ==
+                row.tags.end()) {
+                row.tags.push_back(word);
+            }
+        }
+        row.duration = duration(rng);
+        row.key = key(rng);
+        row.bpm = bpm(rng);
+    }
+    return rows;
+}
+
+static void insert_rows (Catalog *catalog, const std::vector<Row> &rows,
+                         size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        const Row &row = rows[i];
+        std::string tags;
+        for (const std::string &tag : row.tags) {
+            tags += (tags.empty() ? "" : " ") + tag;
+        }
+        catalog->insert(static_cast<int64_t>(i) + 1, i % 7, row.dir, row.name,
+                        static_cast<int64_t>(i), row.duration, row.key,
+                        row.bpm, tags);
+    }
+}
+
+static std::string lower (std::string str) {
+    for (char &c : str) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return str;
+}
+
+// does text hold a substring within max_edits (0 or 1) edits of needle:
+// the edit distance of needle to its best aligned substring of text
+static bool within_edits (const std::string &text, const std::string &needle,
+                          int max_edits) {
+    std::vector<int> prev(text.size() + 1, 0), cur(text.size() + 1);
+    for (size_t i = 1; i <= needle.size(); i++) {
+        cur[0] = static_cast<int>(i);
+        for (size_t j = 1; j <= text.size(); j++) {
+            int sub = prev[j - 1] + (needle[i - 1] != text[j - 1]);
+            cur[j] = std::min({sub, prev[j] + 1, cur[j - 1] + 1});
+        }
+        prev.swap(cur);
+    }
+    return *std::min_element(prev.begin(), prev.end()) <= max_edits;
+}
+
+// rows text_search should return, in row order
+static std::vector<uint32_t> text_matches (const std::vector<Row> &rows,
+                                           const std::string &needle,
+                                           int max_edits) {
+    std::string folded = lower(needle);
+    std::vector<uint32_t> matches;
+    if (folded.empty()) {
+        return matches;
+    }
+    int allowed = (folded.size() >= TRIGRAM_FUZZY_MIN_LENGTH) ? max_edits : 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        bool match = within_edits(lower(rows[i].name), folded, allowed);
+        for (const std::string &tag : rows[i].tags) {
+            match = match || within_edits(tag, folded, allowed);
+        }
+        if (match) {
+            matches.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return matches;
+}
+
+// needles cut from the names, some with a typo, and a few that match nothing
+static std::vector<std::string> make_needles (const std::vector<Row> &rows,
+                                              unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> needles = {"", "a", "K", "ab", "zzz", "kick",
+                                        "snar", "synht", "Analog", "wav"};
+    for (int i = 0; i < 60; i++) {
+        const std::string &name = rows[rng() % rows.size()].name;
+        size_t length = 1 + rng() % 6;
+        size_t start = rng() % name.size();
+        std::string needle = name.substr(start, length);
+        if (i % 3 == 0 && needle.size() >= 4) {
+            needle[needle.size() / 2] = 'x';
+        }
+        needles.push_back(needle);
+    }
+    return needles;
+}
+
+static void check_text_search (const Catalog &catalog,
+                               const std::vector<Row> &rows,
+                               const std::vector<std::string> &needles) {
+    for (const std::string &needle : needles) {
+        for (int edits : {0, 1}) {
+            std::vector<uint32_t> expected = text_matches(rows, needle, edits);
+            size_t total = 0;
+            std::vector<uint32_t> found = catalog.text_search(needle, edits,
+                                                              SIZE_MAX, &total);
+            CHECK(total == found.size());
+            std::sort(found.begin(), found.end());
+            if (found != expected) {
+                fprintf(stderr, "text_search(\"%s\", %d): %zu rows, "
+                        "expected %zu\n", needle.c_str(), edits, found.size(),
+                        expected.size());
+            }
+            CHECK(found == expected);
+        }
+    }
+
+    // a limit keeps the best ranked rows: exact matches before typos
+    size_t total = 0;
+    std::vector<uint32_t> top = catalog.text_search("snar", 1, 5, &total);
+    CHECK(top.size() == 5 && total > 5);
+    for (uint32_t row : top) {
+        bool exact = lower(rows[row].name).find("snar") != std::string::npos;
+        for (const std::string &tag : rows[row].tags) {
+            exact = exact || tag.find("snar") != std::string::npos;
+        }
+        CHECK(exact);
+    }
+}
+
+// the trigram index answers from inserted rows, from a mapped snapshot, and
+// from a snapshot with rows appended to its viewed lists
+static void test_text_search (void) {
+    std::vector<Row> rows = make_rows(NUM_ROWS, 1);
+    std::vector<std::string> needles = make_needles(rows, 2);
+
+    Catalog catalog;
+    insert_rows(&catalog, rows, 0, NUM_ROWS - 500);
+    std::vector<Row> head(rows.begin(), rows.end() - 500);
+    check_text_search(catalog, head, needles);
+
+    std::string path = scratch_path("test_catalog_search.cat");
+    CHECK(catalog.write_snapshot(path, 1));
+    Catalog mapped;
+    CHECK(mapped.open_snapshot(path, true, 1));
+    check_text_search(mapped, head, needles);
+
+    insert_rows(&mapped, rows, NUM_ROWS - 500, NUM_ROWS);
+    check_text_search(mapped, rows, needles);
+    insert_rows(&catalog, rows, NUM_ROWS - 500, NUM_ROWS);
+    for (const std::string &needle : needles) {
+        size_t total = 0, mapped_total = 0;
+        CHECK(mapped.text_search(needle, 1, 20, &mapped_total) ==
+              catalog.text_search(needle, 1, 20, &total));
+    }
+}
+
+// is pattern a subsequence of text
+static bool subsequence (const std::string &text, const std::string &pattern) {
+    size_t p = 0;
+    for (size_t i = 0; i < text.size() && p < pattern.size(); i++) {
+        if (text[i] == pattern[p]) {
+            p++;
+        }
+    }
+    return p == pattern.size();
+}
+
+// rows whose folded name contains the folded pattern as a subsequence
+static std::vector<uint32_t> fuzzy_matches (const std::vector<Row> &rows,
+                                            const std::string &pattern) {
+    std::vector<uint32_t> matches;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (subsequence(lower(rows[i].name), lower(pattern))) {
+            matches.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return matches;
+}
+
+// the best k of every match, scored one by one: higher score first, then
+// the newer row
+static std::vector<FuzzyHit> best_fuzzy (const std::vector<Row> &rows,
+                                         const std::vector<uint32_t> &matches,
+                                         const std::string &pattern, size_t k) {
+    std::vector<FuzzyHit> hits;
+    for (uint32_t row : matches) {
+        int score;
+        CHECK(fuzzy_score(rows[row].name, lower(rows[row].name), lower(pattern),
+                          &score));
+        score += static_cast<int>(FUZZY_RECENCY_BONUS * (row + 1) / rows.size());
+        hits.push_back({row, score});
+    }
+    std::sort(hits.begin(), hits.end(), [](const FuzzyHit &a, const FuzzyHit &b) {
+        return (a.score != b.score) ? a.score > b.score : a.row > b.row;
+    });
+    if (hits.size() > k) {
+        hits.resize(k);
+    }
+    return hits;
+}
+
+static void check_fuzzy (const Catalog &catalog, const std::vector<Row> &rows,
+                         const std::vector<std::string> &patterns) {
+    for (const std::string &pattern : patterns) {
+        std::vector<uint32_t> expected = fuzzy_matches(rows, pattern);
+        size_t end_row;
+        std::vector<uint32_t> found = catalog.fuzzy_rows(pattern, 0, &end_row);
+        CHECK(end_row == rows.size());
+        if (found != expected) {
+            fprintf(stderr, "fuzzy_rows(\"%s\"): %zu rows, expected %zu\n",
+                    pattern.c_str(), found.size(), expected.size());
+        }
+        CHECK(found == expected);
+
+        // chunked scans pick up where the last chunk ended
+        std::vector<uint32_t> chunked;
+        for (size_t first = 0; first < rows.size(); first = end_row) {
+            std::vector<uint32_t> chunk = catalog.fuzzy_rows(pattern, first,
+                                                             &end_row, 777);
+            CHECK(end_row > first);
+            chunked.insert(chunked.end(), chunk.begin(), chunk.end());
+        }
+        CHECK(chunked == expected);
+
+        // refining every row, or a previous pattern's rows, gives the same
+        std::vector<uint32_t> all(rows.size());
+        for (size_t i = 0; i < all.size(); i++) {
+            all[i] = static_cast<uint32_t>(i);
+        }
+        CHECK(catalog.refine_fuzzy(all, pattern) == expected);
+        std::vector<uint32_t> prefix = catalog.fuzzy_rows(pattern.substr(0, 1),
+                                                          0, &end_row);
+        CHECK(catalog.refine_fuzzy(prefix, pattern) == expected);
+
+        for (size_t k : {1, 10, 100}) {
+            std::vector<FuzzyHit> best = catalog.rank_fuzzy(expected, pattern, k);
+            std::vector<FuzzyHit> truth = best_fuzzy(rows, expected, pattern, k);
+            CHECK(best.size() == truth.size());
+            for (size_t i = 0; i < best.size() && i < truth.size(); i++) {
+                CHECK(best[i].row == truth[i].row && 
+                      best[i].score == truth[i].score);
+            }
+        }
+
+        // rows that don't match are skipped when ranking
+        std::vector<FuzzyHit> best = catalog.rank_fuzzy(all, pattern, 10);
+        std::vector<FuzzyHit> truth = best_fuzzy(rows, expected, pattern, 10);
+        CHECK(best.size() == truth.size());
+        for (size_t i = 0; i < best.size() && i < truth.size(); i++) {
+            CHECK(best[i].row == truth[i].row);
+        }
+    }
+}
+
+static void test_fuzzy (void) {
+    std::vector<std::string> patterns = {"a", "K0", "abc", "dkl_1", "e.wav",
+                                         "aaaaa", "mmm0", "x", "Lc d", "ewv"};
+
+    std::vector<Row> rows = make_rows(NUM_ROWS, 3);
+    Catalog catalog;
+    insert_rows(&catalog, rows, 0, NUM_ROWS);
+    check_fuzzy(catalog, rows, patterns);
+
+    // the character masks of a mapped snapshot prefilter the same rows
+    std::string path = scratch_path("test_catalog_search.cat");
+    CHECK(catalog.write_snapshot(path, 1));
+    Catalog mapped;
+    CHECK(mapped.open_snapshot(path, true, 1));
+    check_fuzzy(mapped, rows, patterns);
+
+    // large scans and rankings run in parallel slices
+    std::vector<Row> many = make_rows(NUM_PARALLEL_ROWS, 4);
+    Catalog large;
+    insert_rows(&large, many, 0, NUM_PARALLEL_ROWS);
+    check_fuzzy(large, many, {"abc", "K0_e", "dkl_1"});
+}
+
+// does a row match a parsed term, by its definition in QueryLanguage.h
+static bool term_matches (const Row &row, const struct QueryTerm &term) {
+    bool match = false;
+    switch (term.kind) {
+    case TERM_TEXT:
+        match = lower(row.name).find(term.text) != std::string::npos;
+        break;
+    case TERM_TAG:
+        match = std::find(row.tags.begin(), row.tags.end(), term.text) !=
+                row.tags.end();
+        break;
+    case TERM_KEY:
+        match = row.key == term.lo;
+        break;
+    case TERM_BPM:
+        for (double bpm : {row.bpm * 1.0, row.bpm * 2.0, row.bpm / 2.0}) {
+            match = match || (row.bpm > 0 && bpm >= term.lo &&
+                              bpm <= term.hi && 
+                              (term.half_double || bpm == row.bpm));
+        }
+        break;
+    case TERM_DURATION:
+        match = row.duration > 0 && row.duration >= term.lo && 
+                row.duration <= term.hi;
+        break;
+    case TERM_PATH:
+        match = (lower(row.dir) + "/").find(term.text) != std::string::npos;
+        break;
+    }
+    return match != term.negated;
+}
+
+static void check_queries (const Catalog &catalog, const std::vector<Row> &rows,
+                           const std::vector<std::string> &queries) {
+    for (const std::string &query : queries) {
+        struct ParsedQuery parsed;
+        std::string error;
+        CHECK(parse_query(query, &parsed, &error));
+
+        std::vector<uint32_t> expected;
+        struct FacetCounts expected_facets;
+        for (size_t i = 0; i < rows.size(); i++) {
+            bool match = true;
+            for (const struct QueryTerm &term : parsed.terms) {
+                match = match && term_matches(rows[i], term);
+            }
+            if (match) {
+                expected.push_back(static_cast<uint32_t>(i));
+                expected_facets.keys[rows[i].key]++;
+                expected_facets.bpm_buckets[(rows[i].bpm > 0) ? 
+                    rows[i].bpm / FACET_BPM_BUCKET : -1]++;
+            }
+        }
+        expected_facets.total = static_cast<int64_t>(expected.size());
+
+        size_t total = 0;
+        struct QueryPlan plan;
+        struct FacetCounts facets;
+        std::vector<uint32_t> found = catalog.run_query(parsed, SIZE_MAX,
+                                                        &total, &plan, &facets);
+        if (found != expected) {
+            fprintf(stderr, "run_query(\"%s\"): %zu rows, expected %zu\n",
+                    query.c_str(), found.size(), expected.size());
+        }
+        CHECK(found == expected);
+        CHECK(total == expected.size());
+
+        // every term is one stage, after a stage of every row if no term
+        // drives the plan; each stage filters the one before
+        bool all_rows = !plan.stages.empty() && plan.stages[0].term < 0;
+        CHECK(plan.stages.size() == parsed.terms.size() + all_rows);
+        for (size_t s = 1; s < plan.stages.size(); s++) {
+            CHECK(plan.stages[s].rows_in == plan.stages[s - 1].rows_out);
+            CHECK(plan.stages[s].rows_out <= plan.stages[s].rows_in);
+        }
+        CHECK(!plan.stages.empty() && plan.stages.back().rows_out == total);
+
+        // facets count every match, not just the rows returned
+        CHECK(facets.total == expected_facets.total);
+        CHECK(facets.keys == expected_facets.keys);
+        CHECK(facets.bpm_buckets == expected_facets.bpm_buckets);
+        struct FacetCounts limited;
+        std::vector<uint32_t> first = catalog.run_query(parsed, 3, &total,
+                                                        nullptr, &limited);
+        CHECK(first.size() == std::min<size_t>(3, expected.size()));
+        CHECK(std::equal(first.begin(), first.end(), expected.begin()));
+        CHECK(total == expected.size());
+        CHECK(limited.keys == expected_facets.keys);
+    }
+}
+
+// whatever term drives the plan, the rows are those matching every term
+static void test_planner (void) {
+    std::vector<Row> rows = make_rows(NUM_ROWS, 5);
+    std::vector<std::string> queries = {
+        "", "abc", "ab", "a b", "tag:kick", "tag:tuba", "-tag:kick",
+        "key:C", "key:Am", "-key:D", "bpm:120", "bpm:100-140", "bpm:>190",
+        "bpm:<=20", "dur:<2s", "dur:5-10s", "dur:>=15000ms", "path:pack_3",
+        "path:PACK_3/", "path:library/", "path:nowhere",
+        "abc tag:drum", "k tag:snare key:G", "tag:synth tag:pad",
+        "tag:loop -tag:fx bpm:60-180", "0a -ab dur:1-12s", "\"e k\"",
+        "tag:kick key:F# bpm:>=90 dur:<10s path:pack_", "-abc -tag:bass",
+        "ee path:pack_1 -key:C", "M1 -bpm:100-200", "bpm:~120-128",
+        "bpm:~>150", "bpm:~95", "-bpm:~60-90 tag:pad",
+    };
+
+    Catalog catalog;
+    insert_rows(&catalog, rows, 0, NUM_ROWS);
+    check_queries(catalog, rows, queries);
+
+    std::string path = scratch_path("test_catalog_search.cat");
+    CHECK(catalog.write_snapshot(path, 1));
+    Catalog mapped;
+    CHECK(mapped.open_snapshot(path, true, 1));
+    check_queries(mapped, rows, queries);
+
+    // the most selective positive term drives, and negated terms only filter
+    struct ParsedQuery parsed;
+    std::string error;
+    struct QueryPlan plan;
+    size_t total;
+    CHECK(parse_query("bpm:0-200 tag:tuba", &parsed, &error));
+    catalog.run_query(parsed, SIZE_MAX, &total, &plan);
+    CHECK(plan.stages[0].access == ACCESS_TAG_POSTINGS && total == 0);
+    CHECK(parse_query("-tag:kick abc", &parsed, &error));
+    catalog.run_query(parsed, SIZE_MAX, &total, &plan);
+    CHECK(plan.stages[0].access == ACCESS_TRIGRAMS);
+    CHECK(parse_query("-tag:kick ab", &parsed, &error));
+    catalog.run_query(parsed, SIZE_MAX, &total, &plan);
+    CHECK(plan.stages[0].access == ACCESS_ALL_ROWS);
+
+    // a cancelled query returns no rows and stops before its filter stages
+    std::atomic<bool> cancel(false);
+    FacetCounts facets;
+    CHECK(parse_query("bpm:>0 -tag:fx path:library", &parsed, &error));
+    size_t expected = catalog.run_query(parsed, SIZE_MAX, &total).size();
+    CHECK(expected > 0 && total == expected);
+    CHECK(catalog.run_query(parsed, SIZE_MAX, &total, nullptr, &facets,
+                            &cancel).size() == expected);
+    cancel = true;
+    CHECK(catalog.run_query(parsed, SIZE_MAX, &total, &plan, &facets,
+                            &cancel).empty());
+    CHECK(total == 0 && facets.total == 0 && plan.stages.size() == 1);
+}
+
+int main (void) {
+    test_text_search();
+    test_fuzzy();
+    test_planner();
+    return test_result("test_catalog_search");
+}
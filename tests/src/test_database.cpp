@@ -0,0 +1,146 @@
+// Standard Library Inclusions
+#include <set>
+#include <algorithm>
+
+// Project Inclusions
+#include "..\..\inc\Database.h"
+#include "..\..\inc\SimilarityIndex.h"
+#include "TestUtilities.h"
+
+#define NUM_LOOPS 21
+
+// a record with a name, auto tags, and optionally a timbre of all value
+static struct FileRecord make_file (const std::string &name,
+                                    const std::string &tags, float value) {
+    struct FileRecord file{};
+    file.file_name = name;
+    file.file_path = "/library/" + name;
+    file.duration = 1000;
+    file.auto_tags = tags;
+    file.num_auto_tags = static_cast<int>(
+        std::count(tags.begin(), tags.end(), ' ') + 1);
+    if (value != 0.0f) {
+        file.timbre.assign(TIMBRE_DIMS, value);
+    }
+    return file;
+}
+
+// a level of bins bins, each bin's peaks set to its level's bin count
+static WaveformLevel make_level (int bins) {
+    WaveformLevel level;
+    level.bins = bins;
+    level.peaks.assign(bins * 3, static_cast<int8_t>(bins % 100));
+    return level;
+}
+
+static void fill (Database *db, SimilarityIndex *index) {
+    RecordBatch batch;
+    struct FileRecord kick = make_file("kick_hard.wav", "drum kick", 1.0f);
+    kick.overview = {make_level(1024), make_level(256), make_level(64)};
+    batch.add(kick);
+    batch.add(make_file("kick_soft.wav", "drum kick soft", 1.1f));
+    batch.add(make_file("snare_hard.wav", "drum snare", 5.0f));
+    batch.add(make_file("pad_warm.wav", "synth pad", 0.0f));
+    for (int i = 0; i < NUM_LOOPS; i++) {
+        batch.add(make_file("kick_loop_" + std::to_string(i) + ".wav", "loop",
+                            0.0f));
+    }
+    db->insert_files({&batch}, index, nullptr);
+}
+
+// every page of a name search, checking each page's size
+static std::vector<int64_t> all_pages (Database *db, const std::string &query,
+                                       int page_size) {
+    std::vector<int64_t> ids;
+    SearchCursor cursor;
+    while (true) {
+        SearchPage page = db->search_files_by_name(query, cursor, page_size);
+        CHECK(static_cast<int>(page.hits.size()) <= page_size);
+        for (const SearchHit &hit : page.hits) {
+            ids.push_back(hit.id);
+        }
+        if (!page.has_more) {
+            break;
+        }
+        CHECK(static_cast<int>(page.hits.size()) == page_size);
+        cursor = page.next;
+    }
+    return ids;
+}
+
+static void test_search_by_name (Database *db) {
+    // paging visits every match once
+    std::vector<int64_t> ids = all_pages(db, "kick", 5);
+    CHECK(ids.size() == 2 + NUM_LOOPS);
+    CHECK(std::set<int64_t>(ids.begin(), ids.end()).size() == ids.size());
+    CHECK(all_pages(db, "kick", 100) == ids);
+
+    // every word has to match, as a prefix
+    CHECK(all_pages(db, "kick hard", 5) == std::vector<int64_t>{1});
+    CHECK(all_pages(db, "sna", 5) == std::vector<int64_t>{3});
+    CHECK(all_pages(db, "", 5).empty());
+    CHECK(all_pages(db, "tuba", 5).empty());
+
+    SearchPage page = db->search_files_by_name("pad", SearchCursor(), 5);
+    CHECK(page.hits.size() == 1 && page.hits[0].file_name == "pad_warm.wav");
+    CHECK(page.hits[0].duration == 1000);
+}
+
+static void test_overview (Database *db) {
+    // the coarsest level at least as wide as the display, else the finest
+    WaveformLevel level;
+    CHECK(db->fetch_overview(1, 200, &level) && level.bins == 256);
+    CHECK(level.peaks.size() == 256 * 3 && level.max(0) == 56);
+    CHECK(db->fetch_overview(1, 10, &level) && level.bins == 64);
+    CHECK(db->fetch_overview(1, 5000, &level) && level.bins == 1024);
+    CHECK(!db->fetch_overview(2, 200, &level));
+}
+
+static void test_tags (Database *db) {
+    CHECK(db->files_with_all_tags({"drum", "kick"}) ==
+          (std::vector<int64_t>{1, 2}));
+    CHECK(db->files_with_all_tags({"drum", "tuba"}).empty());
+    CHECK(db->files_with_any_tags({"snare", "pad"}) ==
+          (std::vector<int64_t>{3, 4}));
+    CHECK(db->files_with_any_tags({"tuba", "snare"}) ==
+          std::vector<int64_t>{3});
+    CHECK(db->files_with_any_tags({"loop"}).size() == NUM_LOOPS);
+
+    // most used first, ties by name
+    auto frequencies = db->tag_frequencies("", 3);
+    CHECK(frequencies.size() == 3);
+    CHECK(frequencies[0] == std::make_pair(std::string("loop"), NUM_LOOPS));
+    CHECK(frequencies[1] == std::make_pair(std::string("drum"), 3));
+    CHECK(frequencies[2] == std::make_pair(std::string("kick"), 2));
+    CHECK(db->tag_frequencies("s", 10) ==
+          (std::vector<std::pair<std::string, int>>{{"snare", 1}, {"soft", 1},
+                                                    {"synth", 1}}));
+    CHECK(db->tag_frequencies("x", 10).empty());
+}
+
+static void test_files (Database *db, const SimilarityIndex *index) {
+    struct FileRecord file;
+    CHECK(db->get_file(2, &file));
+    CHECK(file.file_name == "kick_soft.wav" && file.auto_tags == "drum kick soft");
+    CHECK(!db->get_file(1000, &file));
+    CHECK(db->get_file_id("/library/snare_hard.wav") == 3);
+    CHECK(db->get_file_id("/library/tuba.wav") == -1);
+
+    std::vector<FileRecord> similar =
+        db->find_similar_files(index, "/library/kick_hard.wav", 2);
+    CHECK(similar.size() == 2);
+    CHECK(similar.size() == 2 && similar[0].file_name == "kick_soft.wav");
+    CHECK(similar.size() == 2 && similar[1].file_name == "snare_hard.wav");
+    CHECK(db->find_similar_files(index, "/library/tuba.wav", 2).empty());
+}
+
+int main (void) {
+    Database db(scratch_path("test_database.db"));
+    SimilarityIndex index(TIMBRE_DIMS);
+    fill(&db, &index);
+    test_search_by_name(&db);
+    test_overview(&db);
+    test_tags(&db);
+    test_files(&db, &index);
+    return test_result("test_database");
+}
@@ -0,0 +1,135 @@
+// Standard Library Inclusions
+#include <string>
+#include <vector>
+
+// Project Inclusions
+#include "..\..\inc\TerminalInput.h"
+#include "TestUtilities.h"
+
+static bool same (const struct InputEvent &a, const struct InputEvent &b) {
+    return a.type == b.type && a.key == b.key && a.ch == b.ch &&
+           a.modifiers == b.modifiers;
+}
+
+static struct InputEvent key (InputKey k, char ch = 0, uint8_t modifiers = 0) {
+    struct InputEvent event;
+    event.key = k;
+    event.ch = ch;
+    event.modifiers = modifiers;
+    return event;
+}
+
+// the events of bytes fed in one piece, then flushed
+static std::vector<struct InputEvent> decode (const std::string &bytes) {
+    InputDecoder decoder;
+    std::vector<struct InputEvent> events;
+    decoder.feed(bytes.data(), bytes.size(), &events);
+    decoder.flush(&events);
+    return events;
+}
+
+static bool decodes_to (const std::string &bytes,
+                        const std::vector<struct InputEvent> &expected) {
+    std::vector<struct InputEvent> events = decode(bytes);
+    if (events.size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        if (!same(events[i], expected[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fn
+static InputKey function_key (int n) {
+    return static_cast<InputKey>(KEY_F1 + n - 1);
+}
+
+static void test_keys (void) {
+    CHECK((decodes_to("ab", {key(KEY_CHAR, 'a'), key(KEY_CHAR, 'b')})));
+    CHECK((decodes_to("\r\t\x7f", {key(KEY_ENTER), key(KEY_TAB),
+                                   key(KEY_BACKSPACE)})));
+    CHECK((decodes_to("\x13", {key(KEY_CHAR, 's', MOD_CTRL)})));
+    CHECK((decodes_to("\x1b", {key(KEY_ESCAPE)})));
+    CHECK((decodes_to("\x1bx", {key(KEY_CHAR, 'x', MOD_ALT)})));
+
+    // CSI and SS3 sequences, with xterm modifiers
+    CHECK((decodes_to("\x1b[A\x1b[B", {key(KEY_UP), key(KEY_DOWN)})));
+    CHECK((decodes_to("\x1b[1;5C", {key(KEY_RIGHT, 0, MOD_CTRL)})));
+    CHECK((decodes_to("\x1b[3~", {key(KEY_DELETE)})));
+    CHECK((decodes_to("\x1b[15;2~", {key(function_key(5), 0, MOD_SHIFT)})));
+    CHECK((decodes_to("\x1b[24~", {key(function_key(12))})));
+    CHECK((decodes_to("\x1b[Z", {key(KEY_TAB, 0, MOD_SHIFT)})));
+    CHECK((decodes_to("\x1bOP\x1bOH", {key(KEY_F1), key(KEY_HOME)})));
+
+    // unknown sequences are dropped whole, and what follows still decodes
+    CHECK((decodes_to("\x1b[200~a\x1b[5mb", {key(KEY_CHAR, 'a'),
+                                             key(KEY_CHAR, 'b')})));
+
+    // an escape and a bracket at the end of input are Alt-[, not a sequence
+    CHECK((decodes_to("\x1b[", {key(KEY_CHAR, '[', MOD_ALT)})));
+    CHECK((decodes_to("\x1bO", {key(KEY_CHAR, 'O', MOD_ALT)})));
+}
+
+// huge parameters are clamped instead of overflowing, and only the defined
+// modifier bits are kept
+static void test_long_parameters (void) {
+    std::string digits(40, '9');
+    CHECK((decodes_to("\x1b[" + digits + ";" + digits + "~z",
+                      {key(KEY_CHAR, 'z')})));
+    uint8_t modifiers = (INPUT_MAX_PARAM - 1) & (MOD_SHIFT | MOD_ALT | MOD_CTRL);
+    CHECK((decodes_to("\x1b[1;" + digits + "A", {key(KEY_UP, 0, modifiers)})));
+}
+
+// Sequences split across reads are kept until the rest arrives; any split
+// of a stream gives the events of the whole stream
+static void test_split (void) {
+    InputDecoder decoder;
+    std::vector<struct InputEvent> events;
+    decoder.feed("\x1b", 1, &events);
+    CHECK(events.empty() && decoder.pending());
+    decoder.feed("[1;", 3, &events);
+    CHECK(events.empty() && decoder.pending());
+    decoder.feed("5Dq", 3, &events);
+    CHECK(events.size() == 2 && !decoder.pending());
+    CHECK(events.size() == 2 && same(events[0], key(KEY_LEFT, 0, MOD_CTRL)) &&
+          same(events[1], key(KEY_CHAR, 'q')));
+
+    // a lone escape waits for flush, which makes it a key
+    events.clear();
+    decoder.feed("\x1b", 1, &events);
+    CHECK(events.empty());
+    decoder.flush(&events);
+    CHECK(events.size() == 1 && same(events[0], key(KEY_ESCAPE)));
+    CHECK(!decoder.pending());
+
+    const std::string stream = "a\x1b[A\x1b[15;3~\x1bOQ\x1bz\x13\x1b[3~\r"
+                               "\x1b[1;2H\x1b[Z\x7f" "b";
+    std::vector<struct InputEvent> whole = decode(stream);
+    CHECK(whole.size() == 12);
+    for (size_t cut = 1; cut < stream.size(); cut++) {
+        for (size_t step : {cut, static_cast<size_t>(1)}) {
+            InputDecoder pieces;
+            std::vector<struct InputEvent> split;
+            for (size_t pos = 0; pos < stream.size(); pos += step) {
+                size_t n = std::min(step, stream.size() - pos);
+                pieces.feed(stream.data() + pos, n, &split);
+            }
+            pieces.flush(&split);
+            bool equal = split.size() == whole.size();
+            for (size_t i = 0; equal && i < split.size(); i++) {
+                equal = same(split[i], whole[i]);
+            }
+            CHECK(equal);
+        }
+    }
+}
+
+int main (void) {
+    test_keys();
+    test_long_parameters();
+    test_split();
+    return test_result("test_input_decoder");
+}
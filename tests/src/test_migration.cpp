@@ -0,0 +1,170 @@
+// Standard Library Inclusions
+#include <filesystem>
+
+// Project Inclusions
+#include "..\..\inc\Database.h"
+#include "..\..\inc\Catalog.h"
+#include "TestUtilities.h"
+
+namespace fs = std::filesystem;
+
+// A version 6 database as the migrations up to 6 left it: one file_path per
+// row, with the full-text index, tags and overviews keyed by row id. Ids
+// have gaps, as they do after deletes.
+static const char* V6_SCHEMA =
+    "CREATE TABLE audio_files ("\
+        "id INTEGER PRIMARY KEY AUTOINCREMENT,"\
+        "file_path TEXT UNIQUE,"\
+        "file_name TEXT NOT NULL,"\
+        "file_size INTEGER,"\
+        "duration REAL,"\
+        "num_user_tags INTEGER,"\
+        "user_tags TEXT NOT NULL,"\
+        "num_auto_tags INTEGER,"\
+        "auto_tags TEXT NOT NULL,"\
+        "user_bpm INTEGER,"\
+        "user_key INTEGER,"\
+        "auto_bpm INTEGER,"\
+        "auto_key INTEGER,"\
+        "timbre BLOB,"\
+        "key_version INTEGER NOT NULL DEFAULT 0,"\
+        "timbre_version INTEGER NOT NULL DEFAULT 0,"\
+        "overview_version INTEGER NOT NULL DEFAULT 0,"\
+        "effective_key INTEGER GENERATED ALWAYS AS (CASE WHEN user_key > 0 "\
+            "THEN user_key - 1 ELSE auto_key END) VIRTUAL,"\
+        "effective_bpm INTEGER GENERATED ALWAYS AS (CASE WHEN user_bpm > 0 "\
+            "THEN user_bpm ELSE auto_bpm END) VIRTUAL"\
+    ");"\
+    "CREATE TABLE waveform_overviews ("\
+        "file_id INTEGER NOT NULL,"\
+        "bins INTEGER NOT NULL,"\
+        "peaks BLOB NOT NULL,"\
+        "PRIMARY KEY (file_id, bins)"\
+    ") WITHOUT ROWID;"\
+    "CREATE VIRTUAL TABLE audio_files_fts USING fts5("\
+        "file_name, auto_tags, user_tags,"\
+        "content='audio_files', content_rowid='id',"\
+        "tokenize='unicode61 remove_diacritics 2', prefix='1 2 3');"\
+    "CREATE TABLE tags (id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE);"\
+    "CREATE TABLE file_tags ("\
+        "tag_id INTEGER NOT NULL,"\
+        "file_id INTEGER NOT NULL,"\
+        "source INTEGER NOT NULL,"\
+        "PRIMARY KEY (tag_id, file_id, source)"\
+    ") WITHOUT ROWID;"\
+    "INSERT INTO audio_files (id, file_path, file_name, file_size, duration,"\
+        "num_user_tags, user_tags, num_auto_tags, auto_tags, user_bpm,"\
+        "user_key, auto_bpm, auto_key, key_version) VALUES "\
+        "(1, '/library/drums/kick.wav', 'kick.wav', 100, 500,"\
+            "0, '', 1, 'drum', 0, 0, 120, 9, 1),"\
+        "(2, '/library/drums/snare.wav', 'snare.wav', 200, 400,"\
+            "1, 'crisp', 1, 'drum', 0, 0, 0, 2, 1),"\
+        "(5, '/library/pads/warm pad.wav', 'warm pad.wav', 300, 9000,"\
+            "0, '', 1, 'synth', 90, 4, 0, 0, 1);"\
+    "INSERT INTO audio_files_fts(audio_files_fts) VALUES ('rebuild');"\
+    "INSERT INTO tags (id, name) VALUES (1, 'drum'), (2, 'crisp'), (3, 'synth');"\
+    "INSERT INTO file_tags VALUES (1, 1, 0), (1, 2, 0), (2, 2, 1), (3, 5, 0);"\
+    "INSERT INTO waveform_overviews VALUES (5, 1, x'010203');"\
+    "PRAGMA user_version = 6;";
+
+static void make_v6_database (const std::string &path) {
+    sqlite3 *db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    char *error = nullptr;
+    if (sqlite3_exec(db, V6_SCHEMA, nullptr, nullptr, &error) != SQLITE_OK) {
+        fprintf(stderr, "make_v6_database: %s\n", error);
+        sqlite3_free(error);
+        test_failures()++;
+    }
+    sqlite3_close(db);
+}
+
+static bool index_exists (const std::string &path, const char *name) {
+    sqlite3 *db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    sqlite3_stmt *stmt = nullptr;
+    CHECK(sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master "\
+                             "WHERE type = 'index' AND name = ?;", -1,
+                             &stmt, nullptr) == SQLITE_OK);
+    sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
+    bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return exists;
+}
+
+// a version 9 database loses the facet indexes nothing reads any more
+static void test_drop_facet_indexes (void) {
+    std::string path = scratch_path("test_migration_v9.db");
+    { Database db(path); }
+
+    sqlite3 *db = nullptr;
+    CHECK(sqlite3_open(path.c_str(), &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "CREATE INDEX audio_files_key_bpm ON audio_files "\
+                       "(effective_key, effective_bpm, duration);"\
+                       "CREATE INDEX audio_files_bpm ON audio_files "\
+                       "(effective_bpm, duration) WHERE effective_bpm > 0;"\
+                       "CREATE INDEX audio_files_duration ON audio_files "\
+                       "(duration) WHERE duration > 0;"\
+                       "PRAGMA user_version = 9;", nullptr, nullptr,
+                       nullptr) == SQLITE_OK);
+    sqlite3_close(db);
+    CHECK(index_exists(path, "audio_files_bpm"));
+
+    { Database migrated(path); }
+    CHECK(!index_exists(path, "audio_files_key_bpm"));
+    CHECK(!index_exists(path, "audio_files_bpm"));
+    CHECK(!index_exists(path, "audio_files_duration"));
+    CHECK(index_exists(path, "file_tags_by_file"));
+}
+
+int main (void) {
+    std::string path = scratch_path("test_migration.db");
+    make_v6_database(path);
+
+    Database db(path);
+
+    // rows keep their ids, and paths are split into directory and name
+    struct FileRecord file;
+    CHECK(db.get_file(5, &file));
+    CHECK(fs::path(file.file_path) == fs::path("/library/pads/warm pad.wav"));
+    CHECK(file.file_name == "warm pad.wav" && file.user_bpm == 90);
+    CHECK(db.get_file_id("/library/drums/snare.wav") == 2);
+    CHECK(db.get_file_id("/library/drums/kick.wav") == 1);
+    CHECK(!db.get_file(3, &file));
+
+    // the full-text index, tags and overviews still point at the same rows
+    SearchPage page = db.search_files_by_name("snare", SearchCursor(), 10);
+    CHECK(page.hits.size() == 1 && page.hits[0].id == 2);
+    CHECK(db.files_with_all_tags({"drum"}) == (std::vector<int64_t>{1, 2}));
+    CHECK(db.files_with_all_tags({"crisp"}) == std::vector<int64_t>{2});
+    WaveformLevel level;
+    CHECK(db.fetch_overview(5, 1, &level) && level.peaks.size() == 3);
+
+    // both directories are in the catalog, one row each
+    Catalog catalog;
+    db.load_catalog(&catalog);
+    CHECK(catalog.size() == 3 && catalog.last_id() == 5);
+    CHECK(fs::path(catalog.path(2)) == fs::path("/library/pads/warm pad.wav"));
+    CHECK(fs::path(catalog.path(0)) == fs::path("/library/drums/kick.wav"));
+
+    // new rows go after the migrated ones, and an existing path is still
+    // recognized as a duplicate
+    RecordBatch batch;
+    struct FileRecord added{};
+    added.file_path = "/library/drums/clap.wav";
+    added.file_name = "clap.wav";
+    batch.add(added);
+    struct FileRecord again{};
+    again.file_path = "/library/drums/kick.wav";
+    again.file_name = "kick.wav";
+    batch.add(again);
+    db.insert_files({&batch}, nullptr, &catalog);
+    CHECK(db.get_file_id("/library/drums/clap.wav") > 5);
+    CHECK(catalog.size() == 4);
+    CHECK(db.files_with_all_tags({"drum"}) == (std::vector<int64_t>{1, 2}));
+    CHECK(!index_exists(path, "audio_files_bpm"));
+
+    test_drop_facet_indexes();
+    return test_result("test_migration");
+}
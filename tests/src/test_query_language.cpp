@@ -0,0 +1,61 @@
+// Project Inclusions
+#include "..\..\inc\QueryLanguage.h"
+#include "TestUtilities.h"
+
+// the range of the only term of a query, false if it doesn't parse
+static bool range (const std::string &query, int *lo, int *hi) {
+    struct ParsedQuery parsed;
+    std::string error;
+    if (!parse_query(query, &parsed, &error)) {
+        CHECK(!error.empty());
+        return false;
+    }
+    CHECK(parsed.terms.size() == 1);
+    *lo = parsed.terms[0].lo;
+    *hi = parsed.terms[0].hi;
+    return true;
+}
+
+int main (void) {
+    int lo, hi;
+    CHECK(range("bpm:120", &lo, &hi) && lo == 120 && hi == 120);
+    CHECK(range("bpm:100-140", &lo, &hi) && lo == 100 && hi == 140);
+    CHECK(range("bpm:<90", &lo, &hi) && lo == 0 && hi == 89);
+    CHECK(range("bpm:>=90", &lo, &hi) && lo == 90 && hi == INT32_MAX);
+    CHECK(range("dur:500-1500ms", &lo, &hi) && lo == 500 && hi == 1500);
+    CHECK(range("dur:1-2", &lo, &hi) && lo == 1000 && hi == 2000);
+    CHECK(range("dur:<=1.5m", &lo, &hi) && lo == 0 && hi == 90000);
+    CHECK(range("key:Am", &lo, &hi) && lo == 0);
+
+    // a ~ before any bpm form also matches half and double time
+    struct ParsedQuery parsed;
+    std::string error;
+    CHECK(parse_query("bpm:~120-128 bpm:~<=90 bpm:120", &parsed, &error));
+    CHECK(parsed.terms.size() == 3);
+    CHECK(parsed.terms[0].half_double && parsed.terms[0].lo == 120 &&
+          parsed.terms[0].hi == 128);
+    CHECK(parsed.terms[1].half_double && parsed.terms[1].hi == 90);
+    CHECK(!parsed.terms[2].half_double);
+    CHECK(!range("bpm:~", &lo, &hi));
+    CHECK(!range("bpm:~~120", &lo, &hi));
+    CHECK(!range("dur:~2s", &lo, &hi));
+
+    // values that don't fit an int are parse errors, not wrapped ranges
+    CHECK(!range("bpm:1e30", &lo, &hi));
+    CHECK(!range("bpm:>2147483647", &lo, &hi));
+    CHECK(!range("bpm:100-1e10", &lo, &hi));
+    CHECK(!range("dur:>1e9m", &lo, &hi));
+    CHECK(!range("dur:<3000000s", &lo, &hi));
+    CHECK(!range("bpm:inf", &lo, &hi));
+    CHECK(!range("bpm:nan", &lo, &hi));
+    CHECK(!range("dur:-nan", &lo, &hi));
+    CHECK(range("dur:<2000000s", &lo, &hi) && hi == 1999999999);
+
+    // other malformed values
+    CHECK(!range("bpm:fast", &lo, &hi));
+    CHECK(!range("bpm:140-100", &lo, &hi));
+    CHECK(!range("dur:5h", &lo, &hi));
+    CHECK(!range("key:H", &lo, &hi));
+    CHECK(!range("bpm:", &lo, &hi));
+    return test_result("test_query_language");
+}
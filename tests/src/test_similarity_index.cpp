@@ -0,0 +1,187 @@
+// Standard Library Inclusions
+#include <random>
+#include <set>
+
+// Project Inclusions
+#include "..\..\inc\SimilarityIndex.h"
+#include "..\..\inc\Database.h"
+#include "TestUtilities.h"
+
+#define NUM_VECTORS 2000
+#define NUM_QUERIES 50
+#define TOP_K 10
+
+// clustered random vectors, so neighbourhoods are meaningful
+static std::vector<std::vector<float>> make_vectors (size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.0f, 0.1f);
+    std::uniform_real_distribution<float> centre(-1.0f, 1.0f);
+    std::vector<std::vector<float>> centres(20, std::vector<float>(TIMBRE_DIMS));
+    for (auto &c : centres) {
+        for (float &x : c) {
+            x = centre(rng);
+        }
+    }
+    std::vector<std::vector<float>> vectors(n, std::vector<float>(TIMBRE_DIMS));
+    for (size_t i = 0; i < n; i++) {
+        const std::vector<float> &c = centres[i % centres.size()];
+        for (int d = 0; d < TIMBRE_DIMS; d++) {
+            vectors[i][d] = c[d] + noise(rng);
+        }
+    }
+    return vectors;
+}
+
+// the exact k nearest ids of a vector, excluding exclude
+static std::set<int64_t> brute_force (const std::vector<std::vector<float>> &vectors,
+                                      const std::vector<float> &query, int k,
+                                      int64_t exclude) {
+    std::vector<std::pair<float, int64_t>> all;
+    for (size_t i = 0; i < vectors.size(); i++) {
+        int64_t id = static_cast<int64_t>(i) + 1;
+        if (id == exclude) {
+            continue;
+        }
+        float d = 0.0f;
+        for (int j = 0; j < TIMBRE_DIMS; j++) {
+            d += (vectors[i][j] - query[j]) * (vectors[i][j] - query[j]);
+        }
+        all.emplace_back(d, id);
+    }
+    std::partial_sort(all.begin(), all.begin() + k, all.end());
+    std::set<int64_t> best;
+    for (int i = 0; i < k; i++) {
+        best.insert(all[i].second);
+    }
+    return best;
+}
+
+// mean share of the true top k that search_by_id finds
+static double recall (const SimilarityIndex &index,
+                      const std::vector<std::vector<float>> &vectors) {
+    size_t found = 0;
+    for (int q = 0; q < NUM_QUERIES; q++) {
+        int64_t id = 1 + q * (static_cast<int64_t>(vectors.size()) / NUM_QUERIES);
+        std::set<int64_t> truth = brute_force(vectors, vectors[id - 1], TOP_K, id);
+        for (const auto &hit : index.search_by_id(id, TOP_K)) {
+            found += truth.count(hit.first);
+        }
+    }
+    return static_cast<double>(found) / (NUM_QUERIES * TOP_K);
+}
+
+static void test_recall_and_serialize (void) {
+    std::vector<std::vector<float>> vectors = make_vectors(NUM_VECTORS, 1);
+    SimilarityIndex index(TIMBRE_DIMS);
+    for (size_t i = 0; i < vectors.size(); i++) {
+        index.insert(static_cast<int64_t>(i) + 1, vectors[i]);
+    }
+    CHECK(index.size() == NUM_VECTORS);
+    CHECK(index.last_id() == NUM_VECTORS);
+    CHECK(recall(index, vectors) >= 0.9);
+
+    // a restored graph answers exactly like the original
+    std::vector<uint8_t> graph;
+    index.serialize(&graph);
+    SimilarityIndex restored(TIMBRE_DIMS);
+    CHECK(restored.deserialize(graph.data(), graph.size()));
+    CHECK(restored.size() == index.size());
+    CHECK(restored.last_id() == index.last_id());
+    for (int64_t id = 1; id <= NUM_VECTORS; id += 97) {
+        CHECK(restored.search_by_id(id, TOP_K) == index.search_by_id(id, TOP_K));
+    }
+
+    // malformed graphs are rejected and leave the index as it was
+    SimilarityIndex other(TIMBRE_DIMS);
+    other.insert(7, vectors[0]);
+    CHECK(!other.deserialize(graph.data(), graph.size() - 1));
+    std::vector<uint8_t> bad_link = graph;
+    uint32_t past_end = NUM_VECTORS;
+    memcpy(bad_link.data() + bad_link.size() - sizeof(past_end), &past_end,
+           sizeof(past_end));
+    CHECK(!other.deserialize(bad_link.data(), bad_link.size()));
+    SimilarityIndex wrong_dims(TIMBRE_DIMS + 1);
+    CHECK(!wrong_dims.deserialize(graph.data(), graph.size()));
+    CHECK(other.size() == 1 && other.contains(7));
+}
+
+static void test_update (void) {
+    std::vector<std::vector<float>> vectors = make_vectors(NUM_VECTORS, 3);
+    SimilarityIndex index(TIMBRE_DIMS);
+    for (size_t i = 0; i < vectors.size(); i++) {
+        index.insert(static_cast<int64_t>(i) + 1, vectors[i]);
+    }
+
+    // move a tenth of the rows into a new cluster far from the others;
+    // their neighbours are now each other
+    std::vector<std::vector<float>> moved = make_vectors(NUM_VECTORS, 4);
+    for (size_t i = 0; i < vectors.size(); i += 10) {
+        for (int d = 0; d < TIMBRE_DIMS; d++) {
+            vectors[i][d] = 10.0f + moved[i][d] - moved[i % 20][d];
+        }
+        index.update(static_cast<int64_t>(i) + 1, vectors[i]);
+    }
+    CHECK(index.size() == NUM_VECTORS);
+    CHECK(recall(index, vectors) >= 0.9);
+
+    // the relinked graph is still well formed
+    std::vector<uint8_t> graph;
+    index.serialize(&graph);
+    SimilarityIndex restored(TIMBRE_DIMS);
+    CHECK(restored.deserialize(graph.data(), graph.size()));
+}
+
+// insert one file per vector into a database, with ids 1..n
+static void insert_files (Database *db, const std::vector<std::vector<float>> &vectors,
+                          size_t first, size_t last, SimilarityIndex *index) {
+    RecordBatch batch;
+    for (size_t i = first; i < last; i++) {
+        struct FileRecord file{};
+        file.file_name = "file_" + std::to_string(i) + ".wav";
+        file.file_path = "/library/" + file.file_name;
+        file.timbre = vectors[i];
+        batch.add(file);
+    }
+    db->insert_files({&batch}, index, nullptr);
+}
+
+static void test_saved_graph (void) {
+    std::string path = scratch_path("test_similarity_index.db");
+    std::vector<std::vector<float>> vectors = make_vectors(600, 2);
+    {
+        Database db(path);
+        SimilarityIndex index(TIMBRE_DIMS);
+        db.load_similarity_index(&index);
+        insert_files(&db, vectors, 0, 400, &index);
+        db.save_similarity_index(&index);
+    }
+    {
+        // the saved graph is restored, and rows added after it was saved
+        // are picked up from the timbre column
+        Database db(path);
+        insert_files(&db, vectors, 400, 600, nullptr);
+        SimilarityIndex index(TIMBRE_DIMS);
+        db.load_similarity_index(&index);
+        CHECK(index.size() == 600);
+        CHECK(index.last_id() == 600);
+        CHECK(recall(index, vectors) >= 0.9);
+
+        // re-analysis drops the saved graph, so the next load rebuilds it
+        struct FileRecord file{};
+        file.timbre = vectors[0];
+        db.update_analysis({{1, &file}}, &index, nullptr);
+    }
+    {
+        Database db(path);
+        SimilarityIndex index(TIMBRE_DIMS);
+        db.load_similarity_index(&index);
+        CHECK(index.size() == 600);
+    }
+}
+
+int main (void) {
+    test_recall_and_serialize();
+    test_update();
+    test_saved_graph();
+    return test_result("test_similarity_index");
+}
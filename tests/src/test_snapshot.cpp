@@ -0,0 +1,224 @@
+// Standard Library Inclusions
+#include <fstream>
+#include <iterator>
+#include <filesystem>
+
+// Project Inclusions
+#include "..\..\inc\Database.h"
+#include "..\..\inc\Catalog.h"
+#include "..\..\inc\CatalogSnapshot.h"
+#include "TestUtilities.h"
+
+namespace fs = std::filesystem;
+
+static void insert_files (Database *db, Catalog *catalog, int first, int last) {
+    RecordBatch batch;
+    for (int i = first; i < last; i++) {
+        struct FileRecord file{};
+        file.file_name = "loop_" + std::to_string(i) + ".wav";
+        file.file_path = "/library/" + std::string(i % 2 ? "odd" : "even") +
+                         "/" + file.file_name;
+        file.duration = 1000 + i;
+        file.auto_bpm = 80 + i % 80;
+        file.auto_key = i % 12;
+        file.auto_tags = (i % 3 == 0) ? "drum" : "synth pad";
+        file.num_auto_tags = (i % 3 == 0) ? 1 : 2;
+        batch.add(file);
+    }
+    db->insert_files({&batch}, nullptr, catalog);
+}
+
+static std::vector<uint8_t> read_file (const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>());
+}
+
+static void write_file (const std::string &path, const std::vector<uint8_t> &data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+// the rows of a structured query, as paths
+static std::vector<std::string> query_paths (const Catalog &catalog,
+                                             const std::string &query) {
+    struct ParsedQuery parsed;
+    std::string error;
+    CHECK(parse_query(query, &parsed, &error));
+    size_t total;
+    std::vector<std::string> paths;
+    for (uint32_t row : catalog.run_query(parsed, SIZE_MAX, &total)) {
+        paths.push_back(catalog.path(row));
+    }
+    return paths;
+}
+
+// A copy of a snapshot with one uint32 of a section replaced, so the file
+// is only readable without verification and the offset checks must catch it
+static std::string with_value (const std::vector<uint8_t> &snapshot, int section,
+                               size_t index, uint32_t value) {
+    std::vector<uint8_t> copy = snapshot;
+    struct SnapshotHeader header;
+    memcpy(&header, copy.data(), sizeof(header));
+    memcpy(copy.data() + header.sections[section].offset +
+           index * sizeof(uint32_t), &value, sizeof(value));
+    std::string path = scratch_path("test_snapshot_bad.cat");
+    write_file(path, copy);
+    return path;
+}
+
+static void test_round_trip (void) {
+    std::string db_path = scratch_path("test_snapshot.db");
+    std::string path = scratch_path("test_snapshot.cat");
+    Database db(db_path);
+    Catalog catalog;
+    db.load_catalog(&catalog);
+    insert_files(&db, &catalog, 0, 500);
+    CHECK(catalog.write_snapshot(path, db.database_id()));
+
+    // the mapped catalog answers exactly like the one it was written from
+    Catalog mapped;
+    CHECK(mapped.open_snapshot(path, true, db.database_id()));
+    CHECK(mapped.size() == 500 && mapped.last_id() == catalog.last_id());
+    for (uint32_t row = 0; row < 500; row += 37) {
+        CHECK(mapped.path(row) == catalog.path(row));
+    }
+    for (const char *query : {"loop_1", "tag:drum", "key:C bpm:100-120",
+                              "path:odd/ -tag:pad", "dur:<1.1s"}) {
+        std::vector<std::string> expected = query_paths(catalog, query);
+        CHECK(!expected.empty());
+        CHECK(query_paths(mapped, query) == expected);
+    }
+    size_t total = 0, mapped_total = 0;
+    CHECK(mapped.text_search("loop_12", 0, 100, &mapped_total) ==
+          catalog.text_search("loop_12", 0, 100, &total));
+    CHECK(total == mapped_total && total > 0);
+
+    // rows scanned after the snapshot are loaded on top of it
+    insert_files(&db, &catalog, 500, 520);
+    CHECK(db.load_catalog(&mapped));
+    CHECK(mapped.size() == 520 && mapped.last_id() == catalog.last_id());
+    CHECK(query_paths(mapped, "tag:drum") == query_paths(catalog, "tag:drum"));
+    CHECK(query_paths(mapped, "loop_51") == query_paths(catalog, "loop_51"));
+    CHECK(query_paths(mapped, "loop_51").size() == 11);
+
+    // another database's snapshot is refused, whatever its contents
+    Database other(scratch_path("test_snapshot_other.db"));
+    CHECK(other.database_id() != db.database_id());
+    Catalog foreign;
+    CHECK(!foreign.open_snapshot(path, true, other.database_id()));
+    CHECK(foreign.size() == 0);
+}
+
+static void test_corrupt (void) {
+    std::string path = scratch_path("test_snapshot.cat");
+    Database db(scratch_path("test_snapshot.db"));
+    Catalog catalog;
+    insert_files(&db, &catalog, 0, 50);
+    CHECK(catalog.write_snapshot(path, db.database_id()));
+    const std::vector<uint8_t> snapshot = read_file(path);
+    const uint64_t id = db.database_id();
+
+    // a failed open leaves the catalog as it was
+    Catalog target;
+    insert_files(&db, &target, 50, 53);
+    CHECK(target.size() == 3);
+
+    // a flipped byte fails the checksum
+    std::vector<uint8_t> flipped = snapshot;
+    flipped[flipped.size() / 2] ^= 0x40;
+    std::string bad = scratch_path("test_snapshot_bad.cat");
+    write_file(bad, flipped);
+    CHECK(!target.open_snapshot(bad, true, id));
+
+    // truncated files and other versions are refused
+    write_file(bad, std::vector<uint8_t>(snapshot.begin(), snapshot.end() - 8));
+    CHECK(!target.open_snapshot(bad, false, id));
+    write_file(bad, std::vector<uint8_t>(snapshot.begin(), snapshot.begin() + 16));
+    CHECK(!target.open_snapshot(bad, false, id));
+    std::vector<uint8_t> version = snapshot;
+    version[8]++;
+    write_file(bad, version);
+    CHECK(!target.open_snapshot(bad, false, id));
+    CHECK(!target.open_snapshot(scratch_path("test_snapshot_missing.cat"),
+                                false, id));
+
+    // offsets out of range are caught even without the checksum
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_NAME_OFFSETS, 0, 1),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_NAME_OFFSETS, 10,
+                                           0xffffff), false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_DIRS, 3, 1000),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_DIR_OFFSETS, 1,
+                                           100000), false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TAG_OFFSETS, 0,
+                                           100000), false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_POSTINGS, 0, 50),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_POSTINGS, 1, 0),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_POSTING_OFFSETS, 1,
+                                           1000), false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_IDS, 2, 0),
+                                false, id));
+
+    // and so are trigram lists that run past their sections or don't decode
+    // to the rows they claim
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TRIGRAMS, 1, 1000),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TRIGRAMS, 8, 1),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TRIGRAMS, 5, 0),
+                                false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TRIGRAM_BYTES, 0,
+                                           0xffffffff), false, id));
+    CHECK(!target.open_snapshot(with_value(snapshot, SNAPSHOT_TRIGRAM_SKIPS, 0,
+                                           49), false, id));
+    CHECK(target.size() == 3);
+
+    // the unmodified file still opens
+    write_file(bad, snapshot);
+    CHECK(target.open_snapshot(bad, false, id) && target.size() == 50);
+}
+
+// a snapshot written after the database was backed up is ahead of the
+// restored copy; the catalog is reloaded from the database instead
+static void test_ahead_of_database (void) {
+    std::string db_path = scratch_path("test_snapshot.db");
+    std::string backup = scratch_path("test_snapshot_backup.db");
+    std::string path = scratch_path("test_snapshot.cat");
+    uint64_t id;
+    {
+        Database db(db_path);
+        Catalog catalog;
+        insert_files(&db, &catalog, 0, 30);
+        id = db.database_id();
+    }
+    fs::copy_file(db_path, backup);
+    {
+        Database db(db_path);
+        Catalog catalog;
+        db.load_catalog(&catalog);
+        insert_files(&db, &catalog, 30, 60);
+        CHECK(catalog.write_snapshot(path, id));
+    }
+
+    Database restored(backup);
+    CHECK(restored.database_id() == id);
+    Catalog catalog;
+    CHECK(catalog.open_snapshot(path, true, id) && catalog.size() == 60);
+    CHECK(!restored.load_catalog(&catalog));
+    CHECK(catalog.size() == 30);
+
+    // rows inserted now aren't shadowed by the snapshot's ids
+    insert_files(&restored, &catalog, 100, 105);
+    CHECK(catalog.size() == 35);
+}
+
+int main (void) {
+    test_round_trip();
+    test_corrupt();
+    test_ahead_of_database();
+    return test_result("test_snapshot");
+}
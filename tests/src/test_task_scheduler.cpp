@@ -0,0 +1,127 @@
+// Standard Library Inclusions
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+// Project Inclusions
+#include "..\..\inc\TaskScheduler.h"
+#include "TestUtilities.h"
+
+#define NUM_SUBMITTERS 8
+#define TASKS_PER_SUBMITTER 2000
+
+// Threads outside the scheduler each run a group of tasks at once; every
+// task runs exactly once, at its group's priority, before wait returns
+static void test_groups (TaskScheduler &scheduler) {
+    std::vector<std::atomic<int>> runs(NUM_SUBMITTERS * TASKS_PER_SUBMITTER);
+    for (std::atomic<int> &r : runs) {
+        r = 0;
+    }
+    std::atomic<int> wrong_priority{0};
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < NUM_SUBMITTERS; s++) {
+        submitters.emplace_back([&, s]() {
+            TaskPriority priority = static_cast<TaskPriority>(s % TASK_PRIORITIES);
+            TaskGroup group(priority, scheduler);
+            for (int i = 0; i < TASKS_PER_SUBMITTER; i++) {
+                std::atomic<int> *run = &runs[s * TASKS_PER_SUBMITTER + i];
+                group.run([run, priority, &wrong_priority]() {
+                    if (TaskScheduler::current_priority(TASK_PRIORITIES) != 
+                        priority) {
+                        wrong_priority++;
+                    }
+                    (*run)++;
+                });
+            }
+            group.wait();
+            for (int i = 0; i < TASKS_PER_SUBMITTER; i++) {
+                CHECK(runs[s * TASKS_PER_SUBMITTER + i] == 1);
+            }
+        });
+    }
+    for (std::thread &t : submitters) {
+        t.join();
+    }
+    CHECK(wrong_priority == 0);
+}
+
+// tasks that wait on groups of their own subtasks, many levels deep, on
+// fewer threads than waiting tasks
+static size_t count_tree (TaskScheduler &scheduler, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    std::atomic<size_t> total{1};
+    TaskGroup group(PRIORITY_SCAN, scheduler);
+    for (int c = 0; c < 3; c++) {
+        group.run([&scheduler, &total, depth]() {
+            total += count_tree(scheduler, depth - 1);
+        });
+    }
+    group.wait();
+    return total;
+}
+
+// fire and forget tasks from outside and from inside the workers
+static void test_submit (TaskScheduler &scheduler) {
+    std::atomic<int> done{0};
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < 4; s++) {
+        submitters.emplace_back([&scheduler, &done]() {
+            for (int i = 0; i < 1000; i++) {
+                scheduler.submit(PRIORITY_REANALYSIS, [&scheduler, &done]() {
+                    scheduler.submit(PRIORITY_INTERACTIVE, [&done]() {
+                        done++;
+                    });
+                    done++;
+                });
+            }
+        });
+    }
+    for (std::thread &t : submitters) {
+        t.join();
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (done < 8000 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(done == 8000);
+}
+
+// every index is visited once, however the range is chunked
+static void test_parallel_for (void) {
+    for (size_t n : {0, 1, 7, 1000, 100000}) {
+        std::vector<std::atomic<int>> visits(n);
+        for (std::atomic<int> &v : visits) {
+            v = 0;
+        }
+        parallel_for(PRIORITY_VISIBLE, 0, n, 16, [&visits](size_t first, 
+                                                           size_t last) {
+            for (size_t i = first; i < last; i++) {
+                visits[i]++;
+            }
+        });
+        bool once = true;
+        for (std::atomic<int> &v : visits) {
+            once = once && v == 1;
+        }
+        CHECK(once);
+    }
+}
+
+int main (void) {
+    {
+        TaskScheduler scheduler(4);
+        CHECK(scheduler.num_threads() == 4);
+        test_groups(scheduler);
+        test_submit(scheduler);
+    }
+    {
+        TaskScheduler scheduler(2);
+        CHECK(count_tree(scheduler, 7) == (2187 * 3 - 1) / 2);
+    }
+    CHECK(TaskScheduler::current_priority(PRIORITY_SCAN) == PRIORITY_SCAN);
+    test_parallel_for();
+    return test_result("test_task_scheduler");
+}
@@ -0,0 +1,167 @@
+// Standard Library Inclusions
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// Project Inclusions
+#include "..\..\inc\ThreadSafeQueue.h"
+#include "TestUtilities.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_CONSUMERS 4
+#define VALUES_PER_PRODUCER 100000
+
+// Producers push producer * VALUES_PER_PRODUCER + i for ascending i, each
+// through a different call, into a small ring so pushes and pops keep
+// meeting a full or an empty queue. Every value must arrive exactly once,
+// and each consumer must see each producer's values in order.
+static void test_contention (size_t capacity) {
+    ThreadSafeQueue<int> queue(capacity);
+    std::vector<std::vector<int>> received(NUM_CONSUMERS);
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < NUM_CONSUMERS; c++) {
+        consumers.emplace_back([&queue, &received, c]() {
+            std::vector<int> &values = received[c];
+            int value;
+            if (c % 2 == 0) {
+                while (queue.pop(value)) {
+                    values.push_back(value);
+                }
+            } else {
+                while (queue.pop_batch(&values, 64) > 0) {
+                }
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([&queue, p]() {
+            int base = p * VALUES_PER_PRODUCER;
+            int i = 0;
+            while (i < VALUES_PER_PRODUCER) {
+                int value = base + i;
+                switch (p % 3) {
+                case 0:
+                    CHECK(queue.push(value));
+                    i++;
+                    break;
+                case 1:
+                    if (queue.try_push(value)) {
+                        i++;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    break;
+                default: {
+                    std::vector<int> batch;
+                    for (int b = 0; b < 100 && i < VALUES_PER_PRODUCER; b++) {
+                        batch.push_back(base + i++);
+                    }
+                    CHECK(queue.push_batch(batch) == batch.size());
+                    break;
+                }
+                }
+            }
+        });
+    }
+    for (std::thread &t : producers) {
+        t.join();
+    }
+    queue.close();
+    for (std::thread &t : consumers) {
+        t.join();
+    }
+
+    std::vector<int> all;
+    for (const std::vector<int> &values : received) {
+        std::vector<int> last(NUM_PRODUCERS, -1);
+        for (int value : values) {
+            int p = value / VALUES_PER_PRODUCER;
+            CHECK(value > last[p]);
+            last[p] = value;
+        }
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    std::sort(all.begin(), all.end());
+    CHECK(all.size() == NUM_PRODUCERS * VALUES_PER_PRODUCER);
+    for (size_t i = 0; i < all.size(); i++) {
+        if (all[i] != static_cast<int>(i)) {
+            CHECK(all[i] == static_cast<int>(i));
+            break;
+        }
+    }
+    CHECK(queue.empty());
+}
+
+static void test_close (void) {
+    ThreadSafeQueue<std::unique_ptr<int>> queue(3);
+    CHECK(queue.capacity() == 4);
+
+    // a full queue refuses try_push and keeps the value
+    for (int i = 0; i < 4; i++) {
+        CHECK(queue.push(std::unique_ptr<int>(new int(i))));
+    }
+    std::unique_ptr<int> extra(new int(4));
+    CHECK(!queue.try_push(extra) && extra && *extra == 4);
+    CHECK(queue.size() == 4);
+
+    // a push blocked on the full queue finishes once a value is popped
+    std::thread blocked([&queue]() {
+        CHECK(queue.push(std::unique_ptr<int>(new int(5))));
+    });
+    std::unique_ptr<int> value;
+    CHECK(queue.pop(value) && *value == 0);
+    blocked.join();
+
+    // values queued before close are still delivered, pushes fail
+    queue.close();
+    CHECK(queue.is_closed());
+    CHECK(!queue.push(std::unique_ptr<int>(new int(6))));
+    CHECK(!queue.try_push(extra));
+    std::vector<std::unique_ptr<int>> rest;
+    CHECK(queue.pop_batch(&rest, 10) == 4);
+    CHECK(*rest[0] == 1 && *rest[3] == 5);
+    CHECK(!queue.pop(value));
+    CHECK(queue.pop_batch(&rest, 10) == 0);
+
+    // a waiting pop wakes on close
+    ThreadSafeQueue<int> idle;
+    std::thread waiter([&idle]() {
+        int v;
+        CHECK(!idle.pop(v));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    idle.close();
+    waiter.join();
+}
+
+static void test_timeouts (void) {
+    ThreadSafeQueue<int> queue(8);
+    int value;
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!queue.pop_for(value, std::chrono::milliseconds(20)));
+    CHECK(std::chrono::steady_clock::now() - start >= 
+          std::chrono::milliseconds(20));
+    std::vector<int> values;
+    CHECK(queue.pop_batch_until(&values, 4, std::chrono::steady_clock::now() +
+                                std::chrono::milliseconds(5)) == 0);
+
+    // a value pushed while waiting is returned before the deadline
+    std::thread producer([&queue]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.push(7);
+    });
+    CHECK(queue.pop_for(value, std::chrono::seconds(10)) && value == 7);
+    producer.join();
+}
+
+int main (void) {
+    test_contention(8);
+    test_contention(QUEUE_DEFAULT_CAPACITY);
+    test_close();
+    test_timeouts();
+    return test_result("test_thread_safe_queue");
+}